@@ -0,0 +1,166 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "adaptivebitrate.hpp"
+#include <algorithm>
+#include <array>
+
+namespace {
+// Variant heights stepped through, highest first
+constexpr std::array<gint, 8> HeightLadder = { 2160, 1440, 1080, 720, 540, 480, 360, 240 };
+
+// Weight of the newest render time in the moving average (1 / RenderTimeSmoothing)
+constexpr GstClockTime RenderTimeSmoothing = 8;
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			AdaptiveBitrate Class
+ *
+ * @remarks 		Limits the variants adaptivedemux may pick (HLS, DASH) to what the device decodes and
+ *                  renders in time. Frames dropped by QoS (with those replaced before being
+ *                  rendered when frames are late) and render times longer than the frame duration
+ *                  step the maximum height and bitrate down; they are lifted one step at a time
+ *                  after a run of healthy windows.
+ *
+ **************************************************************************************************************/
+
+void AdaptiveBitrate::onRenderTime(GstClockTime time)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_renderTime = (m_renderTime == 0)
+            ? time
+            : m_renderTime + (GST_CLOCK_DIFF(m_renderTime, time) / (gint64)RenderTimeSmoothing);
+}
+
+void AdaptiveBitrate::onEncodedBuffer(gsize size, GstClockTime pts)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_encodedBytes += size;
+    if (GST_CLOCK_TIME_IS_VALID(pts)) {
+        if (GST_CLOCK_TIME_IS_VALID(m_firstPts) == false || pts < m_firstPts) {
+            m_firstPts = pts;
+        }
+        if (GST_CLOCK_TIME_IS_VALID(m_lastPts) == false || pts > m_lastPts) {
+            m_lastPts = pts;
+        }
+    }
+}
+
+bool AdaptiveBitrate::evaluate(gint frameHeight, Limits &limits)
+{
+    guint presented = m_presented.exchange(0);
+    guint overwritten = m_overwritten.exchange(0);
+    guint dropped = m_dropped.exchange(0);
+    GstClockTime frameDuration = m_frameDuration;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    // Bitrate of the variant being decoded, over the window
+    if (m_encodedBytes > 0 && GST_CLOCK_TIME_IS_VALID(m_firstPts) && m_lastPts > m_firstPts) {
+        m_bitrate = gst_util_uint64_scale(m_encodedBytes * 8, GST_SECOND, m_lastPts - m_firstPts);
+    }
+    m_encodedBytes = 0;
+    m_firstPts = GST_CLOCK_TIME_NONE;
+    m_lastPts = GST_CLOCK_TIME_NONE;
+
+    // Paused, or not rendered at all (off screen): nothing to learn from the window
+    if (presented == 0) {
+        limits = m_limits;
+        return false;
+    }
+    bool isRenderBound = m_renderTime > 0 && GST_CLOCK_TIME_IS_VALID(frameDuration)
+            && m_renderTime > frameDuration * RenderBudget;
+    // A window refreshing slower than the video (60 fps in a 30 Hz window) replaces every other
+    // frame while keeping up: replaced frames only count when frames are late as well
+    guint lost = dropped + ((dropped > 0 || isRenderBound) ? overwritten : 0);
+    float dropRate = static_cast<float>(lost) / (presented + lost);
+
+    Limits previous = m_limits;
+    // The demuxer switches variants at fragment boundaries: frames above the limit are still
+    // those of the previous variant, or no variant is below it
+    bool isSwitchPending = m_limits.maxHeight > 0 && frameHeight > m_limits.maxHeight;
+    if (dropRate > DowngradeDropRate || isRenderBound) {
+        m_healthyWindows = 0;
+        gint height = getLowerHeight(frameHeight);
+        if (isSwitchPending == false && height >= MinHeight) {
+            if (m_unlimitedHeight == 0) {
+                m_unlimitedHeight = frameHeight;
+            }
+            m_limits.maxHeight = height;
+            if (m_bitrate > 0) {
+                m_limits.maxBitrate = static_cast<guint64>(m_bitrate * DowngradeBitrateRatio);
+            }
+            m_downgrades++;
+            g_print("Adaptive bitrate: %.1f %% of the frames lost, render time %.1f ms, limited to "
+                    "%dp, %" G_GUINT64_FORMAT " kbps\n",
+                    dropRate * 100.0f, static_cast<double>(m_renderTime) / GST_MSECOND,
+                    m_limits.maxHeight, m_limits.maxBitrate / 1000);
+        }
+    } else if (dropRate < RecoveryDropRate && m_limits.maxHeight > 0) {
+        // Each downgrade makes the next step up wait longer, so that limits do not oscillate
+        int required = RecoveryWindows << std::min(m_downgrades, MaxRecoveryShift);
+        if (++m_healthyWindows >= required) {
+            m_healthyWindows = 0;
+            gint height = getHigherHeight(m_limits.maxHeight);
+            if (height == 0 || height >= m_unlimitedHeight) {
+                m_limits = Limits();
+                m_unlimitedHeight = 0;
+                g_print("Adaptive bitrate: limits lifted\n");
+            } else {
+                m_limits.maxHeight = height;
+                m_limits.maxBitrate = (m_limits.maxBitrate > 0) ? m_limits.maxBitrate * 3 / 2 : 0;
+                g_print("Adaptive bitrate: limited to %dp, %" G_GUINT64_FORMAT " kbps\n",
+                        m_limits.maxHeight, m_limits.maxBitrate / 1000);
+            }
+        }
+    } else {
+        m_healthyWindows = 0;
+    }
+
+    limits = m_limits;
+    return (m_limits == previous) == false;
+}
+
+void AdaptiveBitrate::reset()
+{
+    m_presented = 0;
+    m_overwritten = 0;
+    m_dropped = 0;
+    m_frameDuration = GST_CLOCK_TIME_NONE;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_renderTime = 0;
+    m_encodedBytes = 0;
+    m_firstPts = GST_CLOCK_TIME_NONE;
+    m_lastPts = GST_CLOCK_TIME_NONE;
+    m_bitrate = 0;
+    m_limits = Limits();
+    m_unlimitedHeight = 0;
+    m_healthyWindows = 0;
+    m_downgrades = 0;
+}
+
+gint AdaptiveBitrate::getLowerHeight(gint height)
+{
+    for (gint step : HeightLadder) {
+        if (step < height) {
+            return step;
+        }
+    }
+    return 0;
+}
+
+gint AdaptiveBitrate::getHigherHeight(gint height)
+{
+    gint higher = 0;
+    for (gint step : HeightLadder) {
+        if (step <= height) {
+            return higher;
+        }
+        higher = step;
+    }
+    return higher;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+#include <atomic>
+#include <mutex>
+
+class AdaptiveBitrate
+{
+public:
+    // Variant limits for adaptivedemux, 0 when unlimited
+    struct Limits
+    {
+        // Bits per second
+        guint64 maxBitrate = 0;
+        gint maxHeight = 0;
+
+        bool operator==(const Limits &other) const
+        {
+            return maxBitrate == other.maxBitrate && maxHeight == other.maxHeight;
+        }
+    };
+
+    // Counters, from the streaming and rendering threads
+    void onFramePresented() { m_presented++; }
+    // Frame replaced by a newer one before any renderer picked it up
+    void onFrameOverwritten() { m_overwritten++; }
+    // QoS drop of the decoder or the sink
+    void onFrameDropped() { m_dropped++; }
+    void onRenderTime(GstClockTime time);
+    void onFrameDuration(GstClockTime duration) { m_frameDuration = duration; }
+    // Encoded buffer entering the video decoder, for the bitrate of the current variant
+    void onEncodedBuffer(gsize size, GstClockTime pts);
+
+    // Called every EvaluationIntervalMs by the player. Returns true when the limits changed.
+    bool evaluate(gint frameHeight, Limits &limits);
+    void reset();
+
+    static constexpr guint EvaluationIntervalMs = 2000;
+    // Share of the frames lost in a window above which the variant is stepped down
+    static constexpr float DowngradeDropRate = 0.1f;
+    // Below which a window counts as healthy
+    static constexpr float RecoveryDropRate = 0.02f;
+    // Healthy windows required before stepping up again, doubled after each downgrade
+    static constexpr int RecoveryWindows = 5;
+    static constexpr int MaxRecoveryShift = 3;
+    // Render time above this share of the frame duration counts as overloaded
+    static constexpr float RenderBudget = 0.8f;
+    // Bitrate limit after a downgrade, relative to the measured bitrate
+    static constexpr float DowngradeBitrateRatio = 0.7f;
+    static constexpr gint MinHeight = 240;
+
+protected:
+    static gint getLowerHeight(gint height);
+    static gint getHigherHeight(gint height);
+
+private:
+    std::atomic<guint> m_presented = 0;
+    std::atomic<guint> m_overwritten = 0;
+    std::atomic<guint> m_dropped = 0;
+    std::atomic<GstClockTime> m_frameDuration = GST_CLOCK_TIME_NONE;
+
+    std::mutex m_lock;
+    // Render time moving average, 0 when not reported
+    GstClockTime m_renderTime = 0;
+    // Encoded bytes and timestamp span of the window
+    guint64 m_encodedBytes = 0;
+    GstClockTime m_firstPts = GST_CLOCK_TIME_NONE;
+    GstClockTime m_lastPts = GST_CLOCK_TIME_NONE;
+    guint64 m_bitrate = 0;
+
+    Limits m_limits;
+    // Height before the first downgrade, limits above it are lifted
+    gint m_unlimitedHeight = 0;
+    int m_healthyWindows = 0;
+    int m_downgrades = 0;
+};
@@ -0,0 +1,336 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "egltexturerenderer.hpp"
+#include <tuple>
+
+namespace {
+const GLint TextureUnit = 0;
+const GLuint VertexAttribute = 0;
+const GLuint CoordAttribute = 1;
+
+// Prepended to every shader, after the extensions: fragment shaders have no default float
+// precision on GLES, and desktop GLSL 1.10 does not know precision qualifiers
+constexpr const char *PrecisionHeader = "#ifdef GL_ES\n"
+                                        "precision mediump float;\n"
+                                        "#else\n"
+                                        "#define lowp\n"
+                                        "#define mediump\n"
+                                        "#define highp\n"
+                                        "#endif\n";
+
+constexpr const char *ExternalExtension = "#extension GL_OES_EGL_image_external: require\n";
+
+constexpr const char *VertexSource = "attribute highp vec4 a_vertices;\n"
+                                     "attribute highp vec2 a_coords;\n"
+                                     "varying highp vec2 v_coords;\n"
+                                     "uniform highp mat4 u_matrix;\n"
+                                     "void main() {\n"
+                                     "    v_coords = a_coords;\n"
+                                     "    gl_Position = u_matrix * a_vertices;\n"
+                                     "}\n";
+
+constexpr const char *FragmentSource2D =
+        "uniform sampler2D u_texture;\n"
+        "uniform lowp float u_opacity;\n"
+        "varying highp vec2 v_coords;\n"
+        "void main() {\n"
+        "    gl_FragColor = u_opacity * texture2D(u_texture, v_coords);\n"
+        "}\n";
+
+constexpr const char *FragmentSourceExtOES =
+        "uniform samplerExternalOES u_texture;\n"
+        "uniform lowp float u_opacity;\n"
+        "varying highp vec2 v_coords;\n"
+        "void main() {\n"
+        "    gl_FragColor = u_opacity * texture2D(u_texture, v_coords);\n"
+        "}\n";
+
+// Overlay rectangles are drawn over the video quad: texture coordinates of the frame are mapped
+// into the rectangle, fragments outside of it are dropped. Pixels are BGRA in memory.
+constexpr const char *FragmentSourceOverlay =
+        "uniform sampler2D u_texture;\n"
+        "uniform lowp float u_opacity;\n"
+        "uniform highp vec4 u_rect;\n"
+        "varying highp vec2 v_coords;\n"
+        "void main() {\n"
+        "    highp vec2 coords = (v_coords - u_rect.xy) / u_rect.zw;\n"
+        "    if (any(lessThan(coords, vec2(0.0))) || any(greaterThan(coords, vec2(1.0))))\n"
+        "        discard;\n"
+        "    gl_FragColor = u_opacity * texture2D(u_texture, coords).bgra;\n"
+        "}\n";
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			EglTextureRenderer Class
+ *
+ * @remarks 		Draws GstPlayer textures and their overlays with plain OpenGL ES 2.0, in whatever
+ *                  EGL context is current. The Qt Quick items render through it, applications
+ *                  without Qt can use it directly with drawFrame().
+ *
+ **************************************************************************************************************/
+
+bool EglTextureRenderer::init()
+{
+    m_program2D = createProgram(FragmentSource2D);
+    m_programExtOES = createProgram(FragmentSourceExtOES, ExternalExtension);
+    m_programOverlay = createProgram(FragmentSourceOverlay);
+    return m_program2D.id != 0 && m_programExtOES.id != 0 && m_programOverlay.id != 0;
+}
+
+void EglTextureRenderer::release()
+{
+    deleteProgram(m_program2D);
+    deleteProgram(m_programExtOES);
+    deleteProgram(m_programOverlay);
+    releaseOverlays();
+}
+
+void EglTextureRenderer::draw(GLuint textureId, GLenum textureTarget, const Quad &quad)
+{
+    const Program &program =
+            (textureTarget == GL_TEXTURE_EXTERNAL_OES) ? m_programExtOES : m_program2D;
+    bind(program, quad);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(textureTarget, textureId);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    unbind();
+}
+
+void EglTextureRenderer::setOverlays(guint64 sequence,
+                                     const std::vector<GstPlayer::Texture::Overlay> &overlays)
+{
+    if (sequence == m_overlaySequence) {
+        return;
+    }
+    m_overlaySequence = sequence;
+    m_overlays = overlays;
+    m_isOverlayChanged = true;
+}
+
+void EglTextureRenderer::drawOverlays(const Quad &quad)
+{
+    // Same quad as the frame, so its crop and orientation apply to the overlays too
+    if (m_overlays.empty()) {
+        return;
+    }
+    if (m_isOverlayChanged) {
+        uploadOverlays();
+    }
+
+    bind(m_programOverlay, quad);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    // Drawn at the depth of the frame
+    glDepthFunc(GL_LEQUAL);
+
+    for (size_t i = 0; i < m_overlays.size(); i++) {
+        const float *rect = m_overlays[i].rect;
+        glUniform4f(m_programOverlay.rect, rect[0], rect[1], rect[2], rect[3]);
+        glBindTexture(GL_TEXTURE_2D, m_overlayTextureIds[i]);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glDepthFunc(GL_LESS);
+    unbind();
+}
+
+void EglTextureRenderer::releaseOverlays()
+{
+    if (m_overlayTextureIds.empty() == false) {
+        glDeleteTextures(static_cast<GLsizei>(m_overlayTextureIds.size()),
+                         m_overlayTextureIds.data());
+    }
+    m_overlayTextureIds.clear();
+    // Kept pixels are uploaded again on the next draw
+    m_isOverlayChanged = true;
+}
+
+void EglTextureRenderer::drawFrame(const GstPlayer::Texture &texture, int frameWidth,
+                                   int frameHeight, int viewportWidth, int viewportHeight,
+                                   int rotation, bool isFlipped)
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (texture.id == GL_INVALID_ID || viewportWidth <= 0 || viewportHeight <= 0) {
+        return;
+    }
+
+    // Texture coordinates of the top-left, top-right, bottom-left and bottom-right corners, as
+    // VideoRenderNode computes them: undo the rotation, then the flip, then map into the crop
+    Quad quad;
+    const float *crop = texture.crop;
+    rotation = ((rotation % 360) + 360) % 360;
+    const std::array<GLfloat, 4 * 2> corners = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+    for (size_t i = 0; i < 4; i++) {
+        GLfloat x = corners[2 * i];
+        GLfloat y = corners[2 * i + 1];
+        switch (rotation) {
+        case 90:
+            std::tie(x, y) = std::make_tuple(y, 1.0f - x);
+            break;
+        case 180:
+            std::tie(x, y) = std::make_tuple(1.0f - x, 1.0f - y);
+            break;
+        case 270:
+            std::tie(x, y) = std::make_tuple(1.0f - y, x);
+            break;
+        default:
+            break;
+        }
+        if (isFlipped) {
+            x = 1.0f - x;
+        }
+        quad.texcoords[2 * i] = crop[0] + x * crop[2];
+        quad.texcoords[2 * i + 1] = crop[1] + y * crop[3];
+    }
+
+    // Letterbox the visible region, texture row 0 at the top
+    float scaleX = 1.0f;
+    float scaleY = 1.0f;
+    if (frameWidth > 0 && frameHeight > 0) {
+        float videoRatio = (frameWidth * crop[2]) / (frameHeight * crop[3]);
+        if (rotation % 180 != 0) {
+            videoRatio = 1.0f / videoRatio;
+        }
+        float viewRatio = static_cast<float>(viewportWidth) / viewportHeight;
+        if (videoRatio > viewRatio) {
+            scaleY = viewRatio / videoRatio;
+        } else {
+            scaleX = videoRatio / viewRatio;
+        }
+    }
+    std::array<GLfloat, 16> scale = { scaleX, 0.0f, 0.0f, 0.0f, 0.0f, scaleY, 0.0f, 0.0f,
+                                      0.0f,   0.0f, 1.0f, 0.0f, 0.0f, 0.0f,   0.0f, 1.0f };
+    // Affine transformation meta, in normalized device coordinates, then the letterbox scale
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            GLfloat sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += scale[k * 4 + row] * texture.transform[column * 4 + k];
+            }
+            quad.matrix[column * 4 + row] = sum;
+        }
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    draw(texture.id, texture.target, quad);
+    setOverlays(texture.overlaySequence, texture.overlays);
+    drawOverlays(quad);
+    glDisable(GL_BLEND);
+}
+
+EglTextureRenderer::Program EglTextureRenderer::createProgram(const char *fragment,
+                                                             const char *extensions)
+{
+    Program program;
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, VertexSource, "");
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragment, extensions);
+    if (vertexShader == 0 || fragmentShader == 0) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return program;
+    }
+
+    GLuint id = glCreateProgram();
+    glAttachShader(id, vertexShader);
+    glAttachShader(id, fragmentShader);
+    glBindAttribLocation(id, VertexAttribute, "a_vertices");
+    glBindAttribLocation(id, CoordAttribute, "a_coords");
+    glLinkProgram(id);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        char log[512] = {};
+        glGetProgramInfoLog(id, sizeof(log), nullptr, log);
+        g_print("Cannot link texture program: %s\n", log);
+        glDeleteProgram(id);
+        return program;
+    }
+
+    program.id = id;
+    program.texture = glGetUniformLocation(id, "u_texture");
+    program.matrix = glGetUniformLocation(id, "u_matrix");
+    program.opacity = glGetUniformLocation(id, "u_opacity");
+    program.rect = glGetUniformLocation(id, "u_rect");
+    return program;
+}
+
+GLuint EglTextureRenderer::compileShader(GLenum type, const char *source, const char *extensions)
+{
+    GLuint shader = glCreateShader(type);
+    // #extension directives must come before any other token
+    const char *sources[] = { extensions, PrecisionHeader, source };
+    glShaderSource(shader, 3, sources, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled == GL_FALSE) {
+        char log[512] = {};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        g_print("Cannot compile texture shader: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+void EglTextureRenderer::deleteProgram(Program &program)
+{
+    if (program.id != 0) {
+        glDeleteProgram(program.id);
+    }
+    program = Program();
+}
+
+void EglTextureRenderer::bind(const Program &program, const Quad &quad)
+{
+    glUseProgram(program.id);
+    glUniform1i(program.texture, TextureUnit);
+    glUniformMatrix4fv(program.matrix, 1, GL_FALSE, quad.matrix.data());
+    glUniform1f(program.opacity, quad.opacity);
+
+    // Client side arrays, no buffer object must be bound
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glEnableVertexAttribArray(VertexAttribute);
+    glEnableVertexAttribArray(CoordAttribute);
+    glVertexAttribPointer(VertexAttribute, 2, GL_FLOAT, GL_FALSE, 0, quad.vertices.data());
+    glVertexAttribPointer(CoordAttribute, 2, GL_FLOAT, GL_FALSE, 0, quad.texcoords.data());
+}
+
+void EglTextureRenderer::unbind()
+{
+    glDisableVertexAttribArray(VertexAttribute);
+    glDisableVertexAttribArray(CoordAttribute);
+    glUseProgram(0);
+}
+
+void EglTextureRenderer::uploadOverlays()
+{
+    releaseOverlays();
+    for (const GstPlayer::Texture::Overlay &overlay : m_overlays) {
+        GLuint textureId = 0;
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        // Uploaded as is, the shader swaps red and blue
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, overlay.width, overlay.height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, overlay.pixels->data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        m_overlayTextureIds.push_back(textureId);
+    }
+    m_isOverlayChanged = false;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <array>
+#include <vector>
+#include "gstplayer.hpp"
+
+#define GL_INVALID_ID ((GLuint) - 1)
+
+class EglTextureRenderer
+{
+public:
+    // Triangle strip of the top-left, top-right, bottom-left and bottom-right corners
+    struct Quad
+    {
+        std::array<GLfloat, 4 * 2> vertices = { -1.0f, 1.0f,  1.0f, 1.0f,
+                                                -1.0f, -1.0f, 1.0f, -1.0f };
+        std::array<GLfloat, 4 * 2> texcoords = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+        // Column major, applied to the vertices
+        std::array<GLfloat, 16> matrix = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                           0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+        GLfloat opacity = 1.0f;
+    };
+
+    EglTextureRenderer() = default;
+    // GL objects must be released with release(), in their context
+    ~EglTextureRenderer() = default;
+    EglTextureRenderer(const EglTextureRenderer &) = delete;
+    EglTextureRenderer &operator=(const EglTextureRenderer &) = delete;
+
+    // Compiles the programs in the current context
+    bool init();
+    void release();
+    bool isInitialized() { return m_program2D.id != 0; };
+
+    // Draws a texture with the current framebuffer, viewport and blending
+    void draw(GLuint textureId, GLenum textureTarget, const Quad &quad);
+    // Overlays are uploaded again only when the sequence changes, 0 for none
+    void setOverlays(guint64 sequence, const std::vector<GstPlayer::Texture::Overlay> &overlays);
+    bool hasOverlays() { return m_overlays.empty() == false; };
+    // Draws the overlays over a frame drawn with the same quad, with premultiplied blending
+    void drawOverlays(const Quad &quad);
+    void releaseOverlays();
+
+    // Draws a player frame with its crop, orientation (GstPlayer::getRotation() and isFlipped())
+    // and overlays into the current viewport, keeping its aspect ratio when frameWidth and
+    // frameHeight are known. For applications without a scene graph: clears the viewport first.
+    void drawFrame(const GstPlayer::Texture &texture, int frameWidth, int frameHeight,
+                   int viewportWidth, int viewportHeight, int rotation = 0,
+                   bool isFlipped = false);
+
+protected:
+    struct Program
+    {
+        GLuint id = 0;
+        GLint texture = -1;
+        GLint matrix = -1;
+        GLint opacity = -1;
+        GLint rect = -1;
+    };
+    // extensions: #extension directives of the fragment shader
+    static Program createProgram(const char *fragment, const char *extensions = "");
+    static GLuint compileShader(GLenum type, const char *source, const char *extensions);
+    static void deleteProgram(Program &program);
+    void bind(const Program &program, const Quad &quad);
+    void unbind();
+    void uploadOverlays();
+
+private:
+    Program m_program2D;
+    Program m_programExtOES;
+    Program m_programOverlay;
+    guint64 m_overlaySequence = 0;
+    std::vector<GstPlayer::Texture::Overlay> m_overlays;
+    std::vector<GLuint> m_overlayTextureIds;
+    bool m_isOverlayChanged = false;
+};
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "frametap.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace FrameTapLayout;
+
+/**************************************************************************************************************
+ *
+ * @brief  			FrameTap Class
+ *
+ * @remarks 		Publishes decoded frames into a POSIX shared memory ring so that local processes can
+ *                  read them in place. Each slot is protected by a sequence lock: the writer never
+ *                  waits for readers, and readers detect frames overwritten while being read.
+ *
+ **************************************************************************************************************/
+
+FrameTap::FrameTap(std::string name, uint32_t slotCount)
+    : m_name(name[0] == '/' ? name : "/" + name), m_slotCount(slotCount)
+{
+}
+
+FrameTap::~FrameTap()
+{
+    unmap();
+    if (m_fd >= 0) {
+        close(m_fd);
+        shm_unlink(m_name.data());
+    }
+}
+
+Header *FrameTap::header()
+{
+    return reinterpret_cast<Header *>(m_memory);
+}
+
+Slot *FrameTap::slot(uint32_t index)
+{
+    return reinterpret_cast<Slot *>(m_memory + align(sizeof(Header))
+                                    + index * slotStride(header()->slotSize));
+}
+
+bool FrameTap::publish(const Frame &frame)
+{
+    uint64_t offset[MaxPlanes];
+    uint64_t size = 0;
+    uint32_t planes = (frame.planes < MaxPlanes) ? frame.planes : MaxPlanes;
+    for (uint32_t i = 0; i < planes; i++) {
+        offset[i] = size;
+        size += align(frame.planeSize[i]);
+    }
+
+    if (m_memory == nullptr || size > header()->slotSize) {
+        if (map(size) == false) {
+            return false;
+        }
+    }
+
+    m_sequence++;
+    Slot *target = slot((m_sequence - 1) % m_slotCount);
+    uint8_t *data = reinterpret_cast<uint8_t *>(target) + align(sizeof(Slot));
+
+    // Odd lock value while the slot is being written
+    uint64_t lock = target->lock.load(std::memory_order_relaxed);
+    target->lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    target->sequence = m_sequence;
+    target->pts = frame.pts;
+    strncpy(target->format, frame.format, sizeof(target->format) - 1);
+    target->format[sizeof(target->format) - 1] = '\0';
+    target->width = frame.width;
+    target->height = frame.height;
+    target->planes = planes;
+    for (uint32_t i = 0; i < planes; i++) {
+        target->stride[i] = frame.stride[i];
+        target->offset[i] = offset[i];
+        memcpy(data + offset[i], frame.data[i], frame.planeSize[i]);
+    }
+    target->size = size;
+
+    target->lock.store(lock + 2, std::memory_order_release);
+    header()->writeSequence.store(m_sequence, std::memory_order_release);
+    return true;
+}
+
+bool FrameTap::map(uint64_t slotSize)
+{
+    if (m_fd < 0) {
+        m_fd = shm_open(m_name.data(), O_CREAT | O_RDWR, 0660);
+        if (m_fd < 0) {
+            perror("FrameTap: shm_open");
+            return false;
+        }
+    }
+
+    // Readers remap when the generation changes, the header is invalid in the meantime
+    if (m_memory != nullptr) {
+        header()->magic.store(0, std::memory_order_release);
+    }
+    unmap();
+
+    // The object only grows, so that reader registrations are kept
+    size_t size = totalSize(m_slotCount, slotSize);
+    struct stat status;
+    if (fstat(m_fd, &status) == 0 && static_cast<size_t>(status.st_size) > size) {
+        size = status.st_size;
+    } else if (ftruncate(m_fd, size) != 0) {
+        perror("FrameTap: ftruncate");
+        return false;
+    }
+
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (memory == MAP_FAILED) {
+        perror("FrameTap: mmap");
+        return false;
+    }
+    m_memory = static_cast<uint8_t *>(memory);
+    m_size = size;
+
+    Header *h = header();
+    h->version = Version;
+    h->slotCount = m_slotCount;
+    h->slotSize = align(slotSize);
+    for (uint32_t i = 0; i < m_slotCount; i++) {
+        slot(i)->lock.store(0, std::memory_order_relaxed);
+        slot(i)->sequence = 0;
+    }
+    h->writeSequence.store(m_sequence, std::memory_order_relaxed);
+    h->generation.store(++m_generation, std::memory_order_relaxed);
+    h->magic.store(Magic, std::memory_order_release);
+    return true;
+}
+
+void FrameTap::unmap()
+{
+    if (m_memory != nullptr) {
+        munmap(m_memory, m_size);
+        m_memory = nullptr;
+        m_size = 0;
+    }
+}
+
+/**************************************************************************************************************
+ *
+ * @brief  			FrameTapReader Class
+ *
+ * @remarks 		Reads the frames published by a FrameTap from another process
+ *
+ **************************************************************************************************************/
+
+FrameTapReader::FrameTapReader(std::string name) : m_name(name[0] == '/' ? name : "/" + name) { }
+
+FrameTapReader::~FrameTapReader()
+{
+    close();
+}
+
+bool FrameTapReader::open()
+{
+    if (m_fd < 0) {
+        m_fd = shm_open(m_name.data(), O_RDWR, 0);
+        if (m_fd < 0) {
+            return false;
+        }
+    }
+    if (remap() == false) {
+        return false;
+    }
+
+    // Register, so that the writer side can report per reader progress. Entries of readers that
+    // exited without close() (killed, crashed) are taken over, otherwise they would stay used.
+    Header *header = reinterpret_cast<Header *>(m_memory);
+    uint32_t pid = static_cast<uint32_t>(getpid());
+    for (uint32_t i = 0; i < MaxReaders && m_readerIndex < 0; i++) {
+        uint32_t expected = header->readers[i].pid.load();
+        if (expected != 0 && isProcessAlive(expected)) {
+            continue;
+        }
+        if (header->readers[i].pid.compare_exchange_strong(expected, pid)) {
+            header->readers[i].sequence.store(m_sequence, std::memory_order_relaxed);
+            m_readerIndex = static_cast<int>(i);
+        }
+    }
+    return true;
+}
+
+void FrameTapReader::close()
+{
+    if (m_memory != nullptr) {
+        if (m_readerIndex >= 0) {
+            reinterpret_cast<Header *>(m_memory)->readers[m_readerIndex].pid.store(0);
+            m_readerIndex = -1;
+        }
+        munmap(m_memory, m_size);
+        m_memory = nullptr;
+        m_size = 0;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool FrameTapReader::isProcessAlive(uint32_t pid)
+{
+    // EPERM: the process exists but belongs to another user
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+
+bool FrameTapReader::remap()
+{
+    struct stat status;
+    if (fstat(m_fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+        return false;
+    }
+    if (m_memory != nullptr) {
+        munmap(m_memory, m_size);
+    }
+    void *memory = mmap(nullptr, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (memory == MAP_FAILED) {
+        m_memory = nullptr;
+        m_size = 0;
+        return false;
+    }
+    m_memory = static_cast<uint8_t *>(memory);
+    m_size = status.st_size;
+    m_generation = reinterpret_cast<Header *>(m_memory)->generation.load();
+    return true;
+}
+
+const Slot *FrameTapReader::acquire(const uint8_t **data)
+{
+    if (m_memory == nullptr && open() == false) {
+        return nullptr;
+    }
+
+    Header *header = reinterpret_cast<Header *>(m_memory);
+    if (header->magic.load(std::memory_order_acquire) != Magic || header->version != Version) {
+        return nullptr;
+    }
+    if (header->generation.load(std::memory_order_acquire) != m_generation
+        && remap() == false) {
+        return nullptr;
+    }
+    header = reinterpret_cast<Header *>(m_memory);
+
+    uint64_t sequence = header->writeSequence.load(std::memory_order_acquire);
+    if (sequence == 0 || sequence == m_sequence) {
+        return nullptr;
+    }
+
+    const Slot *slot = reinterpret_cast<const Slot *>(
+            m_memory + align(sizeof(Header))
+            + ((sequence - 1) % header->slotCount) * slotStride(header->slotSize));
+    m_lock = slot->lock.load(std::memory_order_acquire);
+    if ((m_lock & 1) != 0 || slot->sequence != sequence) {
+        // Being rewritten, a newer frame is available on next call
+        return nullptr;
+    }
+
+    if (m_sequence != 0 && sequence > m_sequence + 1) {
+        m_lostFrames += sequence - m_sequence - 1;
+    }
+    m_sequence = sequence;
+    if (m_readerIndex >= 0) {
+        header->readers[m_readerIndex].sequence.store(sequence, std::memory_order_relaxed);
+    }
+
+    *data = reinterpret_cast<const uint8_t *>(slot) + align(sizeof(Slot));
+    return slot;
+}
+
+bool FrameTapReader::release(const Slot *slot)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->lock.load(std::memory_order_relaxed) == m_lock;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Shared memory layout of a frame tap, as seen by the writer (GstPlayer) and by the readers of
+// other processes. The object contains a FrameTapHeader followed by slotCount slots, each made
+// of a FrameTapSlot header and slotSize bytes of frame data.
+namespace FrameTapLayout {
+constexpr uint32_t Magic = 0x46543256; // "V2TF"
+constexpr uint32_t Version = 1;
+constexpr uint32_t MaxReaders = 8;
+constexpr uint32_t MaxPlanes = 4;
+constexpr size_t Alignment = 64;
+
+struct Reader
+{
+    // Process id of the reader, 0 when the entry is free. The entry of a process that no longer
+    // exists is free as well.
+    std::atomic<uint32_t> pid;
+    // Sequence of the last frame read
+    std::atomic<uint64_t> sequence;
+};
+
+struct Header
+{
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    // Incremented each time the writer resizes the shared memory object
+    std::atomic<uint32_t> generation;
+    uint32_t slotCount;
+    uint64_t slotSize;
+    // Sequence of the last published frame, 0 when none
+    std::atomic<uint64_t> writeSequence;
+    Reader readers[MaxReaders];
+};
+
+struct Slot
+{
+    // Sequence lock: odd while the writer updates the slot
+    std::atomic<uint64_t> lock;
+    uint64_t sequence;
+    uint64_t pts;
+    char format[16];
+    uint32_t width;
+    uint32_t height;
+    uint32_t planes;
+    uint32_t stride[MaxPlanes];
+    uint64_t offset[MaxPlanes];
+    uint64_t size;
+};
+
+constexpr size_t align(size_t size)
+{
+    return (size + Alignment - 1) & ~(Alignment - 1);
+}
+
+constexpr size_t slotStride(uint64_t slotSize)
+{
+    return align(sizeof(Slot)) + align(slotSize);
+}
+
+constexpr size_t totalSize(uint32_t slotCount, uint64_t slotSize)
+{
+    return align(sizeof(Header)) + slotCount * slotStride(slotSize);
+}
+} // namespace FrameTapLayout
+
+class FrameTap
+{
+public:
+    struct Frame
+    {
+        const char *format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t planes;
+        const uint32_t *stride;
+        const uint64_t *planeSize;
+        const uint8_t *const *data;
+        uint64_t pts;
+    };
+
+    explicit FrameTap(std::string name, uint32_t slotCount = DefaultSlotCount);
+    ~FrameTap();
+
+    bool publish(const Frame &frame);
+    const std::string &getName() { return m_name; }
+
+    static constexpr uint32_t DefaultSlotCount = 4;
+
+protected:
+    bool map(uint64_t slotSize);
+    void unmap();
+    FrameTapLayout::Header *header();
+    FrameTapLayout::Slot *slot(uint32_t index);
+
+private:
+    std::string m_name;
+    uint32_t m_slotCount;
+    uint32_t m_generation = 0;
+    int m_fd = -1;
+    uint8_t *m_memory = nullptr;
+    size_t m_size = 0;
+    uint64_t m_sequence = 0;
+};
+
+class FrameTapReader
+{
+public:
+    explicit FrameTapReader(std::string name);
+    ~FrameTapReader();
+
+    bool open();
+    void close();
+    // Latest frame newer than the previous one read, data is read in place. Returns nullptr when
+    // there is no new frame.
+    const FrameTapLayout::Slot *acquire(const uint8_t **data);
+    // True if the frame returned by acquire() was not overwritten while it was being read
+    bool release(const FrameTapLayout::Slot *slot);
+    uint64_t getLostFrames() { return m_lostFrames; }
+
+protected:
+    bool remap();
+    static bool isProcessAlive(uint32_t pid);
+
+private:
+    std::string m_name;
+    int m_fd = -1;
+    uint8_t *m_memory = nullptr;
+    size_t m_size = 0;
+    uint32_t m_generation = 0;
+    int m_readerIndex = -1;
+    uint64_t m_sequence = 0;
+    uint64_t m_lock = 0;
+    uint64_t m_lostFrames = 0;
+};
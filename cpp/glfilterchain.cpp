@@ -0,0 +1,533 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "glfilterchain.hpp"
+#include <QImage>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QVector2D>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+const GLint TextureUnit = 0;
+
+// Bicubic and Lanczos kernels are 0 beyond 2 texels
+constexpr float KernelSupport = 2.0f;
+// Downscaling beyond it aliases rather than sampling (2 * 4)^2 taps per pixel
+constexpr float MaxFilterScale = 4.0f;
+
+const std::array<GLfloat, 4 * 2> PassVertices = { -1.0f, -1.0f, 1.0f, -1.0f,
+                                                  -1.0f, 1.0f,  1.0f, 1.0f };
+const std::array<GLfloat, 4 * 2> PassTexcoords = { 0.0f, 0.0f, 1.0f, 0.0f,
+                                                   0.0f, 1.0f, 1.0f, 1.0f };
+
+constexpr const char *VertexSource = "attribute highp vec4 a_vertices;\n"
+                                     "attribute highp vec2 a_coords;\n"
+                                     "varying highp vec2 v_coords;\n"
+                                     "void main() {\n"
+                                     "    v_coords = a_coords;\n"
+                                     "    gl_Position = a_vertices;\n"
+                                     "}\n";
+
+// Fetches are made in the input texture, at u_texelSize steps around the transformed coordinate
+constexpr const char *SamplerNone = "vec4 filterSample(vec2 c) {\n"
+                                    "    return fetch(c);\n"
+                                    "}\n";
+
+// Catmull-Rom, 4x4 taps
+constexpr const char *SamplerBicubic =
+        "float filterWeight(float x) {\n"
+        "    x = abs(x);\n"
+        "    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;\n"
+        "    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;\n"
+        "    return 0.0;\n"
+        "}\n";
+
+// Lanczos with a = 2, 4x4 taps
+constexpr const char *SamplerLanczos =
+        "float filterWeight(float x) {\n"
+        "    x = abs(x);\n"
+        "    if (x < 1e-4) return 1.0;\n"
+        "    if (x >= 2.0) return 0.0;\n"
+        "    float px = 3.14159265 * x;\n"
+        "    return 2.0 * sin(px) * sin(px * 0.5) / (px * px);\n"
+        "}\n";
+
+// When downscaling, the kernel is stretched by u_filterScale (input texels per output pixel) so
+// that every input texel contributes, with %1 taps on each side of the center
+constexpr const char *SamplerSeparable =
+        "uniform vec2 u_filterScale;\n"
+        "vec4 filterSample(vec2 c) {\n"
+        "    vec2 pixel = c / u_texelSize - 0.5;\n"
+        "    vec2 base = floor(pixel);\n"
+        "    vec2 f = pixel - base;\n"
+        "    vec4 sum = vec4(0.0);\n"
+        "    float total = 0.0;\n"
+        "    for (int j = 1 - %1; j <= %1; j++) {\n"
+        "        float wy = filterWeight((float(j) - f.y) / u_filterScale.y);\n"
+        "        for (int i = 1 - %1; i <= %1; i++) {\n"
+        "            float w = filterWeight((float(i) - f.x) / u_filterScale.x) * wy;\n"
+        "            sum += w * fetch((base + vec2(float(i), float(j)) + 0.5) * u_texelSize);\n"
+        "            total += w;\n"
+        "        }\n"
+        "    }\n"
+        "    return sum / total;\n"
+        "}\n";
+
+// Unsharp mask with a 4-neighbour Laplacian
+constexpr const char *SamplerSharpen =
+        "uniform float u_strength;\n"
+        "vec4 filterSample(vec2 c) {\n"
+        "    vec4 center = fetch(c);\n"
+        "    vec4 neighbours = fetch(c - vec2(u_texelSize.x, 0.0))\n"
+        "            + fetch(c + vec2(u_texelSize.x, 0.0))\n"
+        "            + fetch(c - vec2(0.0, u_texelSize.y))\n"
+        "            + fetch(c + vec2(0.0, u_texelSize.y));\n"
+        "    return clamp(center + u_strength * (4.0 * center - neighbours), 0.0, 1.0);\n"
+        "}\n";
+
+// Blend deinterlacing: each line is mixed with the lines of the other field
+constexpr const char *SamplerDeinterlace =
+        "vec4 filterSample(vec2 c) {\n"
+        "    vec2 line = vec2(0.0, u_texelSize.y);\n"
+        "    return 0.25 * fetch(c - line) + 0.5 * fetch(c) + 0.25 * fetch(c + line);\n"
+        "}\n";
+
+// The N x N x N LUT is stored as N slices of N x N pixels side by side, slices indexed by blue
+constexpr const char *LutFunction =
+        "uniform sampler2D u_lut%1;\n"
+        "uniform float u_lutSize%1;\n"
+        "vec4 applyLut%1(vec4 color) {\n"
+        "    float n = u_lutSize%1;\n"
+        "    vec3 c = clamp(color.rgb, 0.0, 1.0) * (n - 1.0);\n"
+        "    float slice = floor(c.b);\n"
+        "    vec2 uv = vec2((c.r + 0.5) / (n * n), (c.g + 0.5) / n);\n"
+        "    vec3 a = texture2D(u_lut%1, uv + vec2(slice / n, 0.0)).rgb;\n"
+        "    vec3 b = texture2D(u_lut%1, uv + vec2(min(slice + 1.0, n - 1.0) / n, 0.0)).rgb;\n"
+        "    return vec4(mix(a, b, c.b - slice), color.a);\n"
+        "}\n";
+
+bool isCoordFilter(GlFilterChain::FilterType type)
+{
+    return type == GlFilterChain::FilterType::Crop || type == GlFilterChain::FilterType::Rotate;
+}
+
+bool isScaleFilter(GlFilterChain::FilterType type)
+{
+    return type == GlFilterChain::FilterType::Bicubic
+            || type == GlFilterChain::FilterType::Lanczos;
+}
+
+// Maps output coordinates to input coordinates
+QMatrix3x3 getCoordTransform(const GlFilterChain::Filter &filter)
+{
+    QMatrix3x3 transform;
+    if (filter.type == GlFilterChain::FilterType::Crop) {
+        transform(0, 0) = filter.params[2];
+        transform(0, 2) = filter.params[0];
+        transform(1, 1) = filter.params[3];
+        transform(1, 2) = filter.params[1];
+    } else if (filter.type == GlFilterChain::FilterType::Rotate) {
+        // Rotation around the center of the texture
+        float angle = filter.params[0] * static_cast<float>(M_PI) / 180.0f;
+        float c = std::round(std::cos(angle));
+        float s = std::round(std::sin(angle));
+        transform(0, 0) = c;
+        transform(0, 1) = s;
+        transform(0, 2) = 0.5f - 0.5f * (c + s);
+        transform(1, 0) = -s;
+        transform(1, 1) = c;
+        transform(1, 2) = 0.5f - 0.5f * (c - s);
+    }
+    return transform;
+}
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			GlFilterChain Class
+ *
+ * @remarks 		GPU post-processing of the video texture. Filters are grouped into passes rendered
+ *                  into pooled FBOs, each pass reading the output of the previous one. Adjacent
+ *                  filters share a pass, and a generated shader, whenever possible.
+ *
+ **************************************************************************************************************/
+
+std::vector<GlFilterChain::Filter> GlFilterChain::parse(const QString &description)
+{
+    std::vector<Filter> filters;
+    for (const QString &entry : description.split(';', Qt::SkipEmptyParts)) {
+        QString name = entry.section(':', 0, 0).trimmed().toLower();
+        QString arguments = entry.section(':', 1).trimmed();
+        QStringList values = arguments.split(',', Qt::SkipEmptyParts);
+
+        Filter filter;
+        if (name == "bicubic" || name == "lanczos") {
+            filter.type = (name == "bicubic") ? FilterType::Bicubic : FilterType::Lanczos;
+            QStringList size = arguments.split('x');
+            if (size.size() == 2) {
+                filter.params[0] = size[0].toFloat();
+                filter.params[1] = size[1].toFloat();
+            } else {
+                filter.params[2] = arguments.isEmpty() ? 1.0f : arguments.toFloat();
+            }
+        } else if (name == "sharpen") {
+            filter.type = FilterType::Sharpen;
+            filter.params[0] = arguments.isEmpty() ? 0.5f : arguments.toFloat();
+        } else if (name == "deinterlace") {
+            filter.type = FilterType::Deinterlace;
+        } else if (name == "lut" && arguments.isEmpty() == false) {
+            filter.type = FilterType::Lut;
+            filter.path = arguments;
+        } else if (name == "crop" && values.size() == 4) {
+            filter.type = FilterType::Crop;
+            for (int i = 0; i < 4; i++) {
+                filter.params[i] = qBound(0.0f, values[i].toFloat(), 1.0f);
+            }
+        } else if (name == "rotate" && values.size() == 1) {
+            filter.type = FilterType::Rotate;
+            // Only quarter turns keep the pixel grid
+            filter.params[0] = std::round(values[0].toFloat() / 90.0f) * 90.0f;
+        } else {
+            qWarning() << "Ignoring invalid filter" << entry;
+            continue;
+        }
+        filters.push_back(filter);
+    }
+    return filters;
+}
+
+GlFilterChain::~GlFilterChain()
+{
+    releaseResources();
+}
+
+void GlFilterChain::setFilters(const std::vector<Filter> &filters)
+{
+    m_filters = filters;
+    m_isDirty = true;
+}
+
+void GlFilterChain::buildPasses()
+{
+    m_passes.clear();
+
+    Pass pass;
+    bool isEmptyPass = true;
+    for (const Filter &filter : m_filters) {
+        bool isColorOp = (filter.type == FilterType::Lut);
+        bool isCoord = isCoordFilter(filter.type);
+
+        // Coordinate transforms are applied before sampling, neighbourhood filters need the
+        // unmodified input: both start a new pass once sampling or color ops are in place.
+        bool needsNewPass = isColorOp ? false
+                                      : (pass.sampler != nullptr || pass.colorOps.empty() == false);
+        if (needsNewPass && isEmptyPass == false) {
+            m_passes.push_back(pass);
+            pass = Pass();
+        }
+
+        if (isColorOp) {
+            pass.colorOps.push_back(&filter);
+        } else if (isCoord) {
+            pass.coordTransform = pass.coordTransform * getCoordTransform(filter);
+            pass.coordFilters.push_back(&filter);
+        } else {
+            pass.sampler = &filter;
+        }
+        isEmptyPass = false;
+    }
+    if (isEmptyPass == false) {
+        m_passes.push_back(pass);
+    }
+
+    m_isDirty = false;
+}
+
+void GlFilterChain::getOutputSize(const Pass &pass, int &width, int &height)
+{
+    for (const Filter *filter : pass.coordFilters) {
+        if (filter->type == FilterType::Crop) {
+            width = std::max(1, static_cast<int>(std::lround(width * filter->params[2])));
+            height = std::max(1, static_cast<int>(std::lround(height * filter->params[3])));
+        } else if (static_cast<int>(filter->params[0]) % 180 != 0) {
+            std::swap(width, height);
+        }
+    }
+
+    if (pass.sampler != nullptr && isScaleFilter(pass.sampler->type)) {
+        if (pass.sampler->params[0] > 0.0f && pass.sampler->params[1] > 0.0f) {
+            width = static_cast<int>(pass.sampler->params[0]);
+            height = static_cast<int>(pass.sampler->params[1]);
+        } else if (pass.sampler->params[2] > 0.0f) {
+            width = std::max(1, static_cast<int>(std::lround(width * pass.sampler->params[2])));
+            height = std::max(1, static_cast<int>(std::lround(height * pass.sampler->params[2])));
+        }
+    }
+}
+
+QVector2D GlFilterChain::getFilterScale(const Pass &pass, int width, int height, int outputWidth,
+                                        int outputHeight)
+{
+    // Size of the transformed input in output orientation, as in getOutputSize()
+    bool isSwapped = false;
+    for (const Filter *filter : pass.coordFilters) {
+        if (filter->type == FilterType::Crop) {
+            width = std::max(1, static_cast<int>(std::lround(width * filter->params[2])));
+            height = std::max(1, static_cast<int>(std::lround(height * filter->params[3])));
+        } else if (static_cast<int>(filter->params[0]) % 180 != 0) {
+            std::swap(width, height);
+            isSwapped = !isSwapped;
+        }
+    }
+    float scaleX = std::clamp(static_cast<float>(width) / outputWidth, 1.0f, MaxFilterScale);
+    float scaleY = std::clamp(static_cast<float>(height) / outputHeight, 1.0f, MaxFilterScale);
+    // Kernels are evaluated along the input texture axes
+    return isSwapped ? QVector2D(scaleY, scaleX) : QVector2D(scaleX, scaleY);
+}
+
+GLuint GlFilterChain::process(GLuint textureId, GLenum textureTarget, int width, int height)
+{
+    if (m_isDirty == true) {
+        buildPasses();
+    }
+    if (m_passes.empty() || width <= 0 || height <= 0) {
+        return textureId;
+    }
+
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    gl->glDisable(GL_SCISSOR_TEST);
+    gl->glDisable(GL_STENCIL_TEST);
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisable(GL_BLEND);
+
+    GLuint input = textureId;
+    GLenum target = textureTarget;
+    for (const Pass &pass : m_passes) {
+        int outputWidth = width;
+        int outputHeight = height;
+        getOutputSize(pass, outputWidth, outputHeight);
+        QVector2D filterScale = getFilterScale(pass, width, height, outputWidth, outputHeight);
+        int radius = static_cast<int>(
+                std::ceil(KernelSupport * std::max(filterScale.x(), filterScale.y())));
+
+        QOpenGLShaderProgram *program =
+                getProgram(pass, target == GL_TEXTURE_EXTERNAL_OES, radius);
+        if (program == nullptr) {
+            break;
+        }
+        Target &output = getTarget(outputWidth, outputHeight, input);
+        gl->glBindFramebuffer(GL_FRAMEBUFFER, output.fboId);
+        gl->glViewport(0, 0, outputWidth, outputHeight);
+
+        program->bind();
+        program->enableAttributeArray(0);
+        program->enableAttributeArray(1);
+        program->setAttributeArray(0, GL_FLOAT, PassVertices.data(), 2);
+        program->setAttributeArray(1, GL_FLOAT, PassTexcoords.data(), 2);
+        program->setUniformValue("u_texture", TextureUnit);
+        program->setUniformValue("u_texelSize", QVector2D(1.0f / width, 1.0f / height));
+        program->setUniformValue("u_coordTransform", pass.coordTransform);
+        if (pass.sampler != nullptr && pass.sampler->type == FilterType::Sharpen) {
+            program->setUniformValue("u_strength", pass.sampler->params[0]);
+        } else if (pass.sampler != nullptr && isScaleFilter(pass.sampler->type)) {
+            program->setUniformValue("u_filterScale", filterScale);
+        }
+        for (size_t i = 0; i < pass.colorOps.size(); i++) {
+            const QString &path = pass.colorOps[i]->path;
+            GLint unit = TextureUnit + 1 + static_cast<GLint>(i);
+            gl->glActiveTexture(GL_TEXTURE0 + unit);
+            gl->glBindTexture(GL_TEXTURE_2D, getLut(path));
+            program->setUniformValue(QString("u_lut%1").arg(i).toLatin1().data(), unit);
+            program->setUniformValue(QString("u_lutSize%1").arg(i).toLatin1().data(),
+                                     static_cast<GLfloat>(m_lutSizes[path]));
+        }
+
+        gl->glActiveTexture(GL_TEXTURE0 + TextureUnit);
+        gl->glBindTexture(target, input);
+        gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        program->disableAttributeArray(0);
+        program->disableAttributeArray(1);
+        program->release();
+
+        input = output.textureId;
+        target = GL_TEXTURE_2D;
+        width = outputWidth;
+        height = outputHeight;
+    }
+    return input;
+}
+
+QOpenGLShaderProgram *GlFilterChain::getProgram(const Pass &pass, bool isExternal, int radius)
+{
+    QString fragment = generateFragment(pass, isExternal, radius);
+    auto cached = m_programs.find(fragment);
+    if (cached != m_programs.end()) {
+        return cached->second.get();
+    }
+
+    auto program = std::make_unique<QOpenGLShaderProgram>();
+    program->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, VertexSource);
+    program->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, fragment);
+    program->bindAttributeLocation("a_vertices", 0);
+    program->bindAttributeLocation("a_coords", 1);
+    if (program->link() == false) {
+        qWarning() << "Cannot link filter shader:" << program->log();
+        return nullptr;
+    }
+    return (m_programs[fragment] = std::move(program)).get();
+}
+
+QString GlFilterChain::generateFragment(const Pass &pass, bool isExternal, int radius)
+{
+    QString source;
+    if (isExternal) {
+        source += "#extension GL_OES_EGL_image_external: require\n";
+    }
+    source += "#ifdef GL_ES\n"
+              "precision highp float;\n"
+              "#endif\n";
+    source += isExternal ? "uniform samplerExternalOES u_texture;\n"
+                         : "uniform sampler2D u_texture;\n";
+    source += "uniform vec2 u_texelSize;\n"
+              "uniform mat3 u_coordTransform;\n"
+              "varying highp vec2 v_coords;\n"
+              "vec4 fetch(vec2 c) {\n"
+              "    return texture2D(u_texture, c);\n"
+              "}\n";
+
+    FilterType sampler = (pass.sampler != nullptr) ? pass.sampler->type : FilterType::Crop;
+    switch (sampler) {
+    case FilterType::Bicubic:
+        source += SamplerBicubic;
+        source += QString(SamplerSeparable).arg(radius);
+        break;
+    case FilterType::Lanczos:
+        source += SamplerLanczos;
+        source += QString(SamplerSeparable).arg(radius);
+        break;
+    case FilterType::Sharpen:
+        source += SamplerSharpen;
+        break;
+    case FilterType::Deinterlace:
+        source += SamplerDeinterlace;
+        break;
+    default:
+        source += SamplerNone;
+        break;
+    }
+
+    for (size_t i = 0; i < pass.colorOps.size(); i++) {
+        source += QString(LutFunction).arg(i);
+    }
+
+    source += "void main() {\n"
+              "    vec2 c = (u_coordTransform * vec3(v_coords, 1.0)).xy;\n"
+              "    vec4 color = filterSample(c);\n";
+    for (size_t i = 0; i < pass.colorOps.size(); i++) {
+        source += QString("    color = applyLut%1(color);\n").arg(i);
+    }
+    source += "    gl_FragColor = color;\n"
+              "}\n";
+    return source;
+}
+
+GlFilterChain::Target &GlFilterChain::getTarget(int width, int height, GLuint excludedTexture)
+{
+    // Ping-pong: any target of the right size except the one being read
+    for (Target &target : m_targets) {
+        if (target.width == width && target.height == height
+            && target.textureId != excludedTexture) {
+            return target;
+        }
+    }
+
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    Target target;
+    gl->glGenTextures(1, &target.textureId);
+    gl->glBindTexture(GL_TEXTURE_2D, target.textureId);
+    gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    gl->glGenFramebuffers(1, &target.fboId);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, target.fboId);
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               target.textureId, 0);
+    GLenum status = gl->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        qInfo() << "ERROR: Filter FBO is incomplete. Status is " << status;
+    }
+
+    target.width = width;
+    target.height = height;
+    m_targets.push_back(target);
+    return m_targets.back();
+}
+
+GLuint GlFilterChain::getLut(const QString &path)
+{
+    auto cached = m_luts.find(path);
+    if (cached != m_luts.end()) {
+        return cached->second;
+    }
+
+    QImage image = QImage(path).convertToFormat(QImage::Format_RGBA8888);
+    if (image.isNull() || image.width() != image.height() * image.height()) {
+        qWarning() << "Invalid LUT image" << path << ", expected N slices of N x N pixels";
+        image = QImage(4, 2, QImage::Format_RGBA8888);
+        // Identity 2 x 2 x 2 LUT
+        for (int b = 0; b < 2; b++) {
+            for (int g = 0; g < 2; g++) {
+                for (int r = 0; r < 2; r++) {
+                    image.setPixel(b * 2 + r, g, qRgba(r * 255, g * 255, b * 255, 255));
+                }
+            }
+        }
+    }
+
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    GLuint textureId = 0;
+    gl->glGenTextures(1, &textureId);
+    gl->glBindTexture(GL_TEXTURE_2D, textureId);
+    gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, image.constBits());
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    m_luts[path] = textureId;
+    m_lutSizes[path] = image.height();
+    return textureId;
+}
+
+void GlFilterChain::releaseResources()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (context != nullptr) {
+        QOpenGLFunctions *gl = context->functions();
+        for (Target &target : m_targets) {
+            gl->glDeleteFramebuffers(1, &target.fboId);
+            gl->glDeleteTextures(1, &target.textureId);
+        }
+        for (auto &[path, textureId] : m_luts) {
+            gl->glDeleteTextures(1, &textureId);
+        }
+    }
+    m_targets.clear();
+    m_luts.clear();
+    m_lutSizes.clear();
+    m_programs.clear();
+    m_isDirty = true;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <QMatrix3x3>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <QVector2D>
+#include <map>
+#include <memory>
+#include <vector>
+
+class GlFilterChain
+{
+public:
+    enum class FilterType { Bicubic, Lanczos, Sharpen, Deinterlace, Lut, Crop, Rotate };
+
+    struct Filter
+    {
+        FilterType type;
+        // Bicubic/Lanczos: output width, height (pixels) or scale factor in width only
+        // Sharpen: strength; Crop: x, y, width, height (normalized); Rotate: degrees
+        float params[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        // Lut: image holding an N x N x N LUT as N slices of N x N side by side
+        QString path;
+    };
+
+    // Parses "filter[:arguments]" entries separated by ';', e.g.
+    // "crop:0.1,0,0.8,1;lanczos:1280x720;sharpen:0.5;lut:/home/root/grade.png"
+    static std::vector<Filter> parse(const QString &description);
+
+    ~GlFilterChain();
+
+    void setFilters(const std::vector<Filter> &filters);
+    bool isEmpty() { return m_filters.empty(); }
+    int getPassCount() { return static_cast<int>(m_passes.size()); }
+
+    // Runs all passes, returns the GL_TEXTURE_2D holding the result. Leaves the framebuffer of
+    // the last pass bound.
+    GLuint process(GLuint textureId, GLenum textureTarget, int width, int height);
+    void releaseResources();
+
+protected:
+    // A pass is: one coordinate transform, at most one neighbourhood filter, then any number of
+    // per-pixel color operations. Adjacent filters are fused into a pass whenever this holds.
+    struct Pass
+    {
+        QMatrix3x3 coordTransform;
+        std::vector<const Filter *> coordFilters;
+        const Filter *sampler = nullptr;
+        std::vector<const Filter *> colorOps;
+    };
+
+    struct Target
+    {
+        GLuint fboId = 0;
+        GLuint textureId = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    void buildPasses();
+    void getOutputSize(const Pass &pass, int &width, int &height);
+    // Input texels per output pixel along the input texture axes, at least 1
+    QVector2D getFilterScale(const Pass &pass, int width, int height, int outputWidth,
+                             int outputHeight);
+    // radius: taps on each side of the center for the scale filters
+    QOpenGLShaderProgram *getProgram(const Pass &pass, bool isExternal, int radius);
+    QString generateFragment(const Pass &pass, bool isExternal, int radius);
+    Target &getTarget(int width, int height, GLuint excludedTexture);
+    GLuint getLut(const QString &path);
+
+private:
+    std::vector<Filter> m_filters;
+    std::vector<Pass> m_passes;
+    bool m_isDirty = false;
+    std::map<QString, std::unique_ptr<QOpenGLShaderProgram>> m_programs;
+    std::vector<Target> m_targets;
+    std::map<QString, GLuint> m_luts;
+    std::map<QString, int> m_lutSizes;
+};
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "glframeexporter.hpp"
+#include <QOpenGLContext>
+#include <QDebug>
+
+/**************************************************************************************************************
+ *
+ * @brief  			GlFrameExporter Class
+ *
+ * @remarks 		Asynchronous readback of rendered frames. Frames are rendered into a pool of FBOs and
+ *                  read back into a ring of pixel pack buffers guarded by fences, so that the
+ *                  render thread never waits for the GPU. Requires OpenGL ES 3.0.
+ *
+ **************************************************************************************************************/
+
+GlFrameExporter::GlFrameExporter(int poolSize) : m_slots(poolSize) { }
+
+GlFrameExporter::~GlFrameExporter()
+{
+    releaseResources();
+}
+
+void GlFrameExporter::setCallback(Callback callback)
+{
+    m_callback = std::move(callback);
+}
+
+bool GlFrameExporter::beginFrame(int width, int height)
+{
+    if (m_gl == nullptr) {
+        QOpenGLContext *context = QOpenGLContext::currentContext();
+        if (context->format().majorVersion() < 3) {
+            qWarning() << "Frame export requires OpenGL ES 3.0";
+            return false;
+        }
+        m_gl = context->extraFunctions();
+    }
+
+    // Never stall: drop the frame when every slot is still in flight
+    if (m_pending == static_cast<int>(m_slots.size())) {
+        m_droppedFrames++;
+        return false;
+    }
+
+    Slot &slot = m_slots[m_writeSlot];
+    if (slot.width != width || slot.height != height) {
+        release(slot);
+        allocate(slot, width, height);
+    }
+
+    m_gl->glBindFramebuffer(GL_FRAMEBUFFER, slot.fboId);
+    m_gl->glViewport(0, 0, width, height);
+    return true;
+}
+
+void GlFrameExporter::endFrame()
+{
+    Slot &slot = m_slots[m_writeSlot];
+
+    // Asynchronous copy into the pixel pack buffer, completion is signaled by the fence
+    m_gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboId);
+    m_gl->glReadPixels(0, 0, slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    m_gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = m_gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.index = m_frameIndex++;
+
+    m_writeSlot = (m_writeSlot + 1) % m_slots.size();
+    m_pending++;
+}
+
+void GlFrameExporter::collect()
+{
+    if (m_gl == nullptr) {
+        return;
+    }
+
+    // Deliver completed frames in order, without waiting for the ones still in flight
+    while (m_pending > 0) {
+        Slot &slot = m_slots[m_readSlot];
+        GLenum status = m_gl->glClientWaitSync(slot.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        m_gl->glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        if (m_callback) {
+            GLsizeiptr size = static_cast<GLsizeiptr>(slot.width) * slot.height * 4;
+            m_gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboId);
+            void *data = m_gl->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+            if (data != nullptr) {
+                m_callback({ slot.width, slot.height, slot.width * 4,
+                             static_cast<const uchar *>(data), slot.index });
+                m_gl->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            m_gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        m_readSlot = (m_readSlot + 1) % m_slots.size();
+        m_pending--;
+    }
+}
+
+void GlFrameExporter::releaseResources()
+{
+    if (m_gl != nullptr) {
+        for (Slot &slot : m_slots) {
+            release(slot);
+        }
+    }
+    m_writeSlot = 0;
+    m_readSlot = 0;
+    m_pending = 0;
+}
+
+void GlFrameExporter::allocate(Slot &slot, int width, int height)
+{
+    m_gl->glGenTextures(1, &slot.textureId);
+    m_gl->glBindTexture(GL_TEXTURE_2D, slot.textureId);
+    m_gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                       nullptr);
+    m_gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    m_gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    m_gl->glGenFramebuffers(1, &slot.fboId);
+    m_gl->glBindFramebuffer(GL_FRAMEBUFFER, slot.fboId);
+    m_gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                 slot.textureId, 0);
+    GLenum status = m_gl->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        qInfo() << "ERROR: Export FBO is incomplete. Status is " << status;
+    }
+
+    m_gl->glGenBuffers(1, &slot.pboId);
+    m_gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboId);
+    m_gl->glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr,
+                       GL_STREAM_READ);
+    m_gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.width = width;
+    slot.height = height;
+}
+
+void GlFrameExporter::release(Slot &slot)
+{
+    if (slot.fence != nullptr) {
+        m_gl->glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+    if (slot.pboId != 0) {
+        m_gl->glDeleteBuffers(1, &slot.pboId);
+        slot.pboId = 0;
+    }
+    if (slot.fboId != 0) {
+        m_gl->glDeleteFramebuffers(1, &slot.fboId);
+        slot.fboId = 0;
+    }
+    if (slot.textureId != 0) {
+        m_gl->glDeleteTextures(1, &slot.textureId);
+        slot.textureId = 0;
+    }
+    slot.width = 0;
+    slot.height = 0;
+}
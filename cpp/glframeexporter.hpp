@@ -0,0 +1,66 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <QOpenGLExtraFunctions>
+#include <functional>
+#include <vector>
+
+class GlFrameExporter
+{
+public:
+    struct Frame
+    {
+        int width;
+        int height;
+        int stride;
+        // RGBA pixels, top row first, only valid during the callback
+        const uchar *data;
+        quint64 index;
+    };
+    using Callback = std::function<void(const Frame &frame)>;
+
+    explicit GlFrameExporter(int poolSize = DefaultPoolSize);
+    ~GlFrameExporter();
+
+    void setCallback(Callback callback);
+    bool beginFrame(int width, int height);
+    void endFrame();
+    void collect();
+    void releaseResources();
+    quint64 getDroppedFrames() { return m_droppedFrames; }
+    // True while read back frames wait for collect()
+    bool isPending() { return m_pending > 0; }
+
+    // Frame N is mapped while the GPU renders frame N + 2
+    static constexpr int DefaultPoolSize = 3;
+
+protected:
+    struct Slot
+    {
+        GLuint fboId = 0;
+        GLuint textureId = 0;
+        GLuint pboId = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+        quint64 index = 0;
+    };
+
+    void allocate(Slot &slot, int width, int height);
+    void release(Slot &slot);
+
+private:
+    QOpenGLExtraFunctions *m_gl = nullptr;
+    std::vector<Slot> m_slots;
+    Callback m_callback;
+    int m_writeSlot = 0;
+    int m_readSlot = 0;
+    int m_pending = 0;
+    quint64 m_frameIndex = 0;
+    quint64 m_droppedFrames = 0;
+};
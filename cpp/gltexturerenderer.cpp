@@ -8,88 +8,21 @@
 #include "gltexturerenderer.hpp"
 
 #include <QOpenGLFunctions>
+#include <algorithm>
 
 namespace {
-const GLint TextureUnit = 0;
-
 const std::array<GLfloat, 4 * 2> OffscreenVertices = { -1.0f, -1.0f, 1.0f, -1.0f,
                                                        -1.0f, 1.0f,  1.0f, 1.0f };
-const std::array<GLfloat, 4 * 2> OffscreenTexcoords = { 0.0f, 0.0f, 1.0f, 0.0f,
-                                                        0.0f, 1.0f, 1.0f, 1.0f };
-
-constexpr std::string_view VertexSource = "attribute highp vec4 a_vertices;\n"
-                                          "attribute highp vec2 a_coords;\n"
-                                          "varying highp vec2 v_coords;\n"
-                                          "uniform highp mat4 u_matrix;\n"
-                                          "void main() {\n"
-                                          "    v_coords = a_coords;\n"
-                                          "    gl_Position = u_matrix * a_vertices;\n"
-                                          "}\n";
-
-constexpr std::string_view FragmentSource2D =
-        "uniform sampler2D u_texture;\n"
-        "uniform lowp float u_opacity;\n"
-        "varying highp vec2 v_coords;\n"
-        "void main() {\n"
-        "    gl_FragColor = u_opacity * texture2D(u_texture, v_coords);\n"
-        "}\n";
-
-constexpr std::string_view FragmentSourceExtOES =
-        "#extension GL_OES_EGL_image_external: require\n"
-        "uniform samplerExternalOES u_texture;\n"
-        "uniform lowp float u_opacity;\n"
-        "varying highp vec2 v_coords;\n"
-        "void main() {\n"
-        "    gl_FragColor = u_opacity * texture2D(u_texture, v_coords);\n"
-        "}\n";
-
+const std::array<GLfloat, 4 * 2> FullTexcoords = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
 } // namespace
 
-/**************************************************************************************************************
- *
- * @brief  			GlTextureProgram Class
- *
- * @remarks 		QOpenGLShaderProgram Class to handle vertex and fragment shader programs used by the 
- *                  GlTextureRenderer Class
- *
- **************************************************************************************************************/
-
-GlTextureProgram::GlTextureProgram(std::string_view vertex, std::string_view fragment)
-{
-    addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertex.data());
-    addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, fragment.data());
-
-    bindAttributeLocation("a_vertices", 0);
-    bindAttributeLocation("a_coords", 1);
-    link();
-
-    m_textureUniform = uniformLocation("u_texture");
-    m_matrixUniform = uniformLocation("u_matrix");
-    m_opacityUniform = uniformLocation("u_opacity");
-}
-
-GlTextureProgram::~GlTextureProgram() { }
-
-void GlTextureProgram::setTextureUnit(GLuint textureUnit)
-{
-    setUniformValue(m_textureUniform, textureUnit);
-}
-
-void GlTextureProgram::setMatrix(const QMatrix4x4 &matrix)
-{
-    setUniformValue(m_matrixUniform, matrix);
-}
-
-void GlTextureProgram::setOpacity(GLfloat opacity)
-{
-    setUniformValue(m_opacityUniform, opacity);
-}
-
 /**************************************************************************************************************
  *
  * @brief  			GlTextureRenderer Class
  *
- * @remarks 		QSGRenderNode Class responsible for rendering openGL texture inside QT application
+ * @remarks 		QSGRenderNode Class responsible for rendering openGL texture inside QT application.
+ *                  Drawing is done by EglTextureRenderer, this class maps the scene graph state and
+ *                  the item geometry onto it.
  *
  **************************************************************************************************************/
 
@@ -100,64 +33,91 @@ GlTextureRenderer::~GlTextureRenderer()
 
 void GlTextureRenderer::releaseResources()
 {
-    if (m_program2D != nullptr) {
-        delete m_program2D;
+    releaseFrameResources();
+    if (QOpenGLContext::currentContext() != nullptr) {
+        m_core.release();
     }
-    if (m_programExtOES != nullptr) {
-        delete m_programExtOES;
+    if (m_exporter != nullptr) {
+        delete m_exporter;
+        m_exporter = nullptr;
     }
-    if (m_textureOffscreenId != GL_INVALID_ID) {
-        glDeleteTextures(1, &m_textureOffscreenId);
-    }
-    if (m_fboId != GL_INVALID_ID) {
-        glDeleteFramebuffers(1, &m_fboId);
+}
+
+void GlTextureRenderer::releaseFrameResources()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (context != nullptr) {
+        QOpenGLFunctions *gl = context->functions();
+        if (m_textureOffscreenId != GL_INVALID_ID) {
+            gl->glDeleteTextures(1, &m_textureOffscreenId);
+        }
+        if (m_fboId != GL_INVALID_ID) {
+            gl->glDeleteFramebuffers(1, &m_fboId);
+        }
+        if (m_imageTextureId != GL_INVALID_ID) {
+            gl->glDeleteTextures(1, &m_imageTextureId);
+        }
+        m_core.releaseOverlays();
     }
+    m_textureOffscreenId = GL_INVALID_ID;
+    m_fboId = GL_INVALID_ID;
+    m_imageTextureId = GL_INVALID_ID;
+    m_filterChain.releaseResources();
+    m_filteredTextureId = GL_INVALID_ID;
+    m_textureId = GL_INVALID_ID;
+    m_textureHold.reset();
 }
 
 void GlTextureRenderer::init()
 {
-    // Program using GL_TEXTURE_2D
-    m_program2D = new GlTextureProgram(VertexSource, FragmentSource2D);
-
-    // Program using GL_TEXTURE_EXTERNAL_OES
-    m_programExtOES = new GlTextureProgram(VertexSource, FragmentSourceExtOES);
+    if (m_core.init() == false) {
+        qWarning() << "Cannot create the texture programs";
+    }
 }
 
 void GlTextureRenderer::render(const RenderState *state)
 {
+    RenderTimer timer(this);
     QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
 
+    collectFrameExports();
+
     // Don't try to render an invalid texture
     if (m_textureId == GL_INVALID_ID) {
         return;
     }
 
+    // Post-processing passes run before the scene graph's framebuffer is bound
+    GLuint textureId = m_textureId;
+    GLenum textureTarget = m_textureTarget;
+    if (m_filterChain.isEmpty() == false) {
+        // The scene graph may redraw without a new frame, reuse the last output then
+        if (m_isTextureChanged || m_filteredTextureId == GL_INVALID_ID) {
+            m_filteredTextureId = applyFilters();
+        }
+        textureId = m_filteredTextureId;
+        textureTarget = GL_TEXTURE_2D;
+    }
+    m_isTextureChanged = false;
+
     enableFramebuffer();
 
-    GlTextureProgram *program;
-    if (m_textureTarget == GL_TEXTURE_EXTERNAL_OES) {
-        program = m_programExtOES;
-    } else {
-        program = m_program2D;
+    if (m_exporter != nullptr && m_isExportRequested == true) {
+        exportFrame(textureId, textureTarget);
+        m_isExportRequested = false;
     }
-    program->bind();
-
-    program->enableAttributeArray(0);
-    program->enableAttributeArray(1);
 
+    EglTextureRenderer::Quad quad;
     if (m_isOffscreen == true) {
-        program->setAttributeArray(0, GL_FLOAT, OffscreenVertices.data(), 2);
-        program->setAttributeArray(1, GL_FLOAT, OffscreenTexcoords.data(), 2);
-        program->setMatrix(QMatrix4x4());
+        quad = getQuad(OffscreenVertices, getOffscreenMatrix(), 1.0f);
         gl->glDisable(GL_SCISSOR_TEST);
         gl->glDisable(GL_STENCIL_TEST);
         gl->glDisable(GL_DEPTH_TEST);
         gl->glDisable(GL_BLEND);
-        program->setOpacity(1.0f);
     } else {
-        program->setAttributeArray(0, GL_FLOAT, m_vertices.data(), 2);
-        program->setAttributeArray(1, GL_FLOAT, m_texcoords.data(), 2);
-        program->setMatrix(*state->projectionMatrix() * *matrix());
+        quad = getQuad(m_vertices,
+                       *state->projectionMatrix() * *this->matrix() * getItemTransform(),
+                       float(inheritedOpacity()));
 
         if (state->scissorEnabled()) {
             gl->glEnable(GL_SCISSOR_TEST);
@@ -179,27 +139,34 @@ void GlTextureRenderer::render(const RenderState *state)
         // we have to test against what's in the depth buffer already.
         gl->glEnable(GL_DEPTH_TEST);
 
-        program->setOpacity(float(inheritedOpacity()));
-
         gl->glEnable(GL_BLEND);
         gl->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
     }
 
-    // Bind texture
-    program->setTextureUnit(TextureUnit);
-    gl->glActiveTexture(GL_TEXTURE0 + TextureUnit);
-    gl->glBindTexture(m_textureTarget, m_textureId);
+    m_core.draw(textureId, textureTarget, quad);
+    // Same quad and geometry as the frame, so crop, orientation and letterboxing apply. Geometric
+    // filters of the chain are not taken into account.
+    m_core.drawOverlays(quad);
 
-    // Render states
-    gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-
-    gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    m_isFirstRenderDone = true;
+}
 
-    program->disableAttributeArray(0);
-    program->disableAttributeArray(1);
-    program->release();
+void GlTextureRenderer::setOverlays(quint64 sequence,
+                                    const std::vector<GstPlayer::Texture::Overlay> &overlays)
+{
+    m_core.setOverlays(sequence, overlays);
+}
 
-    m_isFirstRenderDone = true;
+EglTextureRenderer::Quad GlTextureRenderer::getQuad(const std::array<GLfloat, 4 * 2> &vertices,
+                                                    const QMatrix4x4 &matrix, float opacity)
+{
+    EglTextureRenderer::Quad quad;
+    quad.vertices = vertices;
+    quad.texcoords = m_texcoords;
+    // QMatrix4x4 data is column major, as expected by the core renderer
+    std::copy(matrix.constData(), matrix.constData() + 16, quad.matrix.begin());
+    quad.opacity = opacity;
+    return quad;
 }
 
 QSGRenderNode::StateFlags GlTextureRenderer::changedStates() const
@@ -212,23 +179,135 @@ QSGRenderNode::RenderingFlags GlTextureRenderer::flags() const
     return BoundedRectRendering | DepthAwareRendering;
 }
 
-QRectF GlTextureRenderer::rect() const
+guint64 GlTextureRenderer::updateFrame(GstPlayer *player)
 {
-    return QRect(0, 0, m_width, m_height);
+    GstPlayer::Texture texture = player->getTexture();
+    setTexture(texture.id, texture.target);
+    // Shared players: other renderers may pick up a newer frame before this one is drawn
+    m_textureHold = texture.hold;
+    setTextureSize(player->getWidth(), player->getHeight());
+    // Crop, orientation and transformation of the frame are applied when drawing it
+    setFrameTransform(QRectF(texture.crop[0], texture.crop[1], texture.crop[2], texture.crop[3]),
+                      player->getRotation(), player->isFlipped(),
+                      QMatrix4x4(texture.transform).transposed());
+    // Uploaded again only when the composition changes
+    setOverlays(texture.overlaySequence, texture.overlays);
+    return texture.generation;
 }
 
-void GlTextureRenderer::setSize(int width, int height)
+void GlTextureRenderer::holdFrame()
 {
-    m_width = width;
-    m_height = height;
-    m_vertices = { 0.0f,           0.0f,           m_width - 1.0f, 0.0f, 0.0f, m_height - 1.0f,
-                   m_width - 1.0f, m_height - 1.0f };
+    // The offscreen copy outlives the player's textures
+    setTexture(getOffscreenTexture());
+    setOffscreen(false);
+    m_textureHold.reset();
+}
+
+void GlTextureRenderer::setTextureSize(int width, int height)
+{
+    // Filters run again for the new size
+    if (m_textureWidth != width || m_textureHeight != height) {
+        m_isTextureChanged = true;
+    }
+    VideoRenderNode::setTextureSize(width, height);
 }
 
 void GlTextureRenderer::setTexture(GLuint textureId, GLenum textureTarget)
 {
     m_textureId = textureId;
     m_textureTarget = textureTarget;
+    m_isTextureChanged = true;
+}
+
+QImage GlTextureRenderer::grabImage()
+{
+    if (m_textureId == GL_INVALID_ID || m_core.isInitialized() == false) {
+        return QImage();
+    }
+    int width = (m_textureWidth > 0) ? m_textureWidth : m_width;
+    int height = (m_textureHeight > 0) ? m_textureHeight : m_height;
+    if (width <= 0 || height <= 0) {
+        return QImage();
+    }
+    // Kept while the item is released: no larger than needed to cover the item, in the aspect
+    // ratio of the frame so that it is shown with the same geometry
+    if (m_width > 0 && m_height > 0) {
+        float scale = std::min(1.0f, std::max(float(m_width) / width, float(m_height) / height));
+        width = std::max(1, qRound(width * scale));
+        height = std::max(1, qRound(height * scale));
+    }
+
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    GLint previousFbo = 0;
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // One-off synchronous copy through a temporary framebuffer
+    GLuint textureId = 0;
+    GLuint fboId = 0;
+    gl->glGenTextures(1, &textureId);
+    gl->glBindTexture(GL_TEXTURE_2D, textureId);
+    gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+    gl->glGenFramebuffers(1, &fboId);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureId, 0);
+    gl->glViewport(0, 0, width, height);
+    gl->glDisable(GL_SCISSOR_TEST);
+    gl->glDisable(GL_STENCIL_TEST);
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisable(GL_BLEND);
+
+    EglTextureRenderer::Quad quad;
+    quad.vertices = OffscreenVertices;
+    quad.texcoords = FullTexcoords;
+    m_core.draw(m_textureId, m_textureTarget, quad);
+
+    // Rows are read bottom-up, which matches the bottom-up offscreen vertices: row 0 of the image
+    // is row 0 of the texture.
+    QImage image(width, height, QImage::Format_RGBA8888);
+    gl->glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+
+    gl->glDeleteFramebuffers(1, &fboId);
+    gl->glDeleteTextures(1, &textureId);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    gl->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    return image;
+}
+
+void GlTextureRenderer::setImage(const QImage &image)
+{
+    if (image.isNull()) {
+        return;
+    }
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    QImage pixels = image.convertToFormat(QImage::Format_RGBA8888);
+    if (m_imageTextureId == GL_INVALID_ID) {
+        gl->glGenTextures(1, &m_imageTextureId);
+    }
+    gl->glBindTexture(GL_TEXTURE_2D, m_imageTextureId);
+    gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pixels.width(), pixels.height(), 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, pixels.constBits());
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    setTexture(m_imageTextureId, GL_TEXTURE_2D);
+}
+
+QMatrix4x4 GlTextureRenderer::getOffscreenMatrix()
+{
+    // Offscreen vertices are bottom-up
+    QMatrix4x4 flip;
+    flip.scale(1.0f, -1.0f);
+    return flip * m_transform * flip;
+}
+
+void GlTextureRenderer::setFilters(const std::vector<GlFilterChain::Filter> &filters)
+{
+    m_filterChain.setFilters(filters);
+    m_isTextureChanged = true;
 }
 
 void GlTextureRenderer::setOffscreen(bool isOffscreen)
@@ -242,6 +321,84 @@ GLuint GlTextureRenderer::getOffscreenTexture()
     return m_textureOffscreenId;
 }
 
+void GlTextureRenderer::setFrameExport(GlFrameExporter::Callback callback, int width, int height)
+{
+    if (callback) {
+        if (m_exporter == nullptr) {
+            m_exporter = new GlFrameExporter();
+        }
+        m_exporter->setCallback(std::move(callback));
+        m_isExportEnabled = true;
+    } else if (m_exporter != nullptr) {
+        // GL resources are released with the render node, only stop delivering frames
+        m_exporter->setCallback(nullptr);
+        m_isExportEnabled = false;
+    }
+    m_exportWidth = width;
+    m_exportHeight = height;
+}
+
+void GlTextureRenderer::requestFrameExport()
+{
+    m_isExportRequested = m_isExportEnabled;
+}
+
+bool GlTextureRenderer::collectFrameExports()
+{
+    if (m_exporter == nullptr) {
+        return false;
+    }
+    m_exporter->collect();
+    return m_exporter->isPending();
+}
+
+GLuint GlTextureRenderer::applyFilters()
+{
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+
+    GLint previousFbo = 0;
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // Size of the video frame, falls back to the item size until it is known
+    int width = (m_textureWidth > 0) ? m_textureWidth : m_width;
+    int height = (m_textureHeight > 0) ? m_textureHeight : m_height;
+    GLuint textureId = m_filterChain.process(m_textureId, m_textureTarget, width, height);
+
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    gl->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    return textureId;
+}
+
+void GlTextureRenderer::exportFrame(GLuint textureId, GLenum textureTarget)
+{
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+
+    // Export pass draws the whole texture into an exporter FBO, then restores the scene graph's
+    // framebuffer and viewport.
+    GLint previousFbo = 0;
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+
+    int width = (m_exportWidth > 0) ? m_exportWidth : m_width;
+    int height = (m_exportHeight > 0) ? m_exportHeight : m_height;
+    if (width > 0 && height > 0 && m_exporter->beginFrame(width, height)) {
+        gl->glDisable(GL_SCISSOR_TEST);
+        gl->glDisable(GL_STENCIL_TEST);
+        gl->glDisable(GL_DEPTH_TEST);
+        gl->glDisable(GL_BLEND);
+        m_core.draw(textureId, textureTarget,
+                    getQuad(OffscreenVertices, getOffscreenMatrix(), 1.0f));
+
+        m_exporter->endFrame();
+    }
+
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    gl->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
 void GlTextureRenderer::enableFramebuffer()
 {
     QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
@@ -7,28 +7,13 @@
 
 #pragma once
 
-#include <QSGRenderNode>
-#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QImage>
+#include <vector>
+#include "egltexturerenderer.hpp"
+#include "videorendernode.hpp"
 
-#define GL_INVALID_ID ((GLuint) - 1)
-
-class GlTextureProgram : public QOpenGLShaderProgram
-{
-public:
-    GlTextureProgram(std::string_view vertex, std::string_view fragment);
-    ~GlTextureProgram();
-
-    void setTextureUnit(GLuint textureUnit);
-    void setMatrix(const QMatrix4x4 &matrix);
-    void setOpacity(GLfloat opacity);
-
-protected:
-    int m_textureUniform;
-    int m_matrixUniform;
-    int m_opacityUniform;
-};
-
-class GlTextureRenderer : public QSGRenderNode
+class GlTextureRenderer : public VideoRenderNode
 {
 public:
     ~GlTextureRenderer();
@@ -38,29 +23,52 @@ public:
     void releaseResources() override;
     StateFlags changedStates() const override;
     RenderingFlags flags() const override;
-    QRectF rect() const override;
 
-    void setSize(int width, int height);
+    // Inherited from VideoRenderNode
+    guint64 updateFrame(GstPlayer *player) override;
+    void holdFrame() override;
+    void setTextureSize(int width, int height) override;
+    void setOffscreen(bool isOffscreen) override;
+    void setFilters(const std::vector<GlFilterChain::Filter> &filters) override;
+    void setFrameExport(GlFrameExporter::Callback callback, int width = 0,
+                        int height = 0) override;
+    void requestFrameExport() override;
+    bool collectFrameExports() override;
+    QImage grabImage() override;
+    // Shows an image grabbed earlier until the next setTexture()
+    void setImage(const QImage &image) override;
+    // Releases the textures and framebuffers tied to the current frame, keeps the programs
+    void releaseFrameResources() override;
+
     void init();
     void setTexture(GLuint textureId, GLenum textureTarget = GL_TEXTURE_2D);
-    void setOffscreen(bool isOffscreen);
     GLuint getOffscreenTexture();
-    bool isFirstRenderDone() { return m_isFirstRenderDone; }
+    // Overlays are uploaded again only when the sequence number changes, 0 for none
+    void setOverlays(quint64 sequence, const std::vector<GstPlayer::Texture::Overlay> &overlays);
 
 protected:
     void enableFramebuffer();
+    QMatrix4x4 getOffscreenMatrix();
+    GLuint applyFilters();
+    EglTextureRenderer::Quad getQuad(const std::array<GLfloat, 4 * 2> &vertices,
+                                     const QMatrix4x4 &matrix, float opacity);
+    void exportFrame(GLuint textureId, GLenum textureTarget);
 
 private:
-    int m_width = 0;
-    int m_height = 0;
-    GlTextureProgram *m_program2D = nullptr;
-    GlTextureProgram *m_programExtOES = nullptr;
+    EglTextureRenderer m_core;
     GLuint m_textureId = GL_INVALID_ID;
     GLenum m_textureTarget = GL_TEXTURE_2D;
-    std::array<GLfloat, 4 * 2> m_vertices = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
-    std::array<GLfloat, 4 * 2> m_texcoords = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+    std::shared_ptr<GstBuffer> m_textureHold;
     GLuint m_isOffscreen = false;
     GLuint m_fboId = GL_INVALID_ID;
     GLuint m_textureOffscreenId = GL_INVALID_ID;
-    bool m_isFirstRenderDone = false;
+    GlFrameExporter *m_exporter = nullptr;
+    int m_exportWidth = 0;
+    int m_exportHeight = 0;
+    bool m_isExportEnabled = false;
+    bool m_isExportRequested = false;
+    GlFilterChain m_filterChain;
+    GLuint m_filteredTextureId = GL_INVALID_ID;
+    GLuint m_imageTextureId = GL_INVALID_ID;
+    bool m_isTextureChanged = true;
 };
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "gluploadcontext.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+struct EglSyncFunctions
+{
+    PFNEGLCREATESYNCKHRPROC createSync;
+    PFNEGLDESTROYSYNCKHRPROC destroySync;
+    PFNEGLCLIENTWAITSYNCKHRPROC clientWaitSync;
+    PFNEGLWAITSYNCKHRPROC waitSync;
+};
+
+const EglSyncFunctions &getSyncFunctions()
+{
+    static const EglSyncFunctions functions = {
+        reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(eglGetProcAddress("eglCreateSyncKHR")),
+        reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(eglGetProcAddress("eglDestroySyncKHR")),
+        reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(eglGetProcAddress("eglClientWaitSyncKHR")),
+        reinterpret_cast<PFNEGLWAITSYNCKHRPROC>(eglGetProcAddress("eglWaitSyncKHR")),
+    };
+    return functions;
+}
+} // namespace
+
+std::mutex GlUploadContext::m_poolLock;
+std::vector<GlUploadContext::Slot> GlUploadContext::m_pool;
+
+/**************************************************************************************************************
+ *
+ * @brief  			GlUploadContext Class
+ *
+ * @remarks 		GL context shared with the scene graph context and running on its own GStreamer
+ *                  GL thread. glupload and the color converters of the players using it import and
+ *                  convert frames there, in parallel with rendering; frames are handed over to the
+ *                  render thread with EGL fences.
+ *
+ **************************************************************************************************************/
+
+std::shared_ptr<GlUploadContext> GlUploadContext::acquire(GstGLDisplay *display,
+                                                          GstGLContext *appContext)
+{
+    unsigned poolSize = getPoolSize();
+    if (poolSize == 0) {
+        return std::make_shared<GlUploadContext>(display, appContext);
+    }
+
+    guintptr appHandle = gst_gl_context_get_gl_context(appContext);
+    std::lock_guard<std::mutex> lock(m_poolLock);
+    m_pool.erase(std::remove_if(m_pool.begin(), m_pool.end(),
+                                [](const Slot &slot) { return slot.context.expired(); }),
+                 m_pool.end());
+
+    // Least used context of this application context, or a new one while the pool is not full
+    std::shared_ptr<GlUploadContext> chosen;
+    unsigned count = 0;
+    for (const Slot &slot : m_pool) {
+        if (slot.appContext != appHandle) {
+            continue;
+        }
+        count++;
+        std::shared_ptr<GlUploadContext> context = slot.context.lock();
+        if (context != nullptr && (chosen == nullptr || context.use_count() < chosen.use_count())) {
+            chosen = context;
+        }
+    }
+    if (chosen == nullptr || count < poolSize) {
+        chosen = std::make_shared<GlUploadContext>(display, appContext);
+        if (chosen->isValid()) {
+            m_pool.push_back({ appHandle, chosen });
+        }
+    }
+    return chosen;
+}
+
+unsigned GlUploadContext::getPoolSize()
+{
+    const char *value = std::getenv("IMX_V2T_UPLOAD_CONTEXTS");
+    return (value != nullptr) ? static_cast<unsigned>(std::strtoul(value, nullptr, 10)) : 0;
+}
+
+GlUploadContext::GlUploadContext(GstGLDisplay *display, GstGLContext *appContext)
+    : m_context(nullptr)
+{
+    GError *error = nullptr;
+    GstGLContext *context = gst_gl_context_new(display);
+    if (gst_gl_context_create(context, appContext, &error) == FALSE) {
+        g_print("Cannot create GL upload context: %s\n",
+                (error != nullptr) ? error->message : "unknown error");
+        g_clear_error(&error);
+        gst_object_unref(GST_OBJECT(context));
+        return;
+    }
+    m_context = context;
+}
+
+GlUploadContext::~GlUploadContext()
+{
+    if (m_context != nullptr) {
+        gst_object_unref(GST_OBJECT(m_context));
+    }
+}
+
+EGLSyncKHR GlUploadContext::insertFence(GstGLContext *context)
+{
+    if (getSyncFunctions().createSync == nullptr) {
+        return EGL_NO_SYNC_KHR;
+    }
+    EGLSyncKHR fence = EGL_NO_SYNC_KHR;
+    gst_gl_context_thread_add(context, GlUploadContext::onInsertFence, &fence);
+    return fence;
+}
+
+void GlUploadContext::onInsertFence(GstGLContext *context, gpointer data)
+{
+    auto *fence = static_cast<EGLSyncKHR *>(data);
+    *fence = getSyncFunctions().createSync(eglGetCurrentDisplay(), EGL_SYNC_FENCE_KHR, nullptr);
+    // Other contexts can only wait for fences that have been submitted
+    context->gl_vtable->Flush();
+}
+
+void GlUploadContext::waitFence(EGLDisplay display, EGLSyncKHR fence)
+{
+    if (fence == EGL_NO_SYNC_KHR) {
+        return;
+    }
+    const EglSyncFunctions &functions = getSyncFunctions();
+    if (functions.waitSync != nullptr) {
+        // GPU side wait, the render thread does not block
+        functions.waitSync(display, fence, 0);
+    } else if (functions.clientWaitSync != nullptr) {
+        functions.clientWaitSync(display, fence, 0, ClientWaitTimeoutNs);
+    }
+}
+
+void GlUploadContext::destroyFence(EGLDisplay display, EGLSyncKHR fence)
+{
+    if (fence != EGL_NO_SYNC_KHR && getSyncFunctions().destroySync != nullptr) {
+        getSyncFunctions().destroySync(display, fence);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <gst/gl/gl.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class GlUploadContext
+{
+public:
+    // Upload context sharing objects with appContext. With a pool size of 0 each call creates a
+    // context, otherwise players share up to that many contexts per application context. Players
+    // wrap the application context each in their own GstGLContext: the native context is the key.
+    static std::shared_ptr<GlUploadContext> acquire(GstGLDisplay *display,
+                                                    GstGLContext *appContext);
+    // From $IMX_V2T_UPLOAD_CONTEXTS, 0 when unset
+    static unsigned getPoolSize();
+
+    GlUploadContext(GstGLDisplay *display, GstGLContext *appContext);
+    ~GlUploadContext();
+    GlUploadContext(const GlUploadContext &) = delete;
+    GlUploadContext &operator=(const GlUploadContext &) = delete;
+
+    bool isValid() { return m_context != nullptr; };
+    // The context runs its own GL thread, created and owned by GStreamer
+    GstGLContext *getContext() { return m_context; };
+    // Display the context was created on, glupload only uses contexts of its own display
+    GstGLDisplay *getDisplay() { return m_context->display; };
+
+    // Fence following the commands issued so far in context, inserted from its GL thread.
+    // EGL_NO_SYNC_KHR when EGL_KHR_fence_sync is not supported.
+    static EGLSyncKHR insertFence(GstGLContext *context);
+    // Makes the context current in the calling thread wait for the fence. Contexts of several
+    // windows may wait for the same fence, its owner deletes it with destroyFence().
+    static void waitFence(EGLDisplay display, EGLSyncKHR fence);
+    static void destroyFence(EGLDisplay display, EGLSyncKHR fence);
+
+    // Client side wait used when EGL_KHR_wait_sync is not supported
+    static constexpr EGLTimeKHR ClientWaitTimeoutNs = 100000000;
+
+protected:
+    static void onInsertFence(GstGLContext *context, gpointer data);
+
+private:
+    GstGLContext *m_context;
+
+    struct Slot
+    {
+        guintptr appContext;
+        std::weak_ptr<GlUploadContext> context;
+    };
+    static std::mutex m_poolLock;
+    static std::vector<Slot> m_pool;
+};
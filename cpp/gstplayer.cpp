@@ -5,17 +5,46 @@
  */
 
 #include "gstplayer.hpp"
-#include <gstimxcommon.h>
+#include "videoconverter.hpp"
+#include <gst/video/video.h>
+#include <algorithm>
 #include <stdexcept>
 
 namespace {
 constexpr std::string_view DefaultPipeline =
         "playbin uri=testbin://video,pattern=videotestsrc,caps=[video/x-raw,format=BGRA]";
+
+// Playbin flags for live sources: text overlay, deinterlacing, colour balance and network
+// buffering (queue2) are left out as they only add latency to a camera feed.
+constexpr std::string_view LivePlaybinFlags = "video+audio+soft-volume";
+
+// Offset between the NTP epoch (1900) and the Unix epoch (1970).
+constexpr gint64 NtpUnixEpochOffset = G_GINT64_CONSTANT(2208988800) * GST_SECOND;
+
+// Weight of the newest measurement in the latency moving average (1 / LatencySmoothing).
+constexpr gint64 LatencySmoothing = 8;
+
+GstStaticCaps NtpTimestampCaps = GST_STATIC_CAPS("timestamp/x-ntp");
+
+// Frames handed over without GL context: dma-bufs first, so that hardware decoders keep their
+// buffers, then system memory in a format that can be sampled without conversion.
+constexpr std::string_view FrameCaps =
+        "video/x-raw(memory:DMABuf), format=DMA_DRM, drm-format={ NV12, AR24, XR24, AB24, XB24 }; "
+        "video/x-raw(memory:DMABuf), format={ NV12, BGRA, BGRx, RGBA, RGBx }; "
+        "video/x-raw, format={ BGRA, BGRx, RGBA, RGBx, NV12 }";
+
+void setPropertyIfExists(GObject *object, const gchar *name, const std::string &value)
+{
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(object), name) != nullptr) {
+        gst_util_set_object_arg(object, name, value.data());
+    }
+}
 } // namespace
 
 GstLib::GstLib()
 {
     gst_init(nullptr, nullptr);
+    ReadAheadSource::registerElement();
 }
 
 GstLib::~GstLib()
@@ -36,45 +65,102 @@ GstLib GstPlayer::m_gst;
 GstPlayer::GstPlayer(EGLDisplay eglDisplay, EGLContext eglContext)
     : m_pipeline(nullptr),
       m_bus(nullptr),
+      m_eglDisplay(eglDisplay),
+      m_isGlOutput(eglContext != EGL_NO_CONTEXT),
       m_gstDisplay(nullptr),
       m_glContext(nullptr),
+      m_isDedicatedUpload(false),
       m_isPrerollDone(false),
       m_initialized(false),
       m_bufferLast(nullptr),
       m_bufferRender(nullptr),
+      m_fenceLast(EGL_NO_SYNC_KHR),
+      m_modifierLast(0),
+      m_frameGeneration(0),
       m_looping(false),
+      m_maxFrameRate(0),
+      m_isCustomPipeline(false),
+      m_isLive(false),
+      m_liveLatencyMs(DefaultLiveLatencyMs),
+      m_readAheadMode(ReadAheadMode::Off),
+      m_sourceReadAhead(ReadAheadMode::Off),
+      m_latency(-1),
       m_width(-1),
       m_height(-1),
-      m_listener(nullptr)
+      m_rotation(0),
+      m_isFlipped(false),
+      m_isAdaptiveBitrate(true),
+      m_isAdaptiveAllowed(false),
+      m_adaptiveDemux(nullptr),
+      m_adaptiveSource(nullptr),
+      m_commandsScheduled(false),
+      m_workerRunning(true),
+      m_mainContext(nullptr),
+      m_mainLoop(nullptr)
 {
     m_pipelineCommand = std::string(DefaultPipeline);
     m_texture.id = (guint)-1;
     m_texture.target = (guint)-1;
+    gst_video_info_init(&m_infoLast);
+    gst_video_info_init(&m_frame.info);
+
+    // Probe the registry for color converters
+    VideoConverterSelector::instance();
+
+    if (m_isGlOutput) {
+        // Get EGL display and context
+        m_gstDisplay = gst_gl_display_egl_new_with_egl_display(eglDisplay);
+        m_glContext = gst_gl_context_new_wrapped(GST_GL_DISPLAY(m_gstDisplay),
+                                                 reinterpret_cast<guintptr>(eglContext),
+                                                 GST_GL_PLATFORM_EGL, GST_GL_API_GLES2);
+    }
 
-    // Get EGL display and context
-    m_gstDisplay = gst_gl_display_egl_new_with_egl_display(eglDisplay);
-    m_glContext = gst_gl_context_new_wrapped(GST_GL_DISPLAY(m_gstDisplay),
-                                             reinterpret_cast<guintptr>(eglContext),
-                                             GST_GL_PLATFORM_EGL, GST_GL_API_GLES2);
+    // Pipeline construction, state changes, teardown and bus messages are handled by the worker
+    // thread running its own main context, so that the GUI thread never blocks on GStreamer nor
+    // dispatches the bus messages of every player.
+    m_mainContext = g_main_context_new();
+    m_mainLoop = g_main_loop_new(m_mainContext, FALSE);
+    m_worker = std::thread(&GstPlayer::runWorker, this);
 }
 
 GstPlayer::~GstPlayer()
 {
-    deinit();
+    // Stop the worker once the command in progress, if any, is done. Pending commands are
+    // dropped and the listeners are not notified anymore. The pipeline is released by the worker
+    // like in every other teardown, the caller only waits for it to finish.
+    setListener(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(m_commandLock);
+        m_commands.clear();
+        m_workerRunning = false;
+    }
+    // Quit from within the loop, so that it cannot be missed if the loop is not running yet
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, GstPlayer::onQuitWorker, static_cast<gpointer>(this), nullptr);
+    g_source_attach(source, m_mainContext);
+    g_source_unref(source);
+    m_worker.join();
+
+    g_main_loop_unref(m_mainLoop);
+    g_main_context_unref(m_mainContext);
 }
 
 void GstPlayer::play()
 {
-    if (m_initialized) {
-        gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
-    }
+    enqueue(GstPlayerCommand::Play, [this]() {
+        return m_initialized
+                && gst_element_set_state(m_pipeline, GST_STATE_PLAYING)
+                != GST_STATE_CHANGE_FAILURE;
+    });
 }
 
 void GstPlayer::pause()
 {
-    if (m_initialized) {
-        gst_element_set_state(m_pipeline, GST_STATE_PAUSED);
-    }
+    enqueue(GstPlayerCommand::Pause, [this]() {
+        return m_initialized
+                && gst_element_set_state(m_pipeline, GST_STATE_PAUSED)
+                != GST_STATE_CHANGE_FAILURE;
+    });
 }
 
 void GstPlayer::toggleLooping()
@@ -94,7 +180,10 @@ bool GstPlayer::getLooping()
 
 void GstPlayer::skip(int n_sec)
 {
-    if (m_initialized) {
+    auto action = [this, n_sec]() {
+        if (m_initialized == false) {
+            return false;
+        }
         // get current pipeline position
         gint64 current_position = -1;
         gst_element_query_position(m_pipeline, GST_FORMAT_TIME, &current_position);
@@ -112,70 +201,230 @@ void GstPlayer::skip(int n_sec)
             position = video_duration - (300 * GST_MSECOND);
         }
 
-        gst_element_seek_simple(m_pipeline, GST_FORMAT_TIME, flags, position);
-    }
+        return gst_element_seek_simple(m_pipeline, GST_FORMAT_TIME, flags, position) != FALSE;
+    };
+    // From wherever the previous skips have left the position
+    enqueue(GstPlayerCommand::Seek, std::move(action), true);
 }
 
-void GstPlayer::seekToPercent(float percent)
+void GstPlayer::seekToPercent(float percent, bool keyFramesOnly)
 {
-    if (m_initialized) {
+    enqueue(GstPlayerCommand::Seek, [this, percent, keyFramesOnly]() {
+        if (m_initialized == false) {
+            return false;
+        }
         gint64 duration, position;
         if (gst_element_query_duration(m_pipeline, GST_FORMAT_TIME, &duration) && duration > 0) {
             position = (gint64)(duration * percent);
-            gst_element_seek_simple(m_pipeline, GST_FORMAT_TIME,
-                                    (GstSeekFlags)(GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_FLUSH),
-                                    position);
+            int flags = GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_FLUSH;
+            if (keyFramesOnly) {
+                flags |= GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS
+                        | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO;
+            }
+            return gst_element_seek_simple(m_pipeline, GST_FORMAT_TIME, (GstSeekFlags)flags,
+                                           position)
+                    != FALSE;
         }
+        return false;
+    });
+}
+
+void GstPlayer::setMaxFrameRate(guint framesPerSecond)
+{
+    m_maxFrameRate = framesPerSecond;
+
+    // Applied right away to the current pipeline, if any
+    GstElement *pipeline = acquirePipeline();
+    if (pipeline != nullptr) {
+        GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "GstPlayerSink");
+        if (sink != nullptr) {
+            applyMaxFrameRate(sink);
+            gst_object_unref(GST_OBJECT(sink));
+        }
+        gst_object_unref(GST_OBJECT(pipeline));
     }
 }
 
+void GstPlayer::applyMaxFrameRate(GstElement *sink)
+{
+    // The sink drops the frames rendered less than throttle-time after the previous one
+    guint rate = m_maxFrameRate;
+    guint64 throttle = (rate > 0) ? GST_SECOND / rate : 0;
+    g_object_set(sink, "throttle-time", throttle, nullptr);
+}
+
+void GstPlayer::deinit()
+{
+    enqueue(GstPlayerCommand::Stop, [this]() {
+        release();
+        return true;
+    });
+}
+
 void GstPlayer::setListener(GstPlayerListener *listener)
 {
-    m_listener = listener;
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    m_listeners.clear();
+    if (listener != nullptr) {
+        m_listeners.push_back(listener);
+    }
+}
+
+void GstPlayer::addListener(GstPlayerListener *listener)
+{
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    if (std::find(m_listeners.begin(), m_listeners.end(), listener) == m_listeners.end()) {
+        m_listeners.push_back(listener);
+    }
+}
+
+void GstPlayer::removeListener(GstPlayerListener *listener)
+{
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), listener),
+                      m_listeners.end());
 }
 
 void GstPlayer::setVideoTestPattern()
 {
-    m_pipelineCommand = std::string(DefaultPipeline);
-    reset();
+    enqueue(GstPlayerCommand::Load, [this]() {
+        m_isLive = false;
+        m_isCustomPipeline = false;
+        m_sourceReadAhead = ReadAheadMode::Off;
+        m_pipelineCommand = std::string(DefaultPipeline);
+        reset();
+        return true;
+    });
 }
 
 void GstPlayer::setVideo(std::string pathToFile)
 {
-    pathToFile = "\"" + pathToFile + "\"";
-    m_pipelineCommand = "playbin uri=" + pathToFile;
-    reset();
+    enqueue(GstPlayerCommand::Load, [this, pathToFile]() {
+        m_isLive = false;
+        m_isCustomPipeline = false;
+        {
+            std::lock_guard<std::mutex> lock(m_pipelineLock);
+            m_sourceReadAhead = m_readAheadMode;
+        }
+        // playbin picks the source by URI scheme: readahead:// selects readaheadsrc, which is
+        // configured in onSourceSetup()
+        std::string uri = pathToFile;
+        if (m_sourceReadAhead != ReadAheadMode::Off && uri.compare(0, 5, "file:") == 0) {
+            uri = ReadAheadSource::getUri(uri);
+        } else {
+            m_sourceReadAhead = ReadAheadMode::Off;
+        }
+        m_pipelineCommand = "playbin uri=\"" + uri + "\"";
+        reset();
+        return true;
+    });
+}
+
+void GstPlayer::setPipeline(std::string description)
+{
+    enqueue(GstPlayerCommand::Load, [this, description]() {
+        m_isLive = false;
+        m_isCustomPipeline = true;
+        m_sourceReadAhead = ReadAheadMode::Off;
+        m_pipelineCommand = description;
+        reset();
+        return true;
+    });
+}
+
+void GstPlayer::setLiveSource(std::string uri, guint latencyMs)
+{
+    enqueue(GstPlayerCommand::Load, [this, uri, latencyMs]() {
+        // Live sources (rtsp://, udp://, v4l2://) are configured in onSourceSetup() and
+        // onDeepElementAdded() once playbin has created them.
+        m_isLive = true;
+        m_isCustomPipeline = false;
+        m_sourceReadAhead = ReadAheadMode::Off;
+        m_liveLatencyMs = latencyMs;
+        m_pipelineCommand =
+                "playbin uri=\"" + uri + "\" flags=" + std::string(LivePlaybinFlags);
+        reset();
+        return true;
+    });
+}
+
+void GstPlayer::setFrameTap(std::string name)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineLock);
+    m_frameTapName = name;
+}
+
+void GstPlayer::setDedicatedUpload(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineLock);
+    m_isDedicatedUpload = enabled;
+}
+
+void GstPlayer::setAdaptiveBitrate(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineLock);
+    m_isAdaptiveBitrate = enabled;
+}
+
+void GstPlayer::setReadAhead(ReadAheadMode mode)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineLock);
+    m_readAheadMode = mode;
 }
 
 float GstPlayer::getPercentage()
 {
     float percentage = 0.0f;
-    if (m_initialized) {
+    GstElement *pipeline = acquirePipeline();
+    if (pipeline != nullptr) {
         gint64 current_position = -1;
-        gst_element_query_position(m_pipeline, GST_FORMAT_TIME, &current_position);
+        gst_element_query_position(pipeline, GST_FORMAT_TIME, &current_position);
         // get pipeline duration
         gint64 video_duration = -1;
-        gst_element_query_duration(m_pipeline, GST_FORMAT_TIME, &video_duration);
+        gst_element_query_duration(pipeline, GST_FORMAT_TIME, &video_duration);
+        gst_object_unref(GST_OBJECT(pipeline));
 
-        percentage = ((float)(GST_TIME_AS_MSECONDS(current_position)))
-                / ((float)(GST_TIME_AS_MSECONDS(video_duration)));
+        // Live sources have no duration
+        if (video_duration > 0) {
+            percentage = ((float)(GST_TIME_AS_MSECONDS(current_position)))
+                    / ((float)(GST_TIME_AS_MSECONDS(video_duration)));
+        }
     }
     return percentage;
 }
 
+GstElement *GstPlayer::acquirePipeline()
+{
+    // Pipeline reference for threads other than the worker, which may release it at any time
+    std::lock_guard<std::mutex> lock(m_pipelineLock);
+    if (m_initialized == false) {
+        return nullptr;
+    }
+    return GST_ELEMENT(gst_object_ref(m_pipeline));
+}
+
 GstPlayer::Texture GstPlayer::getTexture()
 {
+    // Several renderers may ask, for the same frame or a newer one, from several windows
+    std::lock_guard<std::mutex> lock(m_bufferLock);
+    if (m_initialized == true) {
+        waitUpload();
+    }
+
+    // Same frame as the previous call: nothing to do
+    if (m_initialized == true && m_texture.generation == m_frameGeneration) {
+        return m_texture;
+    }
+
     m_texture.id = (guint)-1;
     m_texture.target = (guint)-1;
+    m_texture.hold.reset();
 
     if (m_initialized == true) {
-        m_bufferLock.lock();
-        if (m_bufferRender != nullptr && m_bufferLast != m_bufferRender) {
-            // New buffer available, release previously rendered buffer
-            gst_buffer_unref(m_bufferRender);
-        }
-        m_bufferRender = m_bufferLast;
-    
+        acquireRenderBuffer();
+        // Read under the lock, so that it matches m_bufferLast
+        m_texture.generation = m_frameGeneration;
+
         if (m_bufferRender != nullptr) {
             // Get OpenGL texture ID
             GstMemory *memory = gst_buffer_peek_memory(m_bufferRender, 0);
@@ -183,18 +432,157 @@ GstPlayer::Texture GstPlayer::getTexture()
                 m_texture.id = (reinterpret_cast<GstGLMemory *>(memory))->tex_id;
                 m_texture.target = gst_gl_texture_target_to_gl(
                         (reinterpret_cast<GstGLMemory *>(memory))->tex_target);
+                updateTextureMetas(reinterpret_cast<GstGLMemory *>(memory));
+                m_texture.hold = m_holdRender;
             } else {
                 throw std::runtime_error(
                         "Input from appsink is not an OpenGL texture. Consider using "
                         "glupload in the pipeline.");
             }
         }
-        m_bufferLock.unlock();
     }
 
     return m_texture;
 }
 
+GstPlayer::Frame GstPlayer::getFrame()
+{
+    std::lock_guard<std::mutex> lock(m_bufferLock);
+    if (m_initialized == true && m_frame.generation == m_frameGeneration) {
+        return m_frame;
+    }
+
+    m_frame.buffer = nullptr;
+    m_frame.hold.reset();
+    if (m_initialized == true) {
+        acquireRenderBuffer();
+        m_frame.generation = m_frameGeneration;
+        if (m_bufferRender != nullptr) {
+            m_frame.buffer = m_bufferRender;
+            m_frame.hold = m_holdRender;
+            m_frame.info = m_infoLast;
+            m_frame.modifier = m_modifierLast;
+            updateFrameMetas();
+        }
+    }
+
+    return m_frame;
+}
+
+void GstPlayer::waitUpload()
+{
+    // Rendering waits on the GPU until the upload thread is done with the frame, once per
+    // context: windows on other displays render in their own contexts of the share group
+    EGLContext context = eglGetCurrentContext();
+    guint64 generation = m_frameGeneration;
+    for (ContextWait &wait : m_contextWaits) {
+        if (wait.context == context) {
+            if (wait.generation != generation) {
+                GlUploadContext::waitFence(m_eglDisplay, m_fenceLast);
+                wait.generation = generation;
+            }
+            return;
+        }
+    }
+    GlUploadContext::waitFence(m_eglDisplay, m_fenceLast);
+    // Contexts that stopped rendering (closed windows) are forgotten, they wait again if they
+    // come back
+    m_contextWaits.erase(std::remove_if(m_contextWaits.begin(), m_contextWaits.end(),
+                                        [generation](const ContextWait &wait) {
+                                            return wait.generation + StaleContextFrames
+                                                    < generation;
+                                        }),
+                         m_contextWaits.end());
+    m_contextWaits.push_back({ context, generation });
+}
+
+void GstPlayer::acquireRenderBuffer()
+{
+    if (m_bufferLast == m_bufferRender) {
+        return;
+    }
+    if (m_bufferRender != nullptr) {
+        // New buffer available, release previously rendered buffer. Renderers still drawing it
+        // keep their own hold.
+        gst_buffer_unref(m_bufferRender);
+    }
+    m_bufferRender = m_bufferLast;
+    m_holdRender.reset();
+    if (m_bufferRender != nullptr) {
+        m_adaptiveBitrate.onFramePresented();
+        m_holdRender = std::shared_ptr<GstBuffer>(gst_buffer_ref(m_bufferRender),
+                                                  [](GstBuffer *buffer) {
+                                                      gst_buffer_unref(buffer);
+                                                  });
+    }
+}
+
+bool GstPlayer::getFrameLayout(GstSample *sample, GstVideoInfo &info, guint64 &modifier)
+{
+    GstCaps *caps = gst_sample_get_caps(sample);
+    if (caps == nullptr) {
+        return false;
+    }
+    bool isValid = false;
+    modifier = 0;
+#if GST_CHECK_VERSION(1, 24, 0)
+    if (gst_video_is_dma_drm_caps(caps)) {
+        // Tiled or compressed layouts have no GstVideoFormat: the format of the DRM fourcc is
+        // used for the plane count, the layout comes from the video meta.
+        GstVideoInfoDmaDrm drmInfo;
+        if (gst_video_info_dma_drm_from_caps(&drmInfo, caps)) {
+            GstVideoFormat format = gst_video_dma_drm_fourcc_to_format(drmInfo.drm_fourcc);
+            isValid = format != GST_VIDEO_FORMAT_UNKNOWN
+                    && gst_video_info_set_format(&info, format,
+                                                 GST_VIDEO_INFO_WIDTH(&drmInfo.vinfo),
+                                                 GST_VIDEO_INFO_HEIGHT(&drmInfo.vinfo));
+            info.colorimetry = drmInfo.vinfo.colorimetry;
+            modifier = drmInfo.drm_modifier;
+        }
+    } else
+#endif
+    {
+        isValid = gst_video_info_from_caps(&info, caps);
+    }
+    if (isValid == false) {
+        return false;
+    }
+
+    GstVideoMeta *meta = gst_buffer_get_video_meta(gst_sample_get_buffer(sample));
+    if (meta != nullptr) {
+        for (guint i = 0; i < meta->n_planes; i++) {
+            GST_VIDEO_INFO_PLANE_OFFSET(&info, i) = meta->offset[i];
+            GST_VIDEO_INFO_PLANE_STRIDE(&info, i) = meta->stride[i];
+        }
+    }
+    return true;
+}
+
+void GstPlayer::updateFrameMetas()
+{
+    const Frame defaults {};
+    gint width = GST_VIDEO_INFO_WIDTH(&m_frame.info);
+    gint height = GST_VIDEO_INFO_HEIGHT(&m_frame.info);
+    GstVideoCropMeta *crop = gst_buffer_get_video_crop_meta(m_bufferRender);
+    if (crop != nullptr && width > 0 && height > 0) {
+        m_frame.crop[0] = static_cast<float>(crop->x) / width;
+        m_frame.crop[1] = static_cast<float>(crop->y) / height;
+        m_frame.crop[2] = static_cast<float>(crop->width) / width;
+        m_frame.crop[3] = static_cast<float>(crop->height) / height;
+    } else {
+        std::copy(std::begin(defaults.crop), std::end(defaults.crop), std::begin(m_frame.crop));
+    }
+
+    GstVideoAffineTransformationMeta *affine =
+            gst_buffer_get_video_affine_transformation_meta(m_bufferRender);
+    if (affine != nullptr) {
+        gst_gl_get_affine_transformation_meta_as_ndc(affine, m_frame.transform);
+    } else {
+        std::copy(std::begin(defaults.transform), std::end(defaults.transform),
+                  std::begin(m_frame.transform));
+    }
+}
+
 GstFlowReturn GstPlayer::onNewSample(GstElement *appsink, gpointer data)
 {
     auto *ctx = static_cast<GstPlayer *>(data);
@@ -204,16 +592,46 @@ GstFlowReturn GstPlayer::onNewSample(GstElement *appsink, gpointer data)
     g_signal_emit_by_name(appsink, "pull-sample", &sample);
 
     if (sample != nullptr) {
-        ctx->m_bufferLock.lock();
-
         GstBuffer *buffer = gst_sample_get_buffer(sample);
 
+        // Fence in the context the frame was uploaded with, before it is handed to rendering
+        EGLSyncKHR fence = EGL_NO_SYNC_KHR;
+        GstMemory *memory = gst_buffer_peek_memory(buffer, 0);
+        if (gst_is_gl_memory(memory) != 0) {
+            fence = GlUploadContext::insertFence(
+                    reinterpret_cast<GstGLBaseMemory *>(memory)->context);
+        }
+        GstVideoInfo info;
+        guint64 modifier = 0;
+        if (ctx->m_isGlOutput == false && getFrameLayout(sample, info, modifier) == false) {
+            g_print("GStreamer Error: Cannot read the layout of the frame\n");
+            gst_sample_unref(sample);
+            return GST_FLOW_OK;
+        }
+
+        ctx->m_bufferLock.lock();
+
         if (ctx->m_bufferLast != nullptr && ctx->m_bufferLast != ctx->m_bufferRender) {
             // Previous stored buffer has not been rendered, release it.
             gst_buffer_unref(ctx->m_bufferLast);
+            ctx->m_adaptiveBitrate.onFrameOverwritten();
+        }
+        if (GST_BUFFER_DURATION_IS_VALID(buffer)) {
+            ctx->m_adaptiveBitrate.onFrameDuration(GST_BUFFER_DURATION(buffer));
         }
+        GlUploadContext::destroyFence(ctx->m_eglDisplay, ctx->m_fenceLast);
+        ctx->m_fenceLast = fence;
         // Lock new buffer
         ctx->m_bufferLast = gst_buffer_ref(buffer);
+        if (ctx->m_isGlOutput == false) {
+            ctx->m_infoLast = info;
+            ctx->m_modifierLast = modifier;
+        }
+        ctx->m_frameGeneration++;
+
+        if (ctx->m_isLive) {
+            ctx->updateLatency(sample);
+        }
 
         gst_sample_unref(sample);
 
@@ -225,6 +643,188 @@ GstFlowReturn GstPlayer::onNewSample(GstElement *appsink, gpointer data)
     return GST_FLOW_OK;
 }
 
+void GstPlayer::updateLatency(GstSample *sample)
+{
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    gint64 latency = -1;
+
+    // Prefer the capture time embedded by the sender (NTP reference timestamp added by rtspsrc
+    // from RTCP sender reports), which gives the glass-to-glass latency.
+    GstCaps *ntpCaps = gst_static_caps_get(&NtpTimestampCaps);
+    GstReferenceTimestampMeta *meta = gst_buffer_get_reference_timestamp_meta(buffer, ntpCaps);
+    gst_caps_unref(ntpCaps);
+
+    if (meta != nullptr) {
+        gint64 now = g_get_real_time() * GST_USECOND + NtpUnixEpochOffset;
+        latency = now - static_cast<gint64>(meta->timestamp);
+    } else {
+        // Otherwise measure the age of the buffer against the pipeline clock, which covers
+        // everything from the source capture timestamp to the sink.
+        GstClock *clock = gst_element_get_clock(m_pipeline);
+        const GstSegment *segment = gst_sample_get_segment(sample);
+        if (clock != nullptr && segment != nullptr && GST_BUFFER_PTS_IS_VALID(buffer)) {
+            GstClockTime runningTime = gst_segment_to_running_time(segment, GST_FORMAT_TIME,
+                                                                   GST_BUFFER_PTS(buffer));
+            GstClockTime now = gst_clock_get_time(clock) - gst_element_get_base_time(m_pipeline);
+            if (GST_CLOCK_TIME_IS_VALID(runningTime)) {
+                latency = GST_CLOCK_DIFF(runningTime, now);
+            }
+        }
+        if (clock != nullptr) {
+            gst_object_unref(clock);
+        }
+    }
+
+    if (latency >= 0) {
+        gint64 previous = m_latency;
+        m_latency = (previous < 0) ? latency : previous + (latency - previous) / LatencySmoothing;
+    }
+}
+
+void GstPlayer::onSourceSetup(GstElement *pipeline, GstElement *source, gpointer data)
+{
+    auto *ctx = static_cast<GstPlayer *>(data);
+    if (ctx->m_sourceReadAhead != ReadAheadMode::Off) {
+        // readaheadsrc: reads into aligned blocks, or maps the file
+        setPropertyIfExists(G_OBJECT(source), "mmap",
+                            ctx->m_sourceReadAhead == ReadAheadMode::Mmap ? "true" : "false");
+        return;
+    }
+
+    // rtspsrc: bound the jitterbuffer, drop late packets instead of accumulating delay and
+    // attach the sender's NTP capture time to each buffer for latency measurement.
+    setPropertyIfExists(G_OBJECT(source), "latency", std::to_string(ctx->m_liveLatencyMs));
+    setPropertyIfExists(G_OBJECT(source), "buffer-mode", "slave");
+    setPropertyIfExists(G_OBJECT(source), "drop-on-latency", "true");
+    setPropertyIfExists(G_OBJECT(source), "add-reference-timestamp-meta", "true");
+}
+
+void GstPlayer::onDeepElementAdded(GstBin *bin, GstBin *subBin, GstElement *element,
+                                   gpointer data)
+{
+    auto *ctx = static_cast<GstPlayer *>(data);
+    GstElementFactory *factory = gst_element_get_factory(element);
+    if (factory == nullptr) {
+        return;
+    }
+
+    std::string_view name = GST_OBJECT_NAME(factory);
+    if (ctx->m_isLive && name == "rtpjitterbuffer") {
+        // Jitterbuffers not created by rtspsrc (e.g. udp:// RTP streams)
+        setPropertyIfExists(G_OBJECT(element), "latency", std::to_string(ctx->m_liveLatencyMs));
+        setPropertyIfExists(G_OBJECT(element), "mode", "slave");
+        setPropertyIfExists(G_OBJECT(element), "drop-on-latency", "true");
+    } else if (ctx->m_isLive && name == "queue2") {
+        // Network buffering would hold frames back until its high watermark is reached
+        setPropertyIfExists(G_OBJECT(element), "use-buffering", "false");
+    } else if (ctx->m_isAdaptiveAllowed
+               && gst_element_factory_list_is_type(factory, GST_ELEMENT_FACTORY_TYPE_DEMUXER)
+               && g_object_class_find_property(G_OBJECT_GET_CLASS(element), "connection-speed")
+                       != nullptr) {
+        // hlsdemux, dashdemux and their adaptivedemux2 versions
+        ctx->activateAdaptiveBitrate(element);
+    } else if (ctx->isAdaptiveActive() && GST_IS_VIDEO_DECODER(element)) {
+        // Encoded bitrate of the variant being played. Decoders are created once the demuxer
+        // exposes its streams, after it was found.
+        GstPad *pad = gst_element_get_static_pad(element, "sink");
+        if (pad != nullptr) {
+            gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, GstPlayer::onDecoderBuffer, ctx,
+                              nullptr);
+            gst_object_unref(GST_OBJECT(pad));
+        }
+    }
+}
+
+void GstPlayer::activateAdaptiveBitrate(GstElement *demux)
+{
+    std::lock_guard<std::mutex> lock(m_adaptiveLock);
+    gst_object_replace(reinterpret_cast<GstObject **>(&m_adaptiveDemux), GST_OBJECT(demux));
+    if (m_adaptiveSource != nullptr) {
+        return;
+    }
+
+    // The sink reports late frames upstream as GstVideoSink does, so that the decoder skips them
+    // and both post the QoS messages counted by the controller
+    GstElement *sink = gst_bin_get_by_name(GST_BIN(m_pipeline), "GstPlayerSink");
+    if (sink != nullptr) {
+        g_object_set(sink, "qos", TRUE, "max-lateness", (gint64)(20 * GST_MSECOND), nullptr);
+        gst_object_unref(GST_OBJECT(sink));
+    }
+
+    // Variant limits are evaluated on the worker thread
+    m_adaptiveSource = g_timeout_source_new(AdaptiveBitrate::EvaluationIntervalMs);
+    g_source_set_callback(m_adaptiveSource, GstPlayer::onAdaptiveTick, static_cast<gpointer>(this),
+                          nullptr);
+    g_source_attach(m_adaptiveSource, m_mainContext);
+}
+
+bool GstPlayer::isAdaptiveActive()
+{
+    std::lock_guard<std::mutex> lock(m_adaptiveLock);
+    return m_adaptiveDemux != nullptr;
+}
+
+GstPadProbeReturn GstPlayer::onDecoderBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    auto *ctx = static_cast<GstPlayer *>(data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    ctx->m_adaptiveBitrate.onEncodedBuffer(gst_buffer_get_size(buffer), GST_BUFFER_PTS(buffer));
+    return GST_PAD_PROBE_OK;
+}
+
+gboolean GstPlayer::onAdaptiveTick(gpointer data)
+{
+    auto *ctx = static_cast<GstPlayer *>(data);
+    AdaptiveBitrate::Limits limits;
+    if (ctx->m_adaptiveBitrate.evaluate(ctx->m_height, limits)) {
+        ctx->applyAdaptiveLimits(limits);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void GstPlayer::applyAdaptiveLimits(const AdaptiveBitrate::Limits &limits)
+{
+    GstElement *demux = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_adaptiveLock);
+        if (m_adaptiveDemux != nullptr) {
+            demux = GST_ELEMENT(gst_object_ref(m_adaptiveDemux));
+        }
+    }
+    if (demux == nullptr) {
+        return;
+    }
+
+    // adaptivedemux2 caps the variant bitrate in bits per second. The legacy demuxers pick
+    // variants below connection-speed (kbps) scaled by bitrate-limit, 0 measures the bandwidth.
+    GObject *object = G_OBJECT(demux);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(object), "max-bitrate") != nullptr) {
+        setPropertyIfExists(object, "max-bitrate", std::to_string(limits.maxBitrate));
+    } else {
+        gfloat ratio = 1.0f;
+        if (g_object_class_find_property(G_OBJECT_GET_CLASS(object), "bitrate-limit") != nullptr) {
+            g_object_get(object, "bitrate-limit", &ratio, nullptr);
+        }
+        guint64 kbps = limits.maxBitrate / 1000;
+        if (ratio > 0.0f) {
+            kbps = static_cast<guint64>(kbps / ratio);
+        }
+        setPropertyIfExists(object, "connection-speed", std::to_string(kbps));
+    }
+    // Only the DASH demuxers filter representations by resolution
+    setPropertyIfExists(object, "max-video-height", std::to_string(limits.maxHeight));
+    gst_object_unref(GST_OBJECT(demux));
+}
+
+GstGLDisplay *GstPlayer::getGlDisplay()
+{
+    // A pooled upload context may have been created by another player, on its display
+    if (m_uploadContext != nullptr) {
+        return m_uploadContext->getDisplay();
+    }
+    return GST_GL_DISPLAY(m_gstDisplay);
+}
+
 GstPadProbeReturn GstPlayer::onQuery(GstPad *pad, GstPadProbeInfo *info, gpointer data)
 {
     auto *ctx = static_cast<GstPlayer *>(data);
@@ -232,13 +832,42 @@ GstPadProbeReturn GstPlayer::onQuery(GstPad *pad, GstPadProbeInfo *info, gpointe
 
     switch (GST_QUERY_TYPE(query)) {
     case GST_QUERY_CONTEXT:
-        if (gst_gl_handle_context_query(ctx->m_pipeline, query,
-                                        reinterpret_cast<GstGLDisplay *>(ctx->m_gstDisplay),
-                                        nullptr, ctx->m_glContext)
+        // glupload asks for a local context first: answering it with an upload context moves
+        // uploads to that context's thread.
+        if (ctx->m_isGlOutput
+            && gst_gl_handle_context_query(ctx->m_pipeline, query, ctx->getGlDisplay(),
+                                        (ctx->m_uploadContext != nullptr)
+                                                ? ctx->m_uploadContext->getContext()
+                                                : nullptr,
+                                        ctx->m_glContext)
             != 0) {
             return GST_PAD_PROBE_HANDLED;
         }
         break;
+    case GST_QUERY_ALLOCATION:
+        // Query from glupload (or the converter after it), before appsink answers it: the GL
+        // pool must cover the buffers held by the handoff, upload fences are waited on.
+        if ((GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_PUSH) != 0) {
+            GstCaps *caps = nullptr;
+            gst_query_parse_allocation(query, &caps, nullptr);
+            GstVideoInfo videoInfo;
+            if (caps != nullptr && gst_video_info_from_caps(&videoInfo, caps)
+                && gst_query_get_n_allocation_pools(query) == 0) {
+                gst_query_add_allocation_pool(query, nullptr, videoInfo.size, HandoffBuffers,
+                                              HandoffBuffers + PoolSlackBuffers);
+            }
+            addAllocationMeta(query, GST_VIDEO_META_API_TYPE);
+            if (ctx->m_isGlOutput) {
+                addAllocationMeta(query, GST_GL_SYNC_META_API_TYPE);
+                // Subtitles are composited by the renderer instead of blended by playbin
+                addAllocationMeta(query, GST_VIDEO_OVERLAY_COMPOSITION_META_API_TYPE);
+            } else {
+                // Renderers sampling frames directly apply crops themselves
+                addAllocationMeta(query, GST_VIDEO_CROP_META_API_TYPE);
+            }
+            reportAllocation("sink", query);
+        }
+        break;
     default:
         break;
     }
@@ -246,6 +875,125 @@ GstPadProbeReturn GstPlayer::onQuery(GstPad *pad, GstPadProbeInfo *info, gpointe
     return GST_PAD_PROBE_OK;
 }
 
+GstPadProbeReturn GstPlayer::onSinkBinQuery(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+    if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION
+        || (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_PULL) == 0) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    // Answered by the head of the bin. With dmabuf import, uploaded textures keep the decoded
+    // buffers alive: the decoder pool needs our handoff depth on top of the frames it asked for.
+    // An unlimited pool (max 0) stays unlimited.
+    guint count = gst_query_get_n_allocation_pools(query);
+    for (guint i = 0; i < count; i++) {
+        GstBufferPool *pool = nullptr;
+        guint size = 0;
+        guint min = 0;
+        guint max = 0;
+        gst_query_parse_nth_allocation_pool(query, i, &pool, &size, &min, &max);
+        min += HandoffBuffers;
+        max = (max == 0) ? 0 : std::max(max, min);
+        gst_query_set_nth_allocation_pool(query, i, pool, size, min, max);
+        if (pool != nullptr) {
+            gst_object_unref(GST_OBJECT(pool));
+        }
+    }
+    if (count == 0) {
+        GstCaps *caps = nullptr;
+        gst_query_parse_allocation(query, &caps, nullptr);
+        GstVideoInfo videoInfo;
+        if (caps != nullptr && gst_video_info_from_caps(&videoInfo, caps)) {
+            gst_query_add_allocation_pool(query, nullptr, videoInfo.size, HandoffBuffers,
+                                          HandoffBuffers + PoolSlackBuffers);
+        }
+    }
+
+    // glupload handles strides, crops are applied when rendering and GL producers' fences are
+    // waited on: decoders never have to copy to satisfy us. The frame tap's tee only passes on
+    // what both of its branches read (strides), converters answer for themselves. Subtitles are
+    // composited by the renderer whatever the head is (the frame tap publishes frames without
+    // them).
+    auto *ctx = static_cast<GstPlayer *>(data);
+    GstPad *target = gst_ghost_pad_get_target(GST_GHOST_PAD(pad));
+    GstElement *head = (target != nullptr) ? gst_pad_get_parent_element(target) : nullptr;
+    GstElementFactory *factory = (head != nullptr) ? gst_element_get_factory(head) : nullptr;
+    const gchar *headType =
+            (factory != nullptr) ? gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)) : "";
+    if (g_strcmp0(headType, "glupload") == 0) {
+        addAllocationMeta(query, GST_VIDEO_META_API_TYPE);
+        addAllocationMeta(query, GST_VIDEO_CROP_META_API_TYPE);
+        addAllocationMeta(query, GST_GL_SYNC_META_API_TYPE);
+    } else if (g_strcmp0(headType, "tee") == 0) {
+        addAllocationMeta(query, GST_VIDEO_META_API_TYPE);
+    }
+    if (ctx->m_isGlOutput) {
+        addAllocationMeta(query, GST_VIDEO_OVERLAY_COMPOSITION_META_API_TYPE);
+    }
+    if (head != nullptr) {
+        gst_object_unref(GST_OBJECT(head));
+    }
+    if (target != nullptr) {
+        gst_object_unref(GST_OBJECT(target));
+    }
+
+    reportAllocation("proposed", query);
+    // What upstream picked shows on its first buffer
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, GstPlayer::onSinkBinBuffer, nullptr, nullptr);
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GstPlayer::onSinkBinBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (buffer->pool == nullptr) {
+        g_print("Allocation (negotiated): buffers not from a pool\n");
+        return GST_PAD_PROBE_REMOVE;
+    }
+
+    GstStructure *config = gst_buffer_pool_get_config(buffer->pool);
+    GstCaps *caps = nullptr;
+    guint size = 0;
+    guint min = 0;
+    guint max = 0;
+    gst_buffer_pool_config_get_params(config, &caps, &size, &min, &max);
+    // Pool names carry the element they belong to, e.g. v4l2h264dec0:pool0:src
+    g_print("Allocation (negotiated): pool %s, %u bytes, %u to %u buffers, video meta %s\n",
+            GST_OBJECT_NAME(buffer->pool), size, min, max,
+            (gst_buffer_get_video_meta(buffer) != nullptr) ? "yes" : "no");
+    gst_structure_free(config);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void GstPlayer::addAllocationMeta(GstQuery *query, GType api)
+{
+    if (gst_query_find_allocation_meta(query, api, nullptr) == FALSE) {
+        gst_query_add_allocation_meta(query, api, nullptr);
+    }
+}
+
+void GstPlayer::reportAllocation(const gchar *where, GstQuery *query)
+{
+    std::string metas;
+    for (guint i = 0; i < gst_query_get_n_allocation_metas(query); i++) {
+        metas += (i > 0 ? ", " : "");
+        metas += g_type_name(gst_query_parse_nth_allocation_meta(query, i, nullptr));
+    }
+    for (guint i = 0; i < gst_query_get_n_allocation_pools(query); i++) {
+        GstBufferPool *pool = nullptr;
+        guint size = 0;
+        guint min = 0;
+        guint max = 0;
+        gst_query_parse_nth_allocation_pool(query, i, &pool, &size, &min, &max);
+        g_print("Allocation (%s): pool %s, %u bytes, %u to %u buffers, metas: %s\n", where,
+                (pool != nullptr) ? GST_OBJECT_NAME(pool) : "any", size, min, max, metas.data());
+        if (pool != nullptr) {
+            gst_object_unref(GST_OBJECT(pool));
+        }
+    }
+}
+
 GstPadProbeReturn GstPlayer::onEvent(GstPad *pad, GstPadProbeInfo *info, gpointer data)
 {
     auto *ctx = static_cast<GstPlayer *>(data);
@@ -256,17 +1004,125 @@ GstPadProbeReturn GstPlayer::onEvent(GstPad *pad, GstPadProbeInfo *info, gpointe
         gst_event_parse_caps(event, &caps);
 
         GstStructure *properties = gst_caps_get_structure(caps, 0);
-        if (gst_structure_get_int(properties, "width", &ctx->m_width) != 0
-            && gst_structure_get_int(properties, "height", &ctx->m_height) != 0) {
-            return GST_PAD_PROBE_HANDLED;
-        } else {
+        if (gst_structure_get_int(properties, "width", &ctx->m_width) == 0
+            || gst_structure_get_int(properties, "height", &ctx->m_height) == 0) {
             g_print("GStreamer Error: Could not find stream dimensions\n");
         }
+    } else if (GST_EVENT_TYPE(event) == GST_EVENT_TAG) {
+        GstTagList *tags;
+        gst_event_parse_tag(event, &tags);
+        ctx->updateOrientation(tags);
     }
 
+    // The appsink still needs the event
     return GST_PAD_PROBE_OK;
 }
 
+void GstPlayer::updateOrientation(GstTagList *tags)
+{
+    gchar *orientation = nullptr;
+    if (gst_tag_list_get_string(tags, GST_TAG_IMAGE_ORIENTATION, &orientation) == FALSE) {
+        return;
+    }
+
+    // "rotate-<degrees>" or "flip-rotate-<degrees>", flip being horizontal and applied first
+    std::string_view value(orientation);
+    bool isFlipped = g_str_has_prefix(orientation, "flip-") != FALSE;
+    if (isFlipped) {
+        value.remove_prefix(5);
+    }
+    if (value.substr(0, 7) == "rotate-") {
+        m_rotation = static_cast<int>(g_ascii_strtoll(value.data() + 7, nullptr, 10)) % 360;
+        m_isFlipped = isFlipped;
+    }
+    g_free(orientation);
+}
+
+void GstPlayer::updateTextureMetas(GstGLMemory *memory)
+{
+    // Crop and transformation metas are applied by the renderer, so that upstream elements do
+    // not need to copy the frames.
+    const Texture defaults {};
+    gint width = GST_VIDEO_INFO_WIDTH(&memory->info);
+    gint height = GST_VIDEO_INFO_HEIGHT(&memory->info);
+    GstVideoCropMeta *crop = gst_buffer_get_video_crop_meta(m_bufferRender);
+    if (crop != nullptr && width > 0 && height > 0) {
+        m_texture.crop[0] = static_cast<float>(crop->x) / width;
+        m_texture.crop[1] = static_cast<float>(crop->y) / height;
+        m_texture.crop[2] = static_cast<float>(crop->width) / width;
+        m_texture.crop[3] = static_cast<float>(crop->height) / height;
+    } else {
+        std::copy(std::begin(defaults.crop), std::end(defaults.crop), std::begin(m_texture.crop));
+    }
+
+    GstVideoAffineTransformationMeta *affine =
+            gst_buffer_get_video_affine_transformation_meta(m_bufferRender);
+    if (affine != nullptr) {
+        gst_gl_get_affine_transformation_meta_as_ndc(affine, m_texture.transform);
+    } else {
+        std::copy(std::begin(defaults.transform), std::end(defaults.transform),
+                  std::begin(m_texture.transform));
+    }
+
+    updateOverlays(width, height);
+}
+
+void GstPlayer::updateOverlays(gint width, gint height)
+{
+    GstVideoOverlayCompositionMeta *meta =
+            gst_buffer_get_video_overlay_composition_meta(m_bufferRender);
+    if (meta == nullptr || width <= 0 || height <= 0) {
+        m_texture.overlaySequence = 0;
+        m_texture.overlays.clear();
+        return;
+    }
+    // Subtitles change far less often than frames: pixels are only copied for new compositions
+    guint64 sequence = gst_video_overlay_composition_get_seqnum(meta->overlay);
+    sequence++;
+    if (sequence == m_texture.overlaySequence) {
+        return;
+    }
+    m_texture.overlaySequence = sequence;
+    m_texture.overlays.clear();
+
+    guint count = gst_video_overlay_composition_n_rectangles(meta->overlay);
+    for (guint i = 0; i < count; i++) {
+        GstVideoOverlayRectangle *rectangle =
+                gst_video_overlay_composition_get_rectangle(meta->overlay, i);
+        gint x = 0;
+        gint y = 0;
+        guint renderWidth = 0;
+        guint renderHeight = 0;
+        gst_video_overlay_rectangle_get_render_rectangle(rectangle, &x, &y, &renderWidth,
+                                                         &renderHeight);
+        // Scaling to the render rectangle is done by the GPU
+        GstBuffer *buffer = gst_video_overlay_rectangle_get_pixels_unscaled_argb(
+                rectangle, GST_VIDEO_OVERLAY_FORMAT_FLAG_PREMULTIPLIED_ALPHA);
+        GstVideoMeta *videoMeta = gst_buffer_get_video_meta(buffer);
+        GstMapInfo map;
+        if (videoMeta == nullptr || gst_buffer_map(buffer, &map, GST_MAP_READ) == FALSE) {
+            continue;
+        }
+
+        Texture::Overlay overlay;
+        overlay.rect[0] = static_cast<float>(x) / width;
+        overlay.rect[1] = static_cast<float>(y) / height;
+        overlay.rect[2] = static_cast<float>(renderWidth) / width;
+        overlay.rect[3] = static_cast<float>(renderHeight) / height;
+        overlay.width = videoMeta->width;
+        overlay.height = videoMeta->height;
+        auto pixels = std::make_shared<std::vector<guint8>>(overlay.width * overlay.height * 4);
+        gsize rowSize = overlay.width * 4;
+        for (guint row = 0; row < overlay.height; row++) {
+            std::copy_n(map.data + videoMeta->offset[0] + row * videoMeta->stride[0], rowSize,
+                        pixels->data() + row * rowSize);
+        }
+        overlay.pixels = std::move(pixels);
+        gst_buffer_unmap(buffer, &map);
+        m_texture.overlays.push_back(std::move(overlay));
+    }
+}
+
 gboolean GstPlayer::onBusMessage(GstBus *bus, GstMessage *msg, gpointer data)
 {
     auto *ctx = static_cast<GstPlayer *>(data);
@@ -275,10 +1131,16 @@ gboolean GstPlayer::onBusMessage(GstBus *bus, GstMessage *msg, gpointer data)
     case GST_MESSAGE_EOS:
         // Restart pipeline
         if (ctx->m_looping) {
-            if (!gst_element_seek(ctx->m_pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
-                                  GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE)) {
-                g_print("GStreamer Error: Failed to restart pipeline\n");
-            }
+            ctx->enqueue(GstPlayerCommand::Seek, [ctx]() {
+                if (ctx->m_initialized == false
+                    || !gst_element_seek(ctx->m_pipeline, 1.0, GST_FORMAT_TIME,
+                                         GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, 0,
+                                         GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE)) {
+                    g_print("GStreamer Error: Failed to restart pipeline\n");
+                    return false;
+                }
+                return true;
+            });
         }
 
         break;
@@ -313,6 +1175,15 @@ gboolean GstPlayer::onBusMessage(GstBus *bus, GstMessage *msg, gpointer data)
         }
         break;
     }
+    case GST_MESSAGE_QOS: {
+        // Frames dropped by the video decoder or the video sink for being late
+        GstObject *source = GST_MESSAGE_SRC(msg);
+        if (GST_IS_VIDEO_DECODER(source)
+            || g_strcmp0(GST_OBJECT_NAME(source), "GstPlayerSink") == 0) {
+            ctx->m_adaptiveBitrate.onFrameDropped();
+        }
+        break;
+    }
     case GST_MESSAGE_ASYNC_DONE: {
         if (ctx->m_isPrerollDone == false) {
             ctx->m_isPrerollDone = true;
@@ -327,55 +1198,72 @@ gboolean GstPlayer::onBusMessage(GstBus *bus, GstMessage *msg, gpointer data)
     return TRUE;
 }
 
-void GstPlayer::init()
+GstElement *GstPlayer::createVideoSinkBin()
 {
-    // Launch pipeline
-    GError *error = nullptr;
-    g_print("Loading GStreamer pipeline: %s\n", m_pipelineCommand.data());
-    m_pipeline = gst_parse_launch(m_pipelineCommand.data(), &error);
-    if (error != nullptr) {
-        g_print("gst_parse_launch fails with error: %s\n", error->message);
-        g_clear_error(&error);
-        throw std::runtime_error("Failed to load GStreamer pipeline");
-    }
-
-    // Watch bus
-    m_bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
-    gst_bus_add_watch(m_bus, GstPlayer::onBusMessage, static_cast<gpointer>(this));
-
     // Create a bin for video-sink containing glupload and appsink elements
     // Input of appsink must be an OpenGL texture, so the pipeline must contain glupload element.
+    // Without GL context, videoconvert only converts what cannot be sampled as is.
     GstElement *bin = gst_bin_new("video_sink_bin");
-    GstElement *glupload = gst_element_factory_make("glupload", "glupload");
+    GstElement *glupload = m_isGlOutput ? gst_element_factory_make("glupload", "glupload")
+                                        : gst_element_factory_make("videoconvert", "frameconvert");
     GstElement *sink = gst_element_factory_make("appsink", "GstPlayerSink");
     gst_bin_add_many(GST_BIN(bin), glupload, sink, NULL);
     gst_element_link(glupload, sink);
 
-    // Use imxvideoconvert_g2d with Amphion VPU
-    GstPad *pad;
-    if (IS_AMPHION() == true) {
-        GstElement *imxvideoconvert =
-                gst_element_factory_make("imxvideoconvert_g2d", "imxvideoconvert_g2d");
-        gst_bin_add(GST_BIN(bin), imxvideoconvert);
-        gst_element_link(imxvideoconvert, glupload);
-        pad = gst_element_get_static_pad(imxvideoconvert, "sink");
-    } else {
-        pad = gst_element_get_static_pad(glupload, "sink");
-    }
+    // Optional tee publishing the frames to other processes
+    GstElement *head = createFrameTap(bin, glupload);
 
     // Create ghost pad from first element's pad to connect the video_sink_bin to the rest of the
     // pipeline.
+    GstPad *pad = gst_element_get_static_pad(head, "sink");
     GstPad *ghostPad;
     ghostPad = gst_ghost_pad_new("sink", pad);
     gst_pad_set_active(ghostPad, TRUE);
     gst_element_add_pad(bin, ghostPad);
     gst_object_unref(GST_OBJECT(pad));
 
-    g_object_set(GST_OBJECT(m_pipeline), "video-sink", bin, NULL);
+    // The color converter, if any, is chosen once the decoded format is known. Until then the bin
+    // accepts any format one of the converters does, so that the decoder keeps its own format
+    // (e.g. tiled) and upstream does not convert on its own.
+    if (m_isGlOutput) {
+        gst_pad_add_probe(ghostPad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, GstPlayer::onSinkBinEvent,
+                          static_cast<gpointer>(this), nullptr);
+        gst_pad_add_probe(ghostPad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, GstPlayer::onSinkBinCaps,
+                          static_cast<gpointer>(this), nullptr);
+
+        // Only single RGB textures can be rendered. Frames with overlay composition metas are
+        // preferred: playbin then hands subtitles over as rectangles instead of blending them.
+        // Set before preroll, so that the text overlay sees the feature when it first negotiates.
+        GstCaps *sinkCaps = VideoConverterSelector::instance().getOutputCaps();
+        GstCaps *overlayCaps = gst_caps_copy(sinkCaps);
+        for (guint i = 0; i < gst_caps_get_size(overlayCaps); i++) {
+            GstCapsFeatures *features =
+                    gst_caps_features_copy(gst_caps_get_features(overlayCaps, i));
+            gst_caps_features_add(features, GST_CAPS_FEATURE_META_GST_VIDEO_OVERLAY_COMPOSITION);
+            gst_caps_set_features(overlayCaps, i, features);
+        }
+        gst_caps_append(overlayCaps, sinkCaps);
+        g_object_set(sink, "caps", overlayCaps, nullptr);
+        gst_caps_unref(overlayCaps);
+    } else {
+        GstCaps *caps = gst_caps_from_string(FrameCaps.data());
+        g_object_set(sink, "caps", caps, nullptr);
+        gst_caps_unref(caps);
+    }
+    // Sizes the decoder pool once the bin has answered its allocation query
+    gst_pad_add_probe(ghostPad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, GstPlayer::onSinkBinQuery,
+                      static_cast<gpointer>(this), nullptr);
 
     // Enable sink's signals emission.
     g_object_set(sink, "emit-signals", TRUE, nullptr);
 
+    // Live sources: render frames as soon as they are decoded and never queue more than one.
+    if (m_isLive) {
+        g_object_set(sink, "sync", FALSE, "max-buffers", 1, "drop", TRUE, nullptr);
+    }
+
+    applyMaxFrameRate(sink);
+
     // Call onNewSample() every time the sink receives a buffer.
     g_signal_connect(G_OBJECT(sink), "new-sample", G_CALLBACK(GstPlayer::onNewSample),
                      static_cast<gpointer>(this));
@@ -387,21 +1275,440 @@ void GstPlayer::init()
     gst_pad_add_probe(sinkPad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_EVENT_BOTH), GstPlayer::onEvent,
                       static_cast<gpointer>(this), nullptr);
 
+    return bin;
+}
+
+GstElement *GstPlayer::createFrameTap(GstElement *bin, GstElement *glupload)
+{
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lock(m_pipelineLock);
+        name = m_frameTapName;
+    }
+    if (name.empty()) {
+        m_frameTap.reset();
+        return glupload;
+    }
+    // Kept across pipelines so that readers stay connected
+    if (m_frameTap == nullptr || m_frameTap->getName() != (name[0] == '/' ? name : "/" + name)) {
+        m_frameTap = std::make_unique<FrameTap>(name);
+    }
+
+    // tee ! glupload ! appsink
+    //     ! queue ! appsink (tap)
+    // The tap branch drops frames rather than slowing down rendering.
+    GstElement *tee = gst_element_factory_make("tee", "tee");
+    GstElement *queue = gst_element_factory_make("queue", "tapqueue");
+    GstElement *tap = gst_element_factory_make("appsink", "GstPlayerTap");
+    gst_util_set_object_arg(G_OBJECT(queue), "leaky", "downstream");
+    g_object_set(queue, "max-size-buffers", 2, "max-size-bytes", 0, "max-size-time",
+                 (guint64)0, nullptr);
+    g_object_set(tap, "emit-signals", TRUE, "sync", FALSE, "async", FALSE, "max-buffers", 1,
+                 "drop", TRUE, nullptr);
+    gst_bin_add_many(GST_BIN(bin), tee, queue, tap, NULL);
+    gst_element_link_many(tee, glupload, NULL);
+    gst_element_link_many(tee, queue, tap, NULL);
+
+    g_signal_connect(G_OBJECT(tap), "new-sample", G_CALLBACK(GstPlayer::onTapSample),
+                     static_cast<gpointer>(this));
+    GstPad *tapPad = gst_element_get_static_pad(tap, "sink");
+    gst_pad_add_probe(tapPad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, GstPlayer::onTapQuery,
+                      static_cast<gpointer>(this), nullptr);
+    gst_object_unref(GST_OBJECT(tapPad));
+
+    return tee;
+}
+
+GstFlowReturn GstPlayer::onTapSample(GstElement *appsink, gpointer data)
+{
+    auto *ctx = static_cast<GstPlayer *>(data);
+
+    GstSample *sample = nullptr;
+    g_signal_emit_by_name(appsink, "pull-sample", &sample);
+    if (sample == nullptr) {
+        return GST_FLOW_OK;
+    }
+
+    GstVideoInfo info;
+    GstVideoFrame frame;
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    if (gst_video_info_from_caps(&info, gst_sample_get_caps(sample))
+        && gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ)) {
+        guint planes = GST_VIDEO_FRAME_N_PLANES(&frame);
+        uint32_t stride[GST_VIDEO_MAX_PLANES];
+        uint64_t planeSize[GST_VIDEO_MAX_PLANES];
+        const uint8_t *planeData[GST_VIDEO_MAX_PLANES];
+        for (guint i = 0; i < planes; i++) {
+            // Layout from the video meta when upstream uses padded strides: rows of the plane's
+            // first component, bounded by the memory mapped for the plane (each plane is mapped
+            // on its own with a video meta). The padding of the last row may be missing.
+            guint component = 0;
+            while (component + 1 < GST_VIDEO_FRAME_N_COMPONENTS(&frame)
+                   && GST_VIDEO_FRAME_COMP_PLANE(&frame, component) != i) {
+                component++;
+            }
+            const GstMapInfo &map = (frame.meta != nullptr) ? frame.map[i] : frame.map[0];
+            stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, i);
+            planeData[i] = static_cast<const uint8_t *>(GST_VIDEO_FRAME_PLANE_DATA(&frame, i));
+            gsize available = (planeData[i] >= map.data && planeData[i] < map.data + map.size)
+                    ? map.data + map.size - planeData[i]
+                    : 0;
+            planeSize[i] = std::min<gsize>(
+                    static_cast<gsize>(stride[i]) * GST_VIDEO_FRAME_COMP_HEIGHT(&frame, component),
+                    available);
+        }
+
+        FrameTap::Frame tapFrame = { gst_video_format_to_string(GST_VIDEO_FRAME_FORMAT(&frame)),
+                                     static_cast<uint32_t>(GST_VIDEO_FRAME_WIDTH(&frame)),
+                                     static_cast<uint32_t>(GST_VIDEO_FRAME_HEIGHT(&frame)),
+                                     planes,
+                                     stride,
+                                     planeSize,
+                                     planeData,
+                                     GST_BUFFER_PTS(buffer) };
+        ctx->m_frameTap->publish(tapFrame);
+        gst_video_frame_unmap(&frame);
+    }
+
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+GstPadProbeReturn GstPlayer::onTapQuery(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+
+    // Frames are read through GstVideoMeta, so that the tee does not make upstream copy padded
+    // frames for this branch.
+    if (GST_QUERY_TYPE(query) == GST_QUERY_ALLOCATION) {
+        gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, nullptr);
+        return GST_PAD_PROBE_HANDLED;
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GstPlayer::onSinkBinCaps(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    // Once negotiated, the converter (or glupload) behind the ghost pad answers
+    if (gst_pad_has_current_caps(pad)) {
+        return GST_PAD_PROBE_REMOVE;
+    }
+
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+    if (GST_QUERY_TYPE(query) == GST_QUERY_CAPS) {
+        GstCaps *filter = nullptr;
+        gst_query_parse_caps(query, &filter);
+        GstCaps *caps = VideoConverterSelector::instance().getInputCaps();
+        if (filter != nullptr) {
+            GstCaps *filtered = gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+            gst_caps_unref(caps);
+            caps = filtered;
+        }
+        gst_query_set_caps_result(query, caps);
+        gst_caps_unref(caps);
+        return GST_PAD_PROBE_HANDLED;
+    }
+    if (GST_QUERY_TYPE(query) == GST_QUERY_ACCEPT_CAPS) {
+        GstCaps *caps = nullptr;
+        gst_query_parse_accept_caps(query, &caps);
+        GstCaps *inputCaps = VideoConverterSelector::instance().getInputCaps();
+        gst_query_set_accept_caps_result(query, gst_caps_is_subset(caps, inputCaps));
+        gst_caps_unref(inputCaps);
+        return GST_PAD_PROBE_HANDLED;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GstPlayer::onSinkBinEvent(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstCaps *caps;
+    gst_event_parse_caps(event, &caps);
+    VideoConverterSelector &selector = VideoConverterSelector::instance();
+    VideoConverterSelector::Converter converter = selector.select(caps);
+
+    GstElement *bin = gst_pad_get_parent_element(pad);
+    GstElement *glupload = gst_bin_get_by_name(GST_BIN(bin), "glupload");
+    GstElement *sink = gst_bin_get_by_name(GST_BIN(bin), "GstPlayerSink");
+
+    if (converter.factory.empty() == false) {
+        // The caps event has not reached the bin yet: link the converter now so that it is the
+        // first element to receive it.
+        GstElement *convert = gst_element_factory_make(converter.factory.data(), nullptr);
+        bool linked = false;
+
+        if (convert != nullptr) {
+            gst_bin_add(GST_BIN(bin), convert);
+            if (converter.afterUpload) {
+                gst_element_unlink(glupload, sink);
+                linked = gst_element_link_many(glupload, convert, sink, nullptr) != FALSE;
+            } else {
+                // Converter goes before the first element of the bin (glupload or the tap's tee)
+                GstPad *target = gst_ghost_pad_get_target(GST_GHOST_PAD(pad));
+                GstElement *head = gst_pad_get_parent_element(target);
+                GstPad *convertPad = gst_element_get_static_pad(convert, "sink");
+                linked = gst_ghost_pad_set_target(GST_GHOST_PAD(pad), convertPad) != FALSE
+                        && gst_element_link(convert, head) != FALSE;
+                gst_object_unref(GST_OBJECT(convertPad));
+                gst_object_unref(GST_OBJECT(head));
+                gst_object_unref(GST_OBJECT(target));
+            }
+            gst_element_sync_state_with_parent(convert);
+        }
+        if (linked == false) {
+            g_print("GStreamer Error: Cannot insert %s in video sink\n",
+                    converter.factory.data());
+        } else {
+            g_print("Using %s color converter\n", converter.factory.data());
+        }
+    }
+
+    gst_object_unref(GST_OBJECT(glupload));
+    gst_object_unref(GST_OBJECT(sink));
+    gst_object_unref(GST_OBJECT(bin));
+
+    return GST_PAD_PROBE_REMOVE;
+}
+
+bool GstPlayer::attachVideoSinkBin(GstElement *bin, std::string &reason)
+{
+    GstElement *placeholder =
+            gst_bin_get_by_name(GST_BIN(m_pipeline), std::string(PipelinePlaceholder).data());
+    if (placeholder == nullptr) {
+        reason = "no element named \"" + std::string(PipelinePlaceholder) + "\"";
+        return false;
+    }
+
+    // GL elements of the custom graph use the application's display and context, the same way
+    // onQuery() answers glupload.
+    if (m_isGlOutput) {
+        GstContext *displayContext = gst_context_new(GST_GL_DISPLAY_CONTEXT_TYPE, TRUE);
+        gst_context_set_gl_display(displayContext, getGlDisplay());
+        gst_element_set_context(m_pipeline, displayContext);
+        gst_context_unref(displayContext);
+
+        GstContext *appContext = gst_context_new("gst.gl.app_context", TRUE);
+        gst_structure_set(gst_context_writable_structure(appContext), "context",
+                          GST_TYPE_GL_CONTEXT, m_glContext, nullptr);
+        gst_element_set_context(m_pipeline, appContext);
+        gst_context_unref(appContext);
+    }
+
+    GstBin *parent = GST_BIN(GST_ELEMENT_PARENT(placeholder));
+    GstPad *binPad = gst_element_get_static_pad(bin, "sink");
+    GstPad *srcPad = gst_element_get_static_pad(placeholder, "src");
+    GstPad *upstreamPad = nullptr;
+    bool attached = false;
+
+    if (srcPad != nullptr) {
+        // Pass-through placeholder (e.g. identity): the sink bin is linked after it, which also
+        // works when the placeholder is fed by a sometimes pad (decodebin, demuxers).
+        upstreamPad = GST_PAD(gst_object_ref(srcPad));
+    } else {
+        // Sink placeholder (e.g. fakesink): replace it with the sink bin.
+        GstPad *placeholderPad = gst_element_get_static_pad(placeholder, "sink");
+        if (placeholderPad != nullptr) {
+            upstreamPad = gst_pad_get_peer(placeholderPad);
+            if (upstreamPad != nullptr) {
+                gst_pad_unlink(upstreamPad, placeholderPad);
+                gst_bin_remove(parent, placeholder);
+            } else {
+                reason = "placeholder sink is linked to a dynamic pad, use a pass-through "
+                         "placeholder such as identity instead";
+            }
+            gst_object_unref(GST_OBJECT(placeholderPad));
+        } else {
+            reason = "placeholder has neither a src nor a sink pad";
+        }
+    }
+
+    if (upstreamPad != nullptr) {
+        // Validate caps before starting the pipeline. A pass-through placeholder proxies the
+        // caps of its own upstream peer, or answers ANY while it has none: when it is fed by a
+        // sometimes pad, the check happens once that pad is linked.
+        GstCaps *upstreamCaps = nullptr;
+        GstPad *placeholderPad =
+                (srcPad != nullptr) ? gst_element_get_static_pad(placeholder, "sink") : nullptr;
+        if (srcPad == nullptr) {
+            upstreamCaps = gst_pad_query_caps(upstreamPad, nullptr);
+        } else if (placeholderPad != nullptr && gst_pad_is_linked(placeholderPad)) {
+            upstreamCaps = gst_pad_peer_query_caps(placeholderPad, nullptr);
+        } else if (placeholderPad != nullptr) {
+            g_signal_connect(placeholderPad, "linked", G_CALLBACK(GstPlayer::onPlaceholderLinked),
+                             nullptr);
+        }
+        if (placeholderPad != nullptr) {
+            gst_object_unref(GST_OBJECT(placeholderPad));
+        }
+
+        if (upstreamCaps == nullptr || isSinkBinCompatible(upstreamCaps, binPad, reason)) {
+            gst_bin_add(parent, bin);
+            if (GST_PAD_LINK_FAILED(gst_pad_link(upstreamPad, binPad))) {
+                gst_bin_remove(parent, bin);
+                reason = "linking the video sink bin failed";
+            } else {
+                attached = true;
+            }
+        }
+        if (upstreamCaps != nullptr) {
+            gst_caps_unref(upstreamCaps);
+        }
+        gst_object_unref(GST_OBJECT(upstreamPad));
+    }
+
+    if (srcPad != nullptr) {
+        gst_object_unref(GST_OBJECT(srcPad));
+    }
+    gst_object_unref(GST_OBJECT(binPad));
+    gst_object_unref(GST_OBJECT(placeholder));
+    return attached;
+}
+
+bool GstPlayer::isSinkBinCompatible(GstCaps *upstreamCaps, GstPad *binPad, std::string &reason)
+{
+    if (gst_caps_is_any(upstreamCaps)) {
+        return true;
+    }
+    GstCaps *sinkCaps = gst_pad_query_caps(binPad, nullptr);
+    bool isCompatible = gst_caps_can_intersect(upstreamCaps, sinkCaps) != FALSE;
+    if (isCompatible == false) {
+        gchar *caps = gst_caps_to_string(upstreamCaps);
+        reason = std::string("placeholder input caps are not supported by the video sink: ")
+                + caps;
+        g_free(caps);
+    }
+    gst_caps_unref(sinkCaps);
+    return isCompatible;
+}
+
+void GstPlayer::onPlaceholderLinked(GstPad *pad, GstPad *peer, gpointer data)
+{
+    // Pass-through placeholder fed by a sometimes pad, from a streaming thread: the pipeline is
+    // already running, an error message stops it before negotiation fails less clearly.
+    GstElement *placeholder = gst_pad_get_parent_element(pad);
+    if (placeholder == nullptr) {
+        return;
+    }
+    GstPad *srcPad = gst_element_get_static_pad(placeholder, "src");
+    GstPad *binPad = (srcPad != nullptr) ? gst_pad_get_peer(srcPad) : nullptr;
+    if (binPad != nullptr) {
+        std::string reason;
+        GstCaps *upstreamCaps = gst_pad_query_caps(peer, nullptr);
+        if (isSinkBinCompatible(upstreamCaps, binPad, reason) == false) {
+            GST_ELEMENT_ERROR(placeholder, CORE, NEGOTIATION, ("%s", reason.data()), (nullptr));
+        }
+        gst_caps_unref(upstreamCaps);
+        gst_object_unref(GST_OBJECT(binPad));
+    }
+    if (srcPad != nullptr) {
+        gst_object_unref(GST_OBJECT(srcPad));
+    }
+    gst_object_unref(GST_OBJECT(placeholder));
+}
+
+void GstPlayer::init()
+{
+    // Launch pipeline
+    GError *error = nullptr;
+    g_print("Loading GStreamer pipeline: %s\n", m_pipelineCommand.data());
+    m_pipeline = gst_parse_launch(m_pipelineCommand.data(), &error);
+    if (error != nullptr) {
+        g_print("gst_parse_launch fails with error: %s\n", error->message);
+        g_clear_error(&error);
+        throw std::runtime_error("Failed to load GStreamer pipeline");
+    }
+
+    bool isDedicatedUpload;
+    {
+        std::lock_guard<std::mutex> lock(m_pipelineLock);
+        isDedicatedUpload = m_isDedicatedUpload;
+        // Variants only exist for playbin sources, live streams favor latency over quality. The
+        // controller stays dormant until an adaptive demuxer is created.
+        m_isAdaptiveAllowed =
+                m_isAdaptiveBitrate && m_isCustomPipeline == false && m_isLive == false;
+    }
+    m_uploadContext.reset();
+    if (isDedicatedUpload && m_isGlOutput) {
+        m_uploadContext = GlUploadContext::acquire(GST_GL_DISPLAY(m_gstDisplay), m_glContext);
+        if (m_uploadContext->isValid() == false) {
+            m_uploadContext.reset();
+        }
+    }
+
+    // Watch bus
+    m_bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
+    gst_bus_add_watch(m_bus, GstPlayer::onBusMessage, static_cast<gpointer>(this));
+
+    // Configure live and read-ahead sources as soon as playbin creates them
+    if (m_isLive || m_sourceReadAhead != ReadAheadMode::Off) {
+        g_signal_connect(m_pipeline, "source-setup", G_CALLBACK(GstPlayer::onSourceSetup),
+                         static_cast<gpointer>(this));
+    }
+    // Live sources and adaptive demuxers are configured as playbin creates them
+    if (m_isLive || m_isAdaptiveAllowed) {
+        g_signal_connect(m_pipeline, "deep-element-added",
+                         G_CALLBACK(GstPlayer::onDeepElementAdded), static_cast<gpointer>(this));
+    }
+    m_adaptiveBitrate.reset();
+
+    // Create the GL sink bin and attach it to playbin or to the custom pipeline placeholder
+    GstElement *bin = createVideoSinkBin();
+    if (m_isCustomPipeline) {
+        std::string reason;
+        gst_object_ref_sink(bin);
+        bool attached = attachVideoSinkBin(bin, reason);
+        gst_object_unref(GST_OBJECT(bin));
+        if (attached == false) {
+            g_print("Cannot attach video sink to pipeline: %s\n", reason.data());
+            gst_bus_remove_watch(m_bus);
+            gst_object_unref(GST_OBJECT(m_bus));
+            gst_object_unref(GST_OBJECT(m_pipeline));
+            throw std::runtime_error("Failed to attach video sink to GStreamer pipeline");
+        }
+    } else {
+        g_object_set(GST_OBJECT(m_pipeline), "video-sink", bin, NULL);
+    }
+
     // Start pipeline
     GstStateChangeReturn stateReturn = gst_element_set_state(m_pipeline, GST_STATE_PAUSED);
     if (stateReturn == GST_STATE_CHANGE_FAILURE) {
+        gst_element_set_state(m_pipeline, GST_STATE_NULL);
+        {
+            std::lock_guard<std::mutex> lock(m_adaptiveLock);
+            if (m_adaptiveSource != nullptr) {
+                g_source_destroy(m_adaptiveSource);
+                g_source_unref(m_adaptiveSource);
+                m_adaptiveSource = nullptr;
+            }
+            gst_object_replace(reinterpret_cast<GstObject **>(&m_adaptiveDemux), nullptr);
+        }
+        gst_bus_remove_watch(m_bus);
+        gst_object_unref(GST_OBJECT(m_bus));
+        gst_object_unref(GST_OBJECT(m_pipeline));
         throw std::runtime_error("Failed to play GStreamer pipeline");
     }
 
+    std::lock_guard<std::mutex> lock(m_pipelineLock);
     m_initialized = true;
 }
 
-void GstPlayer::deinit()
+void GstPlayer::release()
 {
     if (m_initialized) {
+        {
+            // Stop handing out the pipeline before tearing it down
+            std::lock_guard<std::mutex> lock(m_pipelineLock);
+            m_initialized = false;
+        }
+
         GstStateChangeReturn stateReturn = gst_element_set_state(m_pipeline, GST_STATE_NULL);
         if (stateReturn == GST_STATE_CHANGE_FAILURE) {
-            throw std::runtime_error("Failed to deinit GStreamer pipeline");
+            g_print("GStreamer Error: Failed to deinit GStreamer pipeline\n");
         }
 
         // Release buffers
@@ -410,38 +1717,147 @@ void GstPlayer::deinit()
             gst_buffer_unref(m_bufferLast);
         }
         m_bufferLast = nullptr;
+        GlUploadContext::destroyFence(m_eglDisplay, m_fenceLast);
+        m_fenceLast = EGL_NO_SYNC_KHR;
+        m_contextWaits.clear();
         if (m_bufferRender != nullptr) {
             gst_buffer_unref(m_bufferRender);
             m_bufferRender = nullptr;
         }
-        m_bufferLock.unlock();
-
         m_texture.id = (guint)-1;
         m_texture.target = (guint)-1;
+        m_texture.overlaySequence = 0;
+        m_texture.overlays.clear();
+        m_texture.hold.reset();
+        m_texture.generation = 0;
+        m_frame.buffer = nullptr;
+        m_frame.hold.reset();
+        m_frame.generation = 0;
+        m_holdRender.reset();
+        // Renderers skipping unchanged generations must drop the released texture as well
+        m_frameGeneration++;
+        m_bufferLock.unlock();
+
+        m_latency = -1;
+        m_rotation = 0;
+        m_isFlipped = false;
+        {
+            std::lock_guard<std::mutex> lock(m_adaptiveLock);
+            if (m_adaptiveSource != nullptr) {
+                g_source_destroy(m_adaptiveSource);
+                g_source_unref(m_adaptiveSource);
+                m_adaptiveSource = nullptr;
+            }
+            gst_object_replace(reinterpret_cast<GstObject **>(&m_adaptiveDemux), nullptr);
+        }
         gst_bus_remove_watch(m_bus);
         gst_object_unref(GST_OBJECT(m_bus));
         gst_object_unref(GST_OBJECT(m_pipeline));
-        m_initialized = false;
+        // Other players may still use the same upload context
+        m_uploadContext.reset();
         m_isPrerollDone = false;
     }
 }
 
 void GstPlayer::reset()
 {
-    deinit();
+    release();
     init();
 }
 
+void GstPlayer::enqueue(GstPlayerCommand command, std::function<bool()> action, bool isRelative)
+{
+    std::lock_guard<std::mutex> lock(m_commandLock);
+    if (m_workerRunning == false) {
+        return;
+    }
+    // A new load or absolute seek supersedes the pending ones of the same kind, relative skips
+    // included. Skips add up, so they are all kept.
+    if ((command == GstPlayerCommand::Load || command == GstPlayerCommand::Seek)
+        && isRelative == false) {
+        for (auto it = m_commands.begin(); it != m_commands.end();) {
+            it = (it->type == command) ? m_commands.erase(it) : std::next(it);
+        }
+    }
+    m_commands.push_back({ command, std::move(action) });
+
+    // Commands are run from an idle source rather than inline, even when enqueued from the
+    // worker thread itself (e.g. from a bus message), so they never nest.
+    if (m_commandsScheduled == false) {
+        m_commandsScheduled = true;
+        GSource *source = g_idle_source_new();
+        g_source_set_callback(source, GstPlayer::onProcessCommands, static_cast<gpointer>(this),
+                              nullptr);
+        g_source_attach(source, m_mainContext);
+        g_source_unref(source);
+    }
+}
+
+void GstPlayer::runWorker()
+{
+    // Bus watches added by init() attach to the thread-default context, so bus messages of this
+    // player are dispatched on this thread.
+    g_main_context_push_thread_default(m_mainContext);
+    g_main_loop_run(m_mainLoop);
+    g_main_context_pop_thread_default(m_mainContext);
+}
+
+void GstPlayer::processCommands()
+{
+    std::unique_lock<std::mutex> lock(m_commandLock);
+    while (m_workerRunning && !m_commands.empty()) {
+        PendingCommand command = std::move(m_commands.front());
+        m_commands.pop_front();
+        lock.unlock();
+
+        bool success = false;
+        try {
+            success = command.action();
+        } catch (const std::exception &e) {
+            g_print("GstPlayer command failed: %s\n", e.what());
+        }
+        notifyCommandDone(command.type, success);
+
+        lock.lock();
+    }
+    m_commandsScheduled = false;
+}
+
+gboolean GstPlayer::onProcessCommands(gpointer data)
+{
+    static_cast<GstPlayer *>(data)->processCommands();
+    return G_SOURCE_REMOVE;
+}
+
+gboolean GstPlayer::onQuitWorker(gpointer data)
+{
+    auto *ctx = static_cast<GstPlayer *>(data);
+    ctx->release();
+    g_main_loop_quit(ctx->m_mainLoop);
+    return G_SOURCE_REMOVE;
+}
+
 void GstPlayer::notifyNewFrame()
 {
-    if (m_listener != nullptr) {
-        m_listener->onNewFrame();
+    // Listeners only post work to their own threads, they do not call back into the player
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    for (GstPlayerListener *listener : m_listeners) {
+        listener->onNewFrame();
     }
 }
 
 void GstPlayer::notifyPrerollDone()
 {
-    if (m_listener != nullptr) {
-        m_listener->onPrerollDone();
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    for (GstPlayerListener *listener : m_listeners) {
+        listener->onPrerollDone();
+    }
+}
+
+void GstPlayer::notifyCommandDone(GstPlayerCommand command, bool success)
+{
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    for (GstPlayerListener *listener : m_listeners) {
+        listener->onCommandDone(command, success);
     }
 }
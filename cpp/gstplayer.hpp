@@ -10,8 +10,20 @@
 #include <gst/gl/egl/gstgldisplay_egl.h>
 #include <gst/gl/gl.h>
 #include <gst/gst.h>
+#include <gst/video/video.h>
 #include <string>
+#include <string_view>
 #include <mutex>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <memory>
+#include <vector>
+#include "adaptivebitrate.hpp"
+#include "frametap.hpp"
+#include "gluploadcontext.hpp"
+#include "readaheadsource.hpp"
 
 class GstLib
 {
@@ -20,11 +32,16 @@ public:
     ~GstLib();
 };
 
+// Pipeline lifecycle operations executed asynchronously by the GstPlayer worker thread
+enum class GstPlayerCommand { Load, Play, Pause, Seek, Stop };
+
 class GstPlayerListener
 {
 public:
     virtual void onNewFrame() = 0;
     virtual void onPrerollDone() = 0;
+    // Called from the GstPlayer worker thread once a command has been executed
+    virtual void onCommandDone(GstPlayerCommand command, bool success) { }
 };
 
 class GstPlayer
@@ -34,8 +51,52 @@ public:
     {
         guint id;
         guint target;
+        // Frame generation the texture belongs to
+        guint64 generation = 0;
+        // Visible region (x, y, width, height) from GstVideoCropMeta, normalized
+        float crop[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+        // GstVideoAffineTransformationMeta in normalized device coordinates, column major
+        float transform[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+        // Rectangle of GstVideoOverlayCompositionMeta (subtitles), not blended into the frame
+        struct Overlay
+        {
+            // Position in the frame, normalized
+            float rect[4];
+            guint width;
+            guint height;
+            // Premultiplied ARGB in native endianness, tightly packed
+            std::shared_ptr<const std::vector<guint8>> pixels;
+        };
+        // Changes with the composition, 0 when there is none
+        guint64 overlaySequence = 0;
+        std::vector<Overlay> overlays;
+        // Reference on the frame shared by the renderers drawing it: the texture is not recycled
+        // before the last of them drops it, even when the player has moved on to a newer frame
+        std::shared_ptr<GstBuffer> hold;
+    };
+
+    // Frame in dma-buf or system memory, for renderers that do not use the player's GL context
+    struct Frame
+    {
+        // Valid as long as hold is kept
+        GstBuffer *buffer = nullptr;
+        std::shared_ptr<GstBuffer> hold;
+        // Format, size and plane layout, from GstVideoMeta when present
+        GstVideoInfo info;
+        // DRM format modifier of dma-buf frames, 0 (linear) when unknown
+        guint64 modifier = 0;
+        guint64 generation = 0;
+        // Visible region (x, y, width, height) from GstVideoCropMeta, normalized
+        float crop[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+        // GstVideoAffineTransformationMeta in normalized device coordinates, column major
+        float transform[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
     };
 
+    // With EGL_NO_CONTEXT, frames are not uploaded to GL textures: they are handed over as
+    // dma-bufs when the decoder produces them, in system memory otherwise, through getFrame().
     GstPlayer(EGLDisplay eglDisplay, EGLContext eglContext);
     virtual ~GstPlayer();
 
@@ -46,50 +107,198 @@ public:
     void setLooping(bool loop);
     bool getLooping();
 
-    void seekToPercent(float percentPosition);
+    // Key frames only: trick mode seek, decoders skip the other frames until the next seek
+    void seekToPercent(float percentPosition, bool keyFramesOnly = false);
+    // Limits the rate of frames handed to the renderer, 0 for no limit
+    void setMaxFrameRate(guint framesPerSecond);
     void deinit();
 
+    // Replaces the listeners, nullptr to remove them all
     void setListener(GstPlayerListener *listener);
+    // Players shared between items (see PlayerRegistry) notify all of them. A removed listener is
+    // not called anymore once removeListener() returns.
+    void addListener(GstPlayerListener *listener);
+    void removeListener(GstPlayerListener *listener);
 
     void setVideoTestPattern();
     void setVideo(std::string pathToFile);
+    void setLiveSource(std::string uri, guint latencyMs = DefaultLiveLatencyMs);
+    void setPipeline(std::string description);
+    // Publish decoded frames into the named shared memory ring, from the next load on
+    void setFrameTap(std::string name);
+    // Import and convert frames in a context of GlUploadContext's pool, from the next load on.
+    // Otherwise glupload creates its own context.
+    void setDedicatedUpload(bool enabled);
+    // Limit the HLS and DASH variants to what is decoded and rendered in time, from the next load
+    // on. Enabled by default.
+    void setAdaptiveBitrate(bool enabled);
+    // Time the renderer spent on its latest frame, weighed by the adaptive bitrate controller
+    void reportRenderTime(GstClockTime time) { m_adaptiveBitrate.onRenderTime(time); }
+    // Read local files with readaheadsrc instead of filesrc, from the next load on. Off by
+    // default.
+    void setReadAhead(ReadAheadMode mode);
 
+    // Returns the texture of the latest frame, may be called by several renderers. Must be called
+    // with a context of the application share group current: the first call of each context for
+    // a new frame makes it wait for the upload to complete on the GPU.
     Texture getTexture();
+    // Returns the latest frame when the player has no GL context
+    Frame getFrame();
+    bool isGlOutput() { return m_isGlOutput; };
+    // Incremented for each new frame, and when the frames are released
+    guint64 getFrameGeneration() { return m_frameGeneration; };
     float getPercentage();
     int getWidth() { return m_width; };
     int getHeight() { return m_height; };
+    // Clockwise rotation in degrees and horizontal flip (applied first) from the orientation tag
+    int getRotation() { return m_rotation; };
+    bool isFlipped() { return m_isFlipped; };
     bool isPrerollDone() { return m_isPrerollDone; };
+    bool isLive() { return m_isLive; };
+    gint64 getLatency() { return m_latency; };
+
+    static constexpr guint DefaultLiveLatencyMs = 50;
+    // Buffers held downstream of the decoder: the latest frame, the one being rendered and the
+    // appsink preroll/queue
+    static constexpr guint HandoffBuffers = 3;
+    // Buffers allowed above the minimum in the pools we size
+    static constexpr guint PoolSlackBuffers = 2;
+    // Name of the element replaced by (or followed by) the GL sink in setPipeline() descriptions
+    static constexpr std::string_view PipelinePlaceholder = "videosink";
 
 protected:
     static GstFlowReturn onNewSample(GstElement *appsink, gpointer data);
     static GstPadProbeReturn onQuery(GstPad *pad, GstPadProbeInfo *info, gpointer data);
     static GstPadProbeReturn onEvent(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn onSinkBinEvent(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn onSinkBinQuery(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn onSinkBinCaps(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn onSinkBinBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstFlowReturn onTapSample(GstElement *appsink, gpointer data);
+    static GstPadProbeReturn onTapQuery(GstPad *pad, GstPadProbeInfo *info, gpointer data);
     static gboolean onBusMessage(GstBus *bus, GstMessage *msg, gpointer data);
+    static void onSourceSetup(GstElement *pipeline, GstElement *source, gpointer data);
+    static void onPlaceholderLinked(GstPad *pad, GstPad *peer, gpointer data);
+    static void onDeepElementAdded(GstBin *bin, GstBin *subBin, GstElement *element,
+                                   gpointer data);
+    static gboolean onProcessCommands(gpointer data);
+    static gboolean onAdaptiveTick(gpointer data);
+    static GstPadProbeReturn onDecoderBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static gboolean onQuitWorker(gpointer data);
 
     void init();
     void reset();
+    void release();
+    GstElement *acquirePipeline();
+    GstElement *createVideoSinkBin();
+    GstElement *createFrameTap(GstElement *bin, GstElement *glupload);
+    bool attachVideoSinkBin(GstElement *bin, std::string &reason);
+    // Whether what upstream can produce is accepted by the sink bin (glupload, and the converter
+    // if any). ANY caps (nothing known yet) are accepted.
+    static bool isSinkBinCompatible(GstCaps *upstreamCaps, GstPad *binPad, std::string &reason);
 
     void notifyNewFrame();
     void notifyPrerollDone();
+    void notifyCommandDone(GstPlayerCommand command, bool success);
+    // Relative commands (skip) neither supersede nor are superseded by later ones of their kind
+    void enqueue(GstPlayerCommand command, std::function<bool()> action, bool isRelative = false);
+    void runWorker();
+    void processCommands();
+    void updateLatency(GstSample *sample);
+    void applyAdaptiveLimits(const AdaptiveBitrate::Limits &limits);
+    // Starts the controller once the pipeline turns out to play HLS or DASH
+    void activateAdaptiveBitrate(GstElement *demux);
+    bool isAdaptiveActive();
+    void applyMaxFrameRate(GstElement *sink);
+    void updateOrientation(GstTagList *tags);
+    void updateTextureMetas(GstGLMemory *memory);
+    void updateFrameMetas();
+    void acquireRenderBuffer();
+    void waitUpload();
+    static bool getFrameLayout(GstSample *sample, GstVideoInfo &info, guint64 &modifier);
+    void updateOverlays(gint width, gint height);
+    static void addAllocationMeta(GstQuery *query, GType api);
+    // Display of the shared upload context when there is one, of the player otherwise
+    GstGLDisplay *getGlDisplay();
+    static void reportAllocation(const gchar *where, GstQuery *query);
 
 private:
     std::string m_pipelineCommand;
     GstElement *m_pipeline;
     GstBus *m_bus;
+    EGLDisplay m_eglDisplay;
+    bool m_isGlOutput;
     GstGLDisplayEGL *m_gstDisplay;
     GstGLContext *m_glContext;
+    bool m_isDedicatedUpload;
+    std::shared_ptr<GlUploadContext> m_uploadContext;
     bool m_isPrerollDone;
-    bool m_initialized;
+    std::atomic<bool> m_initialized;
+    std::mutex m_pipelineLock;
 
     std::mutex m_bufferLock;
     GstBuffer *m_bufferLast;
     GstBuffer *m_bufferRender;
+    // Signaled once the upload of m_bufferLast is complete, destroyed with the next frame
+    EGLSyncKHR m_fenceLast;
+    // Latest frame each rendering context waited for
+    struct ContextWait
+    {
+        EGLContext context;
+        guint64 generation;
+    };
+    std::vector<ContextWait> m_contextWaits;
+    // Frames after which a context that did not wait is dropped from m_contextWaits
+    static constexpr guint64 StaleContextFrames = 300;
+    // Layout of m_bufferLast, without GL context only
+    GstVideoInfo m_infoLast;
+    guint64 m_modifierLast;
     Texture m_texture;
+    Frame m_frame;
+    // Shared by m_texture or m_frame and the renderers, released with the last of them
+    std::shared_ptr<GstBuffer> m_holdRender;
+    std::atomic<guint64> m_frameGeneration;
 
-    bool m_looping;
+    std::atomic<bool> m_looping;
+    std::atomic<guint> m_maxFrameRate;
+    bool m_isCustomPipeline;
+    bool m_isLive;
+    guint m_liveLatencyMs;
+    ReadAheadMode m_readAheadMode;
+    // Mode of the loaded source, Off unless it is a file played by readaheadsrc
+    ReadAheadMode m_sourceReadAhead;
+    std::atomic<gint64> m_latency;
+    std::string m_frameTapName;
+    std::unique_ptr<FrameTap> m_frameTap;
     gint m_width;
     gint m_height;
+    std::atomic<int> m_rotation;
+    std::atomic<bool> m_isFlipped;
+
+    bool m_isAdaptiveBitrate;
+    // Source that may have variants, the controller only runs once a demuxer offers them
+    std::atomic<bool> m_isAdaptiveAllowed;
+    AdaptiveBitrate m_adaptiveBitrate;
+    // Adaptive demuxer of the pipeline and evaluation timer, added from a streaming thread
+    std::mutex m_adaptiveLock;
+    GstElement *m_adaptiveDemux;
+    GSource *m_adaptiveSource;
+
+    struct PendingCommand
+    {
+        GstPlayerCommand type;
+        std::function<bool()> action;
+    };
+    std::mutex m_commandLock;
+    std::deque<PendingCommand> m_commands;
+    bool m_commandsScheduled;
+    bool m_workerRunning;
+    GMainContext *m_mainContext;
+    GMainLoop *m_mainLoop;
+    std::thread m_worker;
 
     static GstLib m_gst;
-    GstPlayerListener *m_listener;
+    // Held while notifying, so that removed listeners are never called
+    std::mutex m_listenerLock;
+    std::vector<GstPlayerListener *> m_listeners;
 };
\ No newline at end of file
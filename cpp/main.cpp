@@ -10,6 +10,11 @@
 #include <QQuickWindow>
 #include <QtQuick/QQuickView>
 #include <QQmlContext>
+#include <QDebug>
+#ifdef IMX_V2T_VULKAN
+#include <QQuickGraphicsConfiguration>
+#include "vktexturerenderer.hpp"
+#endif
 
 int main(int argc, char *argv[])
 {
@@ -17,10 +22,30 @@ int main(int argc, char *argv[])
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
 #endif
+    // Windows on several displays render the textures of the same players
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
     QGuiApplication app(argc, argv);
 
+    // Scene graph backend, before any window is created. OpenGL ES unless Vulkan is requested.
+    bool isVulkan = qgetenv("IMX_V2T_GRAPHICS_API") == "vulkan";
+#ifndef IMX_V2T_VULKAN
+    if (isVulkan) {
+        qWarning() << "Built without Vulkan support, using OpenGL ES";
+        isVulkan = false;
+    }
+#endif
+    QQuickWindow::setGraphicsApi(isVulkan ? QSGRendererInterface::Vulkan
+                                          : QSGRendererInterface::OpenGL);
+
     // Load QML
     QQmlApplicationEngine engine;
+    // Screen index of a full screen copy of the main view, e.g. LVDS next to HDMI
+    bool isMirrorSet = false;
+    int mirrorScreen = qEnvironmentVariableIntValue("IMX_V2T_MIRROR_SCREEN", &isMirrorSet);
+    if (isMirrorSet == false || mirrorScreen < 0 || mirrorScreen >= app.screens().size()) {
+        mirrorScreen = -1;
+    }
+    engine.rootContext()->setContextProperty("mirrorScreen", mirrorScreen);
 
     const QUrl url(QStringLiteral("qrc:/qml/main"));
     QObject::connect(
@@ -33,8 +58,18 @@ int main(int argc, char *argv[])
     engine.load(url);
 
     // QML window
-    QQuickWindow::setGraphicsApi(QSGRendererInterface::OpenGL);
     QQuickWindow *window = qobject_cast<QQuickWindow *>(engine.rootObjects().at(0));
+#ifdef IMX_V2T_VULKAN
+    // dma-buf import extensions, the scene graph is initialized when the window is exposed
+    for (QWindow *topLevel : app.topLevelWindows()) {
+        auto *quickWindow = qobject_cast<QQuickWindow *>(topLevel);
+        if (isVulkan && quickWindow != nullptr) {
+            QQuickGraphicsConfiguration config = quickWindow->graphicsConfiguration();
+            config.setDeviceExtensions(VkTextureRenderer::getDeviceExtensions());
+            quickWindow->setGraphicsConfiguration(config);
+        }
+    }
+#endif
 
     return app.exec();
 }
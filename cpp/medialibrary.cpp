@@ -0,0 +1,603 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "medialibrary.hpp"
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+/**************************************************************************************************************
+ *
+ * @brief  			MediaLibrary Class
+ *
+ * @remarks 		List model of the media files of a folder. Files are scanned recursively on a worker
+ *                  thread and probed by a small thread pool, visible files first. Probe results are
+ *                  kept in an index file and reused while the file size and mtime are unchanged.
+ *
+ **************************************************************************************************************/
+
+MediaLibrary::MediaLibrary(QObject *parent)
+    : QAbstractListModel(parent),
+      m_recursive(true),
+      m_playableOnly(true),
+      m_sortBy(SortBy::Name),
+      m_isScanning(false),
+      m_generation(0),
+      m_scanThread(nullptr),
+      m_probesInFlight(0),
+      m_isIndexChanged(false)
+{
+    // Every extension the registry typefinders associate with video
+    for (const std::string &filter : MediaProbe::getVideoNameFilters()) {
+        m_nameFilters.append(QString::fromStdString(filter));
+    }
+    m_probePool.setMaxThreadCount(ProbeThreads);
+    m_saveTimer.setSingleShot(true);
+    connect(&m_saveTimer, &QTimer::timeout, this, &MediaLibrary::saveIndex);
+    loadIndex();
+}
+
+MediaLibrary::~MediaLibrary()
+{
+    stopScan();
+    m_probeQueue.clear();
+    m_probePool.waitForDone();
+    saveIndex();
+}
+
+int MediaLibrary::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+}
+
+QVariant MediaLibrary::data(const QModelIndex &index, int role) const
+{
+    if (index.isValid() == false || index.row() >= static_cast<int>(m_rows.size())) {
+        return QVariant();
+    }
+
+    const Entry &entry = m_entries[m_rows[index.row()]];
+    switch (role) {
+    case FileNameRole:
+        return entry.name;
+    case FileUrlRole:
+        return QUrl::fromLocalFile(entry.path);
+    case FilePathRole:
+        return entry.path;
+    case FileSizeRole:
+        return entry.size;
+    case FileModifiedRole:
+        return entry.modified;
+    case DurationRole:
+        return static_cast<qint64>(entry.info.durationMs);
+    case VideoWidthRole:
+        return entry.info.width;
+    case VideoHeightRole:
+        return entry.info.height;
+    case ContainerRole:
+        return QString::fromStdString(entry.info.container);
+    case CodecRole:
+        return QString::fromStdString(entry.info.codec);
+    case KeyframeIntervalRole:
+        return static_cast<qint64>(entry.info.keyframeIntervalMs);
+    case ProbedRole:
+        return entry.isProbed;
+    case PlayableRole:
+        return entry.info.isPlayable;
+    case DecoderRole:
+        return QString::fromStdString(entry.info.decoder);
+    case SoftwareDecodeRole:
+        return entry.info.isSoftwareDecode;
+    case DecodeCostRole:
+        return entry.info.decodeCost;
+    case OverloadedRole:
+        return entry.info.isSoftwareDecode && entry.info.decodeCost > 1.0f;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> MediaLibrary::roleNames() const
+{
+    return { { FileNameRole, "fileName" },
+             { FileUrlRole, "fileUrl" },
+             { FilePathRole, "filePath" },
+             { FileSizeRole, "fileSize" },
+             { FileModifiedRole, "fileModified" },
+             { DurationRole, "duration" },
+             { VideoWidthRole, "videoWidth" },
+             { VideoHeightRole, "videoHeight" },
+             { ContainerRole, "container" },
+             { CodecRole, "codec" },
+             { KeyframeIntervalRole, "keyframeInterval" },
+             { ProbedRole, "probed" },
+             { PlayableRole, "playable" },
+             { DecoderRole, "decoder" },
+             { SoftwareDecodeRole, "softwareDecode" },
+             { DecodeCostRole, "decodeCost" },
+             { OverloadedRole, "overloaded" } };
+}
+
+QUrl MediaLibrary::getFolder()
+{
+    return m_folder;
+}
+
+void MediaLibrary::setFolder(QUrl folder)
+{
+    if (folder == m_folder) {
+        return;
+    }
+    m_folder = folder;
+    Q_EMIT folderChanged();
+    rescan();
+}
+
+QStringList MediaLibrary::getNameFilters()
+{
+    return m_nameFilters;
+}
+
+void MediaLibrary::setNameFilters(QStringList filters)
+{
+    m_nameFilters = filters;
+    rescan();
+}
+
+bool MediaLibrary::getRecursive()
+{
+    return m_recursive;
+}
+
+void MediaLibrary::setRecursive(bool recursive)
+{
+    m_recursive = recursive;
+    rescan();
+}
+
+bool MediaLibrary::getPlayableOnly()
+{
+    return m_playableOnly;
+}
+
+void MediaLibrary::setPlayableOnly(bool playableOnly)
+{
+    if (playableOnly == m_playableOnly) {
+        return;
+    }
+    m_playableOnly = playableOnly;
+    rebuildRows();
+}
+
+MediaLibrary::SortBy MediaLibrary::getSortBy()
+{
+    return m_sortBy;
+}
+
+void MediaLibrary::setSortBy(SortBy sortBy)
+{
+    if (sortBy == m_sortBy) {
+        return;
+    }
+    m_sortBy = sortBy;
+    rebuildRows();
+    Q_EMIT sortByChanged();
+}
+
+QString MediaLibrary::getFilterText()
+{
+    return m_filterText;
+}
+
+void MediaLibrary::setFilterText(QString text)
+{
+    if (text == m_filterText) {
+        return;
+    }
+    m_filterText = text;
+    rebuildRows();
+    Q_EMIT filterTextChanged();
+}
+
+bool MediaLibrary::isScanning()
+{
+    return m_isScanning;
+}
+
+void MediaLibrary::prioritize(QUrl fileUrl)
+{
+    auto it = std::find(m_probeQueue.begin(), m_probeQueue.end(), fileUrl.toLocalFile());
+    if (it == m_probeQueue.end() || it == m_probeQueue.begin()) {
+        return;
+    }
+    QString path = *it;
+    m_probeQueue.erase(it);
+    m_probeQueue.push_front(path);
+}
+
+void MediaLibrary::rescan()
+{
+    stopScan();
+    quint64 generation = ++m_generation;
+
+    beginResetModel();
+    m_entries.clear();
+    m_rows.clear();
+    m_entryByPath.clear();
+    m_rowByPath.clear();
+    m_probeQueue.clear();
+    endResetModel();
+    Q_EMIT countChanged();
+
+    QString root = m_folder.toLocalFile();
+    if (root.isEmpty()) {
+        return;
+    }
+
+    m_isScanning = true;
+    Q_EMIT scanningChanged();
+    m_scanThread = QThread::create(&MediaLibrary::scan, this, generation, root, m_nameFilters,
+                                   m_recursive);
+    m_scanThread->start(QThread::LowPriority);
+}
+
+void MediaLibrary::stopScan()
+{
+    if (m_scanThread == nullptr) {
+        return;
+    }
+    // The scan loop polls the generation
+    ++m_generation;
+    m_scanThread->wait();
+    delete m_scanThread;
+    m_scanThread = nullptr;
+}
+
+void MediaLibrary::scan(quint64 generation, QString root, QStringList filters, bool recursive)
+{
+    // Worker thread, entries are handed over to the GUI thread in batches
+    QDirIterator it(root, filters, QDir::Files | QDir::Readable,
+                    recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+    std::vector<Entry> batch;
+    while (it.hasNext() && m_generation == generation) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        Entry entry;
+        entry.path = info.absoluteFilePath();
+        entry.name = info.fileName();
+        entry.size = info.size();
+        entry.modified = info.lastModified();
+        batch.push_back(std::move(entry));
+
+        if (batch.size() >= ScanBatchSize) {
+            QMetaObject::invokeMethod(
+                    this,
+                    [this, generation, batch = std::move(batch)]() mutable {
+                        onScanBatch(generation, std::move(batch));
+                    },
+                    Qt::QueuedConnection);
+            batch = std::vector<Entry>();
+        }
+    }
+    QMetaObject::invokeMethod(
+            this,
+            [this, generation, batch = std::move(batch)]() mutable {
+                onScanBatch(generation, std::move(batch));
+                onScanDone(generation);
+            },
+            Qt::QueuedConnection);
+}
+
+void MediaLibrary::onScanBatch(quint64 generation, std::vector<Entry> batch)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    std::vector<int> added;
+    for (Entry &entry : batch) {
+        if (m_entryByPath.contains(entry.path)) {
+            continue;
+        }
+        // Indexed results are reused while the file is unchanged
+        auto indexed = m_index.constFind(entry.path);
+        if (indexed != m_index.constEnd() && indexed->size == entry.size
+            && indexed->modified == entry.modified) {
+            entry.info = indexed->info;
+            entry.isProbed = true;
+        } else {
+            m_probeQueue.push_back(entry.path);
+        }
+
+        int index = static_cast<int>(m_entries.size());
+        m_entryByPath.insert(entry.path, index);
+        m_entries.push_back(std::move(entry));
+        added.push_back(index);
+    }
+    insertRows(std::move(added));
+    Q_EMIT countChanged();
+    startProbes();
+}
+
+void MediaLibrary::onScanDone(quint64 generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+    m_isScanning = false;
+    Q_EMIT scanningChanged();
+    qInfo() << "Media library:" << m_entries.size() << "files in" << m_folder.toLocalFile() << ","
+            << m_probeQueue.size() << "to probe";
+}
+
+void MediaLibrary::startProbes()
+{
+    while (m_probesInFlight < ProbeThreads && m_probeQueue.empty() == false) {
+        QString path = m_probeQueue.front();
+        m_probeQueue.pop_front();
+        m_probesInFlight++;
+
+        quint64 generation = m_generation;
+        m_probePool.start([this, generation, path]() {
+            MediaInfo info = MediaProbe::probe(path.toStdString());
+            QMetaObject::invokeMethod(
+                    this, [this, generation, path, info]() { onProbed(generation, path, info); },
+                    Qt::QueuedConnection);
+        });
+    }
+}
+
+void MediaLibrary::onProbed(quint64 generation, QString path, MediaInfo info)
+{
+    m_probesInFlight--;
+    startProbes();
+    if (generation != m_generation) {
+        return;
+    }
+
+    auto it = m_entryByPath.constFind(path);
+    if (it == m_entryByPath.constEnd()) {
+        return;
+    }
+    Entry &entry = m_entries[*it];
+    entry.info = info;
+    entry.isProbed = true;
+    m_index.insert(path, entry);
+    m_isIndexChanged = true;
+    m_saveTimer.start(IndexSaveDelayMs);
+    updateRow(*it);
+}
+
+void MediaLibrary::rebuildRows()
+{
+    beginResetModel();
+    m_rows.clear();
+    for (int i = 0; i < static_cast<int>(m_entries.size()); i++) {
+        if (isAccepted(m_entries[i])) {
+            m_rows.push_back(i);
+        }
+    }
+    std::stable_sort(m_rows.begin(), m_rows.end(),
+                     [this](int left, int right) { return isBefore(left, right); });
+    m_rowByPath.clear();
+    indexRows(0, static_cast<int>(m_rows.size()));
+    endResetModel();
+    Q_EMIT countChanged();
+}
+
+void MediaLibrary::insertRows(std::vector<int> entries)
+{
+    auto isRejected = [this](int entry) { return isAccepted(m_entries[entry]) == false; };
+    entries.erase(std::remove_if(entries.begin(), entries.end(), isRejected), entries.end());
+    if (entries.empty()) {
+        return;
+    }
+    auto isBeforeEntry = [this](int left, int right) { return isBefore(left, right); };
+    std::stable_sort(entries.begin(), entries.end(), isBeforeEntry);
+
+    // Sorted entries going to the same position of m_rows are inserted at once, files of a
+    // folder usually are. Rows after the first insertion are indexed once for the whole batch.
+    int firstRow = static_cast<int>(m_rows.size());
+    size_t first = 0;
+    while (first < entries.size()) {
+        auto it = std::upper_bound(m_rows.begin(), m_rows.end(), entries[first], isBeforeEntry);
+        size_t last = first + 1;
+        while (last < entries.size() && (it == m_rows.end() || isBefore(entries[last], *it))) {
+            last++;
+        }
+        int row = static_cast<int>(it - m_rows.begin());
+        beginInsertRows(QModelIndex(), row, row + static_cast<int>(last - first) - 1);
+        m_rows.insert(it, entries.begin() + first, entries.begin() + last);
+        endInsertRows();
+        firstRow = std::min(firstRow, row);
+        first = last;
+    }
+    indexRows(firstRow, static_cast<int>(m_rows.size()));
+}
+
+void MediaLibrary::updateRow(int entry)
+{
+    int row = findRow(entry);
+    if (row < 0) {
+        return;
+    }
+    if (isAccepted(m_entries[entry]) == false) {
+        beginRemoveRows(QModelIndex(), row, row);
+        m_rowByPath.remove(m_entries[entry].path);
+        m_rows.erase(m_rows.begin() + row);
+        indexRows(row, static_cast<int>(m_rows.size()));
+        endRemoveRows();
+        Q_EMIT countChanged();
+        return;
+    }
+
+    // Probed values may move the row when sorting by them
+    m_rows.erase(m_rows.begin() + row);
+    auto it = std::upper_bound(m_rows.begin(), m_rows.end(), entry,
+                               [this](int left, int right) { return isBefore(left, right); });
+    int target = static_cast<int>(it - m_rows.begin());
+    if (target != row) {
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), (target > row) ? target + 1 : target);
+        m_rows.insert(it, entry);
+        // Only the rows between the old and the new position shifted
+        indexRows(std::min(row, target), std::max(row, target) + 1);
+        endMoveRows();
+    } else {
+        m_rows.insert(it, entry);
+    }
+    QModelIndex changed = index(target);
+    Q_EMIT dataChanged(changed, changed);
+}
+
+bool MediaLibrary::isAccepted(const Entry &entry) const
+{
+    // Files not probed yet are shown, they are removed once found unplayable
+    if (m_playableOnly && entry.isProbed && entry.info.isPlayable == false) {
+        return false;
+    }
+    return m_filterText.isEmpty() || entry.name.contains(m_filterText, Qt::CaseInsensitive);
+}
+
+bool MediaLibrary::isBefore(int left, int right) const
+{
+    const Entry &a = m_entries[left];
+    const Entry &b = m_entries[right];
+    switch (m_sortBy) {
+    case SortBy::Modified:
+        if (a.modified != b.modified) {
+            return a.modified > b.modified;
+        }
+        break;
+    case SortBy::Size:
+        if (a.size != b.size) {
+            return a.size > b.size;
+        }
+        break;
+    case SortBy::Duration:
+        if (a.info.durationMs != b.info.durationMs) {
+            return a.info.durationMs > b.info.durationMs;
+        }
+        break;
+    case SortBy::Resolution:
+        if (a.info.width * a.info.height != b.info.width * b.info.height) {
+            return a.info.width * a.info.height > b.info.width * b.info.height;
+        }
+        break;
+    default:
+        break;
+    }
+    return QString::localeAwareCompare(a.name, b.name) < 0;
+}
+
+int MediaLibrary::findRow(int entry) const
+{
+    return m_rowByPath.value(m_entries[entry].path, -1);
+}
+
+void MediaLibrary::indexRows(int from, int to)
+{
+    for (int row = from; row < to; row++) {
+        m_rowByPath.insert(m_entries[m_rows[row]].path, row);
+    }
+}
+
+QString MediaLibrary::getIndexPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/imx-video-to-texture/media-index.json";
+}
+
+void MediaLibrary::loadIndex()
+{
+    QFile file(getIndexPath());
+    if (file.open(QIODevice::ReadOnly) == false) {
+        return;
+    }
+
+    const QJsonObject index = QJsonDocument::fromJson(file.readAll()).object();
+    if (index["version"].toInt() != IndexVersion) {
+        return;
+    }
+    const QJsonObject files = index["files"].toObject();
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        QJsonObject record = it.value().toObject();
+        Entry entry;
+        entry.path = it.key();
+        entry.name = QFileInfo(entry.path).fileName();
+        entry.size = record["size"].toInteger();
+        entry.modified = QDateTime::fromMSecsSinceEpoch(record["mtime"].toInteger());
+        entry.info.isValid = record["valid"].toBool();
+        entry.info.durationMs = record["duration"].toInteger(-1);
+        entry.info.width = record["width"].toInt();
+        entry.info.height = record["height"].toInt();
+        entry.info.container = record["container"].toString().toStdString();
+        entry.info.codec = record["codec"].toString().toStdString();
+        entry.info.keyframeIntervalMs = record["keyframeInterval"].toInteger(-1);
+        entry.info.framerateNum = record["framerateNum"].toInt();
+        entry.info.framerateDenom = record["framerateDenom"].toInt(1);
+        entry.info.decoder = record["decoder"].toString().toStdString();
+        entry.info.isPlayable = record["playable"].toBool();
+        entry.info.isSoftwareDecode = record["softwareDecode"].toBool();
+        entry.info.decodeCost = static_cast<float>(record["decodeCost"].toDouble());
+        entry.isProbed = true;
+        m_index.insert(entry.path, entry);
+    }
+}
+
+void MediaLibrary::saveIndex()
+{
+    if (m_isIndexChanged == false) {
+        return;
+    }
+    m_saveTimer.stop();
+    m_isIndexChanged = false;
+
+    QJsonObject files;
+    for (const Entry &entry : std::as_const(m_index)) {
+        // Files removed since they were probed are dropped
+        if (QFileInfo::exists(entry.path) == false) {
+            continue;
+        }
+        QJsonObject record;
+        record["size"] = entry.size;
+        record["mtime"] = entry.modified.toMSecsSinceEpoch();
+        record["valid"] = entry.info.isValid;
+        record["duration"] = static_cast<qint64>(entry.info.durationMs);
+        record["width"] = entry.info.width;
+        record["height"] = entry.info.height;
+        record["container"] = QString::fromStdString(entry.info.container);
+        record["codec"] = QString::fromStdString(entry.info.codec);
+        record["keyframeInterval"] = static_cast<qint64>(entry.info.keyframeIntervalMs);
+        record["framerateNum"] = entry.info.framerateNum;
+        record["framerateDenom"] = entry.info.framerateDenom;
+        record["decoder"] = QString::fromStdString(entry.info.decoder);
+        record["playable"] = entry.info.isPlayable;
+        record["softwareDecode"] = entry.info.isSoftwareDecode;
+        record["decodeCost"] = entry.info.decodeCost;
+        files.insert(entry.path, record);
+    }
+
+    QString path = getIndexPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (file.open(QIODevice::WriteOnly) == false) {
+        qWarning() << "Media library: cannot write" << path;
+        return;
+    }
+    QJsonObject index;
+    index["version"] = IndexVersion;
+    index["files"] = files;
+    file.write(QJsonDocument(index).toJson(QJsonDocument::Compact));
+    file.commit();
+}
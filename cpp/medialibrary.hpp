@@ -0,0 +1,156 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QHash>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <QtQml/qqmlregistration.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include "mediaprobe.hpp"
+
+class MediaLibrary : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QUrl folder READ getFolder WRITE setFolder NOTIFY folderChanged)
+    Q_PROPERTY(QStringList nameFilters READ getNameFilters WRITE setNameFilters)
+    Q_PROPERTY(bool recursive READ getRecursive WRITE setRecursive)
+    Q_PROPERTY(bool playableOnly READ getPlayableOnly WRITE setPlayableOnly)
+    Q_PROPERTY(SortBy sortBy READ getSortBy WRITE setSortBy NOTIFY sortByChanged)
+    Q_PROPERTY(QString filterText READ getFilterText WRITE setFilterText NOTIFY filterTextChanged)
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+    Q_PROPERTY(bool scanning READ isScanning NOTIFY scanningChanged)
+    QML_ELEMENT
+
+public:
+    enum Role {
+        FileNameRole = Qt::UserRole + 1,
+        FileUrlRole,
+        FilePathRole,
+        FileSizeRole,
+        FileModifiedRole,
+        DurationRole,
+        VideoWidthRole,
+        VideoHeightRole,
+        ContainerRole,
+        CodecRole,
+        KeyframeIntervalRole,
+        ProbedRole,
+        PlayableRole,
+        DecoderRole,
+        SoftwareDecodeRole,
+        DecodeCostRole,
+        OverloadedRole
+    };
+
+    enum class SortBy { Name, Modified, Size, Duration, Resolution };
+    Q_ENUM(SortBy)
+
+    explicit MediaLibrary(QObject *parent = nullptr);
+    ~MediaLibrary();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    QUrl getFolder();
+    void setFolder(QUrl folder);
+    QStringList getNameFilters();
+    void setNameFilters(QStringList filters);
+    bool getRecursive();
+    void setRecursive(bool recursive);
+    bool getPlayableOnly();
+    // Hides files probed as having no video stream or no decoder for it
+    void setPlayableOnly(bool playableOnly);
+    SortBy getSortBy();
+    void setSortBy(SortBy sortBy);
+    QString getFilterText();
+    void setFilterText(QString text);
+    bool isScanning();
+
+    // Moves a file to the front of the probe queue, e.g. when its delegate is created
+    Q_INVOKABLE void prioritize(QUrl fileUrl);
+
+    static constexpr int ProbeThreads = 2;
+    static constexpr int ScanBatchSize = 200;
+    static constexpr int IndexSaveDelayMs = 2000;
+    // Bumped when probed fields are added, older indexes are probed again
+    static constexpr int IndexVersion = 2;
+
+Q_SIGNALS:
+    void folderChanged();
+    void sortByChanged();
+    void filterTextChanged();
+    void countChanged();
+    void scanningChanged();
+
+protected:
+    struct Entry
+    {
+        QString path;
+        QString name;
+        qint64 size = 0;
+        QDateTime modified;
+        MediaInfo info;
+        bool isProbed = false;
+    };
+
+    void rescan();
+    void stopScan();
+    void scan(quint64 generation, QString root, QStringList filters, bool recursive);
+    void onScanBatch(quint64 generation, std::vector<Entry> batch);
+    void onScanDone(quint64 generation);
+    void startProbes();
+    void onProbed(quint64 generation, QString path, MediaInfo info);
+    void rebuildRows();
+    // Inserts the rows of new entries in sort order, those not accepted are skipped
+    void insertRows(std::vector<int> entries);
+    void updateRow(int entry);
+    bool isAccepted(const Entry &entry) const;
+    bool isBefore(int left, int right) const;
+    int findRow(int entry) const;
+    // Updates m_rowByPath for the rows in [from, to), after they moved in m_rows
+    void indexRows(int from, int to);
+    void loadIndex();
+    void saveIndex();
+    static QString getIndexPath();
+
+private:
+    QUrl m_folder;
+    QStringList m_nameFilters;
+    bool m_recursive;
+    bool m_playableOnly;
+    SortBy m_sortBy;
+    QString m_filterText;
+    bool m_isScanning;
+
+    // All scanned files, and the indices of those shown, in sort order
+    std::vector<Entry> m_entries;
+    std::vector<int> m_rows;
+    QHash<QString, int> m_entryByPath;
+    // Row of each shown file, so that probe results do not search m_rows
+    QHash<QString, int> m_rowByPath;
+
+    // Bumped on each rescan, results of older scans and probes are dropped
+    std::atomic<quint64> m_generation;
+    QThread *m_scanThread;
+    QThreadPool m_probePool;
+    std::deque<QString> m_probeQueue;
+    int m_probesInFlight;
+
+    // Probe results of all folders, persisted in the cache directory
+    QHash<QString, Entry> m_index;
+    bool m_isIndexChanged;
+    QTimer m_saveTimer;
+};
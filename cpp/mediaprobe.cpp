@@ -0,0 +1,300 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "mediaprobe.hpp"
+#include <gst/pbutils/pbutils.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+struct KeyframeCount
+{
+    GstElement *sink;
+    guint frames = 0;
+    guint keyframes = 0;
+    GstClockTime firstKeyframe = GST_CLOCK_TIME_NONE;
+    GstClockTime lastKeyframe = GST_CLOCK_TIME_NONE;
+    bool done = false;
+};
+
+constexpr const gchar *KeyframesDone = "keyframes-done";
+
+// Software decode effort relative to H.264 at the same pixel rate
+struct CodecWeight
+{
+    const gchar *caps;
+    float weight;
+};
+constexpr CodecWeight CodecWeights[] = {
+    { "video/x-h265", 1.5f },
+    { "video/x-vp9", 1.5f },
+    { "video/x-av1", 2.0f },
+};
+
+void onParsedPad(GstElement *parsebin, GstPad *pad, gpointer data)
+{
+    // First video elementary stream only
+    auto *sink = static_cast<GstElement *>(data);
+    GstPad *sinkPad = gst_element_get_static_pad(sink, "sink");
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (caps == nullptr) {
+        caps = gst_pad_query_caps(pad, nullptr);
+    }
+    const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if (gst_pad_is_linked(sinkPad) == FALSE && g_str_has_prefix(name, "video/")) {
+        gst_pad_link(pad, sinkPad);
+    }
+    gst_caps_unref(caps);
+    gst_object_unref(GST_OBJECT(sinkPad));
+}
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			MediaProbe Class
+ *
+ * @remarks 		Describes a media file without decoding it: GstDiscoverer gives the duration,
+ *                  resolution and codecs, and the key frame interval is measured on parsed frames.
+ *
+ **************************************************************************************************************/
+
+MediaInfo MediaProbe::probe(const std::string &path)
+{
+    static const bool isPbUtilsReady = []() {
+        gst_pb_utils_init();
+        return true;
+    }();
+    (void)isPbUtilsReady;
+
+    MediaInfo info;
+    gchar *uri = gst_filename_to_uri(path.data(), nullptr);
+    if (uri == nullptr) {
+        return info;
+    }
+    info.isValid = discover(uri, info);
+    g_free(uri);
+    if (info.isValid && info.isPlayable == false) {
+        g_print("%s: no decoder for %s\n", path.data(), info.codec.data());
+    }
+
+    if (info.isValid && info.width > 0) {
+        info.keyframeIntervalMs = measureKeyframeInterval(path);
+    }
+    return info;
+}
+
+bool MediaProbe::discover(const std::string &uri, MediaInfo &info)
+{
+    GError *error = nullptr;
+    GstDiscoverer *discoverer = gst_discoverer_new(DiscoverTimeout, &error);
+    if (discoverer == nullptr) {
+        g_print("Cannot create discoverer: %s\n", error->message);
+        g_clear_error(&error);
+        return false;
+    }
+
+    GstDiscovererInfo *result = gst_discoverer_discover_uri(discoverer, uri.data(), &error);
+    g_clear_error(&error);
+    // Missing decoders still give the stream caps, playability is decided from them
+    GstDiscovererResult status =
+            (result != nullptr) ? gst_discoverer_info_get_result(result) : GST_DISCOVERER_ERROR;
+    bool isValid = status == GST_DISCOVERER_OK || status == GST_DISCOVERER_MISSING_PLUGINS;
+
+    if (isValid) {
+        GstClockTime duration = gst_discoverer_info_get_duration(result);
+        if (GST_CLOCK_TIME_IS_VALID(duration)) {
+            info.durationMs = GST_TIME_AS_MSECONDS(duration);
+        }
+
+        GstDiscovererStreamInfo *top = gst_discoverer_info_get_stream_info(result);
+        if (top != nullptr) {
+            if (GST_IS_DISCOVERER_CONTAINER_INFO(top)) {
+                GstCaps *caps = gst_discoverer_stream_info_get_caps(top);
+                gchar *description = gst_pb_utils_get_codec_description(caps);
+                info.container = (description != nullptr) ? description : "";
+                g_free(description);
+                gst_caps_unref(caps);
+            }
+            gst_discoverer_stream_info_unref(top);
+        }
+
+        GList *streams = gst_discoverer_info_get_video_streams(result);
+        if (streams != nullptr) {
+            auto *video = static_cast<GstDiscovererVideoInfo *>(streams->data);
+            info.width = gst_discoverer_video_info_get_width(video);
+            info.height = gst_discoverer_video_info_get_height(video);
+            info.framerateNum = gst_discoverer_video_info_get_framerate_num(video);
+            info.framerateDenom = gst_discoverer_video_info_get_framerate_denom(video);
+            GstCaps *caps = gst_discoverer_stream_info_get_caps(GST_DISCOVERER_STREAM_INFO(video));
+            gchar *description = gst_pb_utils_get_codec_description(caps);
+            info.codec = (description != nullptr) ? description : "";
+            g_free(description);
+            checkDecoder(caps, info);
+            gst_caps_unref(caps);
+        }
+        gst_discoverer_stream_info_list_free(streams);
+    }
+
+    if (result != nullptr) {
+        gst_discoverer_info_unref(result);
+    }
+    g_object_unref(discoverer);
+    return isValid;
+}
+
+void MediaProbe::checkDecoder(GstCaps *caps, MediaInfo &info)
+{
+    const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if (g_strcmp0(name, "video/x-raw") == 0) {
+        info.isPlayable = true;
+        return;
+    }
+
+    // Same candidates and order as decodebin: decoders of at least marginal rank, highest first
+    GList *decoders = gst_element_factory_list_get_elements(
+            GST_ELEMENT_FACTORY_TYPE_DECODER | GST_ELEMENT_FACTORY_TYPE_MEDIA_VIDEO,
+            GST_RANK_MARGINAL);
+    GList *candidates = gst_element_factory_list_filter(decoders, caps, GST_PAD_SINK, FALSE);
+    candidates = g_list_sort(candidates, gst_plugin_feature_rank_compare_func);
+
+    if (candidates != nullptr) {
+        auto *factory = GST_ELEMENT_FACTORY(candidates->data);
+        info.isPlayable = true;
+        info.decoder = GST_OBJECT_NAME(factory);
+        info.isSoftwareDecode = isHardwareDecoder(factory) == false;
+    }
+    gst_plugin_feature_list_free(candidates);
+    gst_plugin_feature_list_free(decoders);
+
+    if (info.isSoftwareDecode) {
+        double fps = (info.framerateNum > 0 && info.framerateDenom > 0)
+                ? static_cast<double>(info.framerateNum) / info.framerateDenom
+                : 30.0;
+        float weight = 1.0f;
+        for (const CodecWeight &codec : CodecWeights) {
+            if (g_strcmp0(name, codec.caps) == 0) {
+                weight = codec.weight;
+            }
+        }
+        info.decodeCost = static_cast<float>(static_cast<double>(info.width) * info.height * fps
+                                             * weight / SoftwareDecodePixelRate);
+    }
+}
+
+bool MediaProbe::isHardwareDecoder(GstElementFactory *factory)
+{
+    const gchar *klass = gst_element_factory_get_metadata(factory, GST_ELEMENT_METADATA_KLASS);
+    const gchar *name = GST_OBJECT_NAME(factory);
+    // Not every VPU plugin sets the Hardware class, the i.MX ones are known by name
+    return (klass != nullptr && std::strstr(klass, "Hardware") != nullptr)
+            || g_str_has_prefix(name, "v4l2") || g_str_has_prefix(name, "vpu")
+            || g_str_has_prefix(name, "imxvpu");
+}
+
+std::vector<std::string> MediaProbe::getVideoNameFilters()
+{
+    std::vector<std::string> filters;
+    GList *factories = gst_type_find_factory_get_list();
+    for (GList *it = factories; it != nullptr; it = it->next) {
+        auto *factory = GST_TYPE_FIND_FACTORY(it->data);
+        GstCaps *caps = gst_type_find_factory_get_caps(factory);
+        const gchar *const *extensions = gst_type_find_factory_get_extensions(factory);
+        if (caps == nullptr || gst_caps_is_empty(caps) || gst_caps_is_any(caps)
+            || extensions == nullptr) {
+            continue;
+        }
+        // Containers (video/quicktime, video/x-matroska, video/mpegts...) and elementary streams
+        if (g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/")) {
+            for (; *extensions != nullptr; extensions++) {
+                filters.push_back(std::string("*.") + *extensions);
+            }
+        }
+    }
+    gst_plugin_feature_list_free(factories);
+
+    std::sort(filters.begin(), filters.end());
+    filters.erase(std::unique(filters.begin(), filters.end()), filters.end());
+    return filters;
+}
+
+gint64 MediaProbe::measureKeyframeInterval(const std::string &path)
+{
+    // filesrc ! parsebin ! fakesink, first video stream, nothing is decoded
+    GstElement *pipeline = gst_pipeline_new("keyframe-probe");
+    GstElement *source = gst_element_factory_make("filesrc", nullptr);
+    GstElement *parsebin = gst_element_factory_make("parsebin", nullptr);
+    GstElement *sink = gst_element_factory_make("fakesink", nullptr);
+    if (source == nullptr || parsebin == nullptr || sink == nullptr) {
+        for (GstElement *element : { source, parsebin, sink }) {
+            if (element != nullptr) {
+                gst_object_unref(GST_OBJECT(element));
+            }
+        }
+        gst_object_unref(GST_OBJECT(pipeline));
+        return -1;
+    }
+    g_object_set(source, "location", path.data(), nullptr);
+    g_object_set(sink, "sync", FALSE, nullptr);
+    gst_bin_add_many(GST_BIN(pipeline), source, parsebin, sink, nullptr);
+    gst_element_link(source, parsebin);
+    g_signal_connect(parsebin, "pad-added", G_CALLBACK(onParsedPad), sink);
+
+    KeyframeCount count;
+    count.sink = sink;
+    GstPad *sinkPad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(sinkPad, GST_PAD_PROBE_TYPE_BUFFER, MediaProbe::onKeyframeBuffer, &count,
+                      nullptr);
+    gst_object_unref(GST_OBJECT(sinkPad));
+
+    gint64 interval = -1;
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE) {
+        GstBus *bus = gst_element_get_bus(pipeline);
+        GstMessage *msg = gst_bus_timed_pop_filtered(
+                bus, KeyframeTimeout,
+                (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_APPLICATION));
+        if (msg != nullptr) {
+            gst_message_unref(msg);
+        }
+        gst_object_unref(GST_OBJECT(bus));
+    }
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+
+    // Pipeline is stopped, the streaming thread no longer touches count
+    if (count.keyframes >= 2) {
+        interval = GST_TIME_AS_MSECONDS(count.lastKeyframe - count.firstKeyframe)
+                / (count.keyframes - 1);
+    }
+    gst_object_unref(GST_OBJECT(pipeline));
+    return interval;
+}
+
+GstPadProbeReturn MediaProbe::onKeyframeBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    auto *count = static_cast<KeyframeCount *>(data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (count->done) {
+        return GST_PAD_PROBE_DROP;
+    }
+
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT) == FALSE
+        && GST_CLOCK_TIME_IS_VALID(pts)) {
+        if (count->keyframes == 0) {
+            count->firstKeyframe = pts;
+        }
+        count->lastKeyframe = pts;
+        count->keyframes++;
+    }
+
+    if (++count->frames >= KeyframeSampleFrames) {
+        count->done = true;
+        gst_element_post_message(
+                count->sink,
+                gst_message_new_application(GST_OBJECT(count->sink),
+                                            gst_structure_new_empty(KeyframesDone)));
+    }
+    return GST_PAD_PROBE_OK;
+}
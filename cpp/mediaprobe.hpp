@@ -0,0 +1,55 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+#include <string>
+#include <vector>
+
+struct MediaInfo
+{
+    bool isValid = false;
+    gint64 durationMs = -1;
+    gint width = 0;
+    gint height = 0;
+    std::string container;
+    std::string codec;
+    // Average distance between key frames at the start of the stream, -1 when unknown
+    gint64 keyframeIntervalMs = -1;
+    gint framerateNum = 0;
+    gint framerateDenom = 1;
+    // Highest ranked decoder accepting the video caps, as decodebin would pick it
+    std::string decoder;
+    bool isPlayable = false;
+    bool isSoftwareDecode = false;
+    // Software decode load, 1 is what the CPU is expected to sustain in real time
+    float decodeCost = 0.0f;
+};
+
+class MediaProbe
+{
+public:
+    // Blocking, called from the library probe threads
+    static MediaInfo probe(const std::string &path);
+    // Extensions of the container and elementary video formats known to the registry typefinders,
+    // as name filters ("*.mkv")
+    static std::vector<std::string> getVideoNameFilters();
+
+    static constexpr GstClockTime DiscoverTimeout = 5 * GST_SECOND;
+    static constexpr GstClockTime KeyframeTimeout = 3 * GST_SECOND;
+    // Encoded frames parsed to estimate the key frame interval, nothing is decoded
+    static constexpr guint KeyframeSampleFrames = 300;
+    // Pixels per second a software decoder is expected to sustain, 1080p at 30 fps
+    static constexpr double SoftwareDecodePixelRate = 1920.0 * 1080.0 * 30.0;
+
+protected:
+    static bool discover(const std::string &uri, MediaInfo &info);
+    static void checkDecoder(GstCaps *caps, MediaInfo &info);
+    static bool isHardwareDecoder(GstElementFactory *factory);
+    static gint64 measureKeyframeInterval(const std::string &path);
+    static GstPadProbeReturn onKeyframeBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+};
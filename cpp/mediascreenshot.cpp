@@ -5,7 +5,8 @@
  */
 
 #include "mediascreenshot.hpp"
-#include "gltexturerenderer.hpp"
+#include "videorendernode.hpp"
+#include "powerpolicy.hpp"
 #include <QImage>
 
 /**************************************************************************************************************
@@ -36,10 +37,15 @@ void MediaScreenshot::handleWindowChanged(QQuickWindow *window)
 void MediaScreenshot::take()
 {
     m_state = State::PENDING;
+    // Deferred until applyPowerPolicy() allows decoding again
+    if (PowerPolicy::instance().isThumbnailDecodeAllowed() == false) {
+        return;
+    }
     if (m_isInitialized) {
         if (m_isReadyToRender == true) {
             if (m_positionPercent > 0.0f) {
-                m_player->seekToPercent(m_positionPercent);
+                m_player->seekToPercent(m_positionPercent,
+                                        PowerPolicy::instance().isKeyFramePreview());
             }
             m_player->play();
             m_state = State::START;
@@ -55,15 +61,24 @@ void MediaScreenshot::onNewFrame()
     }
 }
 
-void MediaScreenshot::onPrerollDone()
+void MediaScreenshot::handlePrerollDone()
 {
-    MediaStream::onPrerollDone(); // set m_isReadyToRender to true
+    MediaStream::handlePrerollDone(); // set m_isReadyToRender to true
 
     if (m_state == State::PENDING) {
         take();
     }
 }
 
+void MediaScreenshot::applyPowerPolicy()
+{
+    MediaStream::applyPowerPolicy();
+
+    if (m_state == State::PENDING && PowerPolicy::instance().isThumbnailDecodeAllowed()) {
+        take();
+    }
+}
+
 void MediaScreenshot::paint()
 {
     if (m_state != State::DONE) {
@@ -74,8 +89,7 @@ void MediaScreenshot::paint()
 void MediaScreenshot::postRendering()
 {
     if (m_state == State::RENDER && m_renderer->isFirstRenderDone()) {
-        m_renderer->setTexture(m_renderer->getOffscreenTexture());
-        m_renderer->setOffscreen(false);
+        m_renderer->holdFrame();
         m_state = State::DONE;
         m_player->pause();
         m_player->deinit();
@@ -84,6 +98,46 @@ void MediaScreenshot::postRendering()
     }
 }
 
+void MediaScreenshot::onHidden()
+{
+    // A screenshot in progress decodes a single frame, let it finish
+    if (m_releaseDelay >= 0) {
+        m_releaseTimer.start(m_releaseDelay);
+    }
+}
+
+void MediaScreenshot::onShown()
+{
+    m_releaseTimer.stop();
+    if (m_isHibernated == true) {
+        rehydrate();
+    }
+}
+
+void MediaScreenshot::hibernate()
+{
+    MediaStream::hibernate();
+    // Screenshots not done yet start over once visible again
+    if (m_isHibernated == true && m_state != State::DONE) {
+        m_state = State::PENDING;
+    }
+}
+
+void MediaScreenshot::rehydrate()
+{
+    if (m_state == State::DONE) {
+        // Shown from the CPU copy, no need to decode again
+        m_isHibernated = false;
+        m_isSnapshotPending = (m_snapshot.isNull() == false);
+        update();
+    } else {
+        // handlePrerollDone() takes the screenshot, at its own position
+        m_isHibernated = false;
+        m_resumePosition = -1.0f;
+        loadSource();
+    }
+}
+
 void MediaScreenshot::init()
 {
     MediaStream::init();
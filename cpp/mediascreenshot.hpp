@@ -8,8 +8,6 @@
 
 #include "mediastream.hpp"
 
-class GlTextureRenderer;
-
 class MediaScreenshot : public MediaStream
 {
     Q_OBJECT
@@ -22,7 +20,6 @@ public:
 
     // Inherited from GstPlayerListener
     virtual void onNewFrame() override;
-    virtual void onPrerollDone() override;
 
 Q_SIGNALS:
     void loadedChanged();
@@ -37,9 +34,16 @@ protected:
     void take();
     void postRendering();
     virtual void init();
+    virtual void onHidden() override;
+    virtual void onShown() override;
+    virtual void hibernate() override;
+    virtual void rehydrate() override;
+    virtual bool usesSharedPlayer() override { return false; }
 
 protected Q_SLOTS:
     virtual void handleWindowChanged(QQuickWindow *win) override;
+    virtual void handlePrerollDone() override;
+    virtual void applyPowerPolicy() override;
 
 protected:
     enum class State { WAITING, PENDING, START, RENDER, DONE };
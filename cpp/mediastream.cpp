@@ -7,9 +7,18 @@
 
 #include "mediastream.hpp"
 #include "gltexturerenderer.hpp"
+#include "playerregistry.hpp"
+#include "powerpolicy.hpp"
+#ifdef IMX_V2T_VULKAN
+#include "vktexturerenderer.hpp"
+#endif
+#include <QPointer>
 #include <QRunnable>
 #include <QOpenGLContext>
 #include <QDebug>
+#include <QDir>
+#include <QImage>
+#include <QThreadPool>
 
 /**************************************************************************************************************
  *
@@ -17,7 +26,8 @@
  *
  * @remarks 		QQuickItem that manages the Media viewport for the application.
  *                  Members: 
- *                      GlTextureRenderer *m_renderer : Responsible for rendering the frame
+ *                      VideoRenderNode *m_renderer : Responsible for rendering the frame, with
+ *                                                    OpenGL or Vulkan
  *                      GstPlayer *m_player : Responsible for controlling gstreamer playback pipeline 
  *
  **************************************************************************************************************/
@@ -25,16 +35,43 @@
 MediaStream::MediaStream()
     : m_renderer(nullptr),
       m_player(nullptr),
+      m_renderPlayer(nullptr),
+      m_eglDisplay(EGL_NO_DISPLAY),
+      m_eglContext(EGL_NO_CONTEXT),
+      m_shared(false),
       m_isInitialized(false),
       m_isReadyToRender(false),
       m_playerHasFrame(false),
       m_autostart(true),
       m_looping(false),
+      m_live(false),
+      m_latency(-1.0f),
       m_source(""),
+      m_pipeline(""),
+      m_dedicatedUpload(false),
+      m_adaptiveBitrate(true),
+      m_readAhead(false),
+      m_paintTime(-1),
       m_streamPositionPercentage(0.0f),
       m_width(-1),
       m_height(-1),
-      m_ratio(1.0f)
+      m_ratio(1.0f),
+      m_exportWidth(0),
+      m_exportHeight(0),
+      m_isExportChanged(false),
+      m_isFiltersChanged(false),
+      m_crop(0.0, 0.0, 1.0, 1.0),
+      m_videoRotation(0),
+      m_letterbox(false),
+      m_isViewportChanged(false),
+      m_isExportPending(false),
+      m_isUpdatePending(false),
+      m_renderedGeneration(0),
+      m_isOnScreen(true),
+      m_isHibernated(false),
+      m_isSnapshotPending(false),
+      m_releaseDelay(DefaultReleaseDelayMs),
+      m_resumePosition(-1.0f)
 {
     if (m_autostart) {
         m_playing = true;
@@ -43,6 +80,11 @@ MediaStream::MediaStream()
     connect(this, &QQuickItem::windowChanged, this, &MediaStream::handleWindowChanged);
     connect(this, &MediaStream::newFrame, this, &MediaStream::update);
     connect(this, &MediaStream::newFrame, this, &MediaStream::updateStreamPositionPercentage);
+    connect(&PowerPolicy::instance(), &PowerPolicy::levelChanged, this,
+            &MediaStream::applyPowerPolicy);
+    connect(this, &QQuickItem::visibleChanged, this, &MediaStream::updateVisibility);
+    m_releaseTimer.setSingleShot(true);
+    connect(&m_releaseTimer, &QTimer::timeout, this, &MediaStream::hibernate);
     setFlag(QQuickItem::ItemHasContents, true);
 }
 
@@ -55,6 +97,9 @@ void MediaStream::handleWindowChanged(QQuickWindow *window)
                 Qt::DirectConnection);
         // Use Qt::DirectConnection to ensure that callbacks are called in rendering thread, within
         // OpenGL context.
+
+        // Viewport intersection changes with scrolling, checked once per frame in the GUI thread
+        connect(window, &QQuickWindow::afterAnimating, this, &MediaStream::updateVisibility);
     }
 }
 
@@ -63,29 +108,230 @@ QSGNode *MediaStream::updatePaintNode(QSGNode *node, UpdatePaintNodeData *)
     if (m_isInitialized == false) {
         init();
     }
+    if (m_renderer == nullptr) {
+        return nullptr;
+    }
+    // A shared player may be replaced by another source, the previous one is kept alive until the
+    // rendering thread is done with it
+    m_renderPlayer = m_player;
+    m_sharedRenderPlayer = m_sharedPlayer;
     m_renderer->setSize(width(), height());
+    if (m_isExportChanged == true) {
+        m_renderer->setFrameExport(m_exportCallback, m_exportWidth, m_exportHeight);
+        m_isExportChanged = false;
+    }
+    if (m_isFiltersChanged == true) {
+        m_renderer->setFilters(m_filterList);
+        m_isFiltersChanged = false;
+    }
+    if (m_isViewportChanged == true) {
+        m_renderer->setViewport(m_crop, m_videoRotation, m_letterbox);
+        m_isViewportChanged = false;
+    }
+    if (m_isSnapshotPending == true) {
+        // Last frame shown before release, until the reloaded pipeline delivers a new one
+        m_renderer->setImage(m_snapshot);
+        m_isSnapshotPending = false;
+    }
     return m_renderer;
 }
 
 void MediaStream::paint()
 {
-    if (m_isInitialized == true && m_playerHasFrame == true) {
-        GstPlayer::Texture texture = m_player->getTexture();
-        m_renderer->setTexture(texture.id, texture.target);
+    // The node may not be rendered (clipped, hidden, no new frame): exports are delivered from here
+    // too, and the window keeps updating until the last ones are read back
+    if (m_renderer != nullptr && m_renderer->collectFrameExports()) {
+        QMetaObject::invokeMethod(
+                this,
+                [this]() {
+                    if (window() != nullptr) {
+                        window()->update();
+                    }
+                },
+                Qt::QueuedConnection);
+    }
+
+    if (m_isInitialized == true && m_playerHasFrame == true && m_renderPlayer != nullptr) {
+        // Called for every frame of the window: only pick up genuinely new video frames
+        if (m_renderPlayer->getFrameGeneration() == m_renderedGeneration) {
+            return;
+        }
+        // Frames arriving from now on need another update
+        m_isUpdatePending = false;
+        QElapsedTimer timer;
+        timer.start();
+        m_renderedGeneration = m_renderer->updateFrame(m_renderPlayer);
+        m_paintTime = timer.nsecsElapsed();
+
+        if (m_isExportPending.exchange(false)) {
+            m_renderer->requestFrameExport();
+        }
+    }
+}
+
+void MediaStream::reportRenderTime()
+{
+    // Only this item's work on its new frame: other items of the window report to their players.
+    // Frames that cannot be rendered in time make the player pick lighter variants.
+    if (m_renderPlayer != nullptr && m_paintTime >= 0) {
+        m_renderPlayer->reportRenderTime(m_paintTime + m_renderer->getRenderTime());
     }
+    m_paintTime = -1;
 }
 
 void MediaStream::cleanup()
 {
     // QSGRenderNode m_renderer resource is managed by the scene graph.
-    // So it is not released here.
-    if (m_player) {
+    // So it is not released here, only forgotten: render jobs scheduled earlier must not use it.
+    m_renderer = nullptr;
+    if (m_sharedPlayer != nullptr) {
+        detachSharedPlayer();
+    } else if (m_player) {
         delete m_player;
-        m_player = nullptr;
     }
+    m_player = nullptr;
+    m_renderPlayer = nullptr;
+    m_sharedRenderPlayer.reset();
+    m_renderedGeneration = 0;
     m_isInitialized = false;
 }
 
+bool MediaStream::isOnScreen()
+{
+    return m_isOnScreen;
+}
+
+int MediaStream::getReleaseDelay()
+{
+    return m_releaseDelay;
+}
+
+void MediaStream::setReleaseDelay(int delayMs)
+{
+    m_releaseDelay = delayMs;
+}
+
+bool MediaStream::computeOnScreen()
+{
+    if (isVisible() == false || window() == nullptr || width() <= 0 || height() <= 0) {
+        return false;
+    }
+
+    // Intersection with the window and with every clipping ancestor, e.g. a GridView
+    QRectF visible(QPointF(0, 0), window()->size());
+    for (QQuickItem *item = parentItem(); item != nullptr; item = item->parentItem()) {
+        if (item->clip()) {
+            visible &= item->mapRectToScene(item->boundingRect());
+        }
+    }
+    return mapRectToScene(boundingRect()).intersects(visible);
+}
+
+void MediaStream::updateVisibility()
+{
+    bool isOnScreen = computeOnScreen();
+    if (isOnScreen == m_isOnScreen) {
+        return;
+    }
+    m_isOnScreen = isOnScreen;
+    Q_EMIT onScreenChanged();
+
+    if (m_isOnScreen) {
+        onShown();
+    } else {
+        onHidden();
+    }
+}
+
+void MediaStream::onHidden()
+{
+    // Other items may still show a shared player
+    if (usesSharedPlayer()) {
+        return;
+    }
+    // Stop decoding right away, release everything if still hidden after the delay
+    if (m_isInitialized == true && m_isHibernated == false && m_playing) {
+        m_player->pause();
+    }
+    if (m_releaseDelay >= 0) {
+        m_releaseTimer.start(m_releaseDelay);
+    }
+}
+
+void MediaStream::onShown()
+{
+    if (usesSharedPlayer()) {
+        return;
+    }
+    m_releaseTimer.stop();
+    if (m_isHibernated == true) {
+        rehydrate();
+    } else if (m_isInitialized == true && m_playing) {
+        m_player->play();
+    }
+}
+
+void MediaStream::hibernate()
+{
+    if (m_isInitialized == false || m_isHibernated == true || window() == nullptr) {
+        return;
+    }
+    m_isHibernated = true;
+    m_playerHasFrame = false;
+    m_isUpdatePending = false;
+    m_isReadyToRender = false;
+
+    // Keep a CPU copy of the last frame and release the GL resources in the rendering thread,
+    // then release the pipeline once the copy no longer needs its buffers.
+    // The job runs while the GUI thread is blocked for synchronization, so the item cannot go
+    // away meanwhile. Its node can: it is looked up when the job runs rather than captured.
+    QPointer<MediaStream> self(this);
+    window()->scheduleRenderJob(QRunnable::create([self]() {
+                                    if (self.isNull() || self->m_renderer == nullptr) {
+                                        return;
+                                    }
+                                    VideoRenderNode *renderer = self->m_renderer;
+                                    QImage image = renderer->grabImage();
+                                    renderer->releaseFrameResources();
+                                    QMetaObject::invokeMethod(
+                                            self.data(),
+                                            [self, image]() {
+                                                if (self && self->m_isHibernated) {
+                                                    self->m_snapshot = image;
+                                                    self->m_resumePosition =
+                                                            self->m_streamPositionPercentage;
+                                                    self->m_player->deinit();
+                                                }
+                                            },
+                                            Qt::QueuedConnection);
+                                }),
+                                QQuickWindow::BeforeSynchronizingStage);
+    window()->update();
+}
+
+void MediaStream::rehydrate()
+{
+    m_isHibernated = false;
+    if (m_snapshot.isNull() == false) {
+        m_isSnapshotPending = true;
+        update();
+    }
+
+    loadSource();
+    if (m_playing) {
+        m_player->play();
+    }
+}
+
+void MediaStream::applyPowerPolicy()
+{
+    // Fewer frames rendered when the board is hot or the battery low, paused streams are not
+    // redrawn anyway.
+    if (m_player != nullptr) {
+        m_player->setMaxFrameRate(PowerPolicy::instance().getMaxFrameRate());
+    }
+}
+
 QString MediaStream::getSource()
 {
     return m_source;
@@ -94,8 +340,28 @@ QString MediaStream::getSource()
 void MediaStream::setSource(QString source)
 {
     m_source = source;
+    Q_EMIT sourceChanged();
     if (m_isInitialized == true) {
-        m_player->setVideo(m_source.toStdString());
+        loadSource();
+
+        if (m_autostart) {
+            m_player->play();
+        }
+    }
+}
+
+QString MediaStream::getPipeline()
+{
+    return m_pipeline;
+}
+
+void MediaStream::setPipeline(QString pipeline)
+{
+    // A custom pipeline takes precedence over source
+    m_pipeline = pipeline;
+    Q_EMIT pipelineChanged();
+    if (m_isInitialized == true) {
+        loadSource();
 
         if (m_autostart) {
             m_player->play();
@@ -122,59 +388,239 @@ void MediaStream::play()
 
 void MediaStream::onNewFrame()
 {
-    Q_EMIT newFrame();
+    m_isExportPending = true;
     m_playerHasFrame = true;
+    // One update request until the scene graph picks the frame up, frames arriving in the
+    // meantime are rendered by the same update.
+    if (m_isUpdatePending.exchange(true) == false) {
+        Q_EMIT newFrame();
+    }
     updateRatio();
 }
 
 void MediaStream::onPrerollDone()
 {
+    // Called from the player worker thread: handle preroll in the GUI thread
+    QMetaObject::invokeMethod(this, &MediaStream::handlePrerollDone, Qt::QueuedConnection);
+}
+
+void MediaStream::handlePrerollDone()
+{
+    if (m_isInitialized == false) {
+        return;
+    }
     m_isReadyToRender = true;
-    if (!m_playing) {
+    // Shared players keep playing for the other items showing the source
+    if ((!m_playing || m_isOnScreen == false) && usesSharedPlayer() == false) {
         m_player->pause();
     }
+    // Back to where the stream was before it was released
+    if (m_resumePosition > 0.0f) {
+        m_player->seekToPercent(m_resumePosition);
+        m_resumePosition = -1.0f;
+    }
+}
+
+void MediaStream::onCommandDone(GstPlayerCommand command, bool success)
+{
+    // Called from the player worker thread: handle completion in the GUI thread
+    QMetaObject::invokeMethod(
+            this,
+            [this, command, success]() {
+                switch (command) {
+                case GstPlayerCommand::Load:
+                    if (success == false) {
+                        qWarning() << "Failed to load" << m_source;
+                    }
+                    Q_EMIT sourceLoaded(success);
+                    break;
+                case GstPlayerCommand::Seek:
+                    if (m_isInitialized == true) {
+                        m_streamPositionPercentage = m_player->getPercentage();
+                        Q_EMIT positionChanged();
+                    }
+                    break;
+                default:
+                    break;
+                }
+            },
+            Qt::QueuedConnection);
 }
 
 void MediaStream::init()
 {
     if (m_isInitialized == false) {
-        m_renderer = new GlTextureRenderer();
-        m_renderer->init();
-
-        auto glContext = static_cast<QOpenGLContext *>(window()->rendererInterface()->getResource(
-                window(), QSGRendererInterface::OpenGLContextResource));
-        auto eglContext = glContext->nativeInterface<QNativeInterface::QEGLContext>();
-        m_player = new GstPlayer(eglContext->display(), eglContext->nativeContext());
-
-        m_player->setListener(this);
+        QSGRendererInterface *rif = window()->rendererInterface();
+        bool isVulkan = (rif->graphicsApi() == QSGRendererInterface::Vulkan);
+#ifdef IMX_V2T_VULKAN
+        if (isVulkan) {
+            // Frames are imported as dma-bufs or copied by the renderer, no GL upload
+            m_renderer = new VkTextureRenderer(window());
+            m_eglDisplay = EGL_NO_DISPLAY;
+            m_eglContext = EGL_NO_CONTEXT;
+        }
+#else
+        if (isVulkan) {
+            qWarning() << "Vulkan rendering is not supported by this build";
+            return;
+        }
+#endif
+        if (isVulkan == false) {
+            auto *renderer = new GlTextureRenderer();
+            renderer->init();
+            m_renderer = renderer;
+
+            auto glContext = static_cast<QOpenGLContext *>(
+                    rif->getResource(window(), QSGRendererInterface::OpenGLContextResource));
+            auto eglContext = glContext->nativeInterface<QNativeInterface::QEGLContext>();
+            m_eglDisplay = eglContext->display();
+            m_eglContext = eglContext->nativeContext();
+
+            // Shared players wrap the global share context instead, which outlives the windows:
+            // the same player then serves the items of every window, on every display
+            QOpenGLContext *shareContext = QOpenGLContext::globalShareContext();
+            if (usesSharedPlayer() && shareContext != nullptr
+                && QOpenGLContext::areSharing(glContext, shareContext)) {
+                m_eglContext = shareContext->nativeInterface<QNativeInterface::QEGLContext>()
+                                       ->nativeContext();
+            }
+        }
 
-        if (m_source != "") {
-            m_player->setVideo(m_source.toStdString());
-        } else {
-            m_player->setVideoTestPattern();
+        // Shared players are acquired by loadSource()
+        if (usesSharedPlayer() == false) {
+            m_player = new GstPlayer(m_eglDisplay, m_eglContext);
+            m_player->setListener(this);
+            configurePlayer();
         }
 
+        loadSource();
+
         if (m_autostart) {
             m_player->play();
         }
 
         m_isInitialized = true;
 
-        connect(window(), &QQuickWindow::beforeRenderPassRecording, this, &MediaStream::paint,
+        // Vulkan frames are copied or transitioned in QSGRenderNode::prepare(), before the render
+        // pass: they must be picked up before it.
+        if (isVulkan) {
+            connect(window(), &QQuickWindow::beforeRendering, this, &MediaStream::paint,
+                    Qt::DirectConnection);
+        } else {
+            connect(window(), &QQuickWindow::beforeRenderPassRecording, this,
+                    &MediaStream::paint, Qt::DirectConnection);
+        }
+        connect(window(), &QQuickWindow::afterRendering, this, &MediaStream::reportRenderTime,
                 Qt::DirectConnection);
     }
 }
 
+void MediaStream::configurePlayer()
+{
+    m_player->setFrameTap(m_frameTap.toStdString());
+    m_player->setDedicatedUpload(m_dedicatedUpload);
+    m_player->setAdaptiveBitrate(m_adaptiveBitrate);
+    // Never Mmap: the removable storage it is meant for would crash the application on removal
+    m_player->setReadAhead(m_readAhead ? ReadAheadMode::Read : ReadAheadMode::Off);
+    m_player->setMaxFrameRate(PowerPolicy::instance().getMaxFrameRate());
+}
+
+void MediaStream::loadSource()
+{
+    // Already loaded when another item decodes the same source
+    if (usesSharedPlayer() && attachSharedPlayer() == false) {
+        return;
+    }
+
+    if (m_pipeline != "") {
+        m_player->setPipeline(m_pipeline.toStdString());
+    } else if (m_source == "") {
+        m_player->setVideoTestPattern();
+    } else if (m_live) {
+        m_player->setLiveSource(m_source.toStdString());
+    } else {
+        m_player->setVideo(m_source.toStdString());
+    }
+}
+
+std::string MediaStream::getSourceKey()
+{
+    if (m_pipeline != "") {
+        return "pipeline:" + m_pipeline.toStdString();
+    } else if (m_source == "") {
+        return "testpattern:";
+    } else if (m_live) {
+        return "live:" + m_source.toStdString();
+    }
+    return "file:" + m_source.toStdString();
+}
+
+bool MediaStream::attachSharedPlayer()
+{
+    bool isCreated = false;
+    std::shared_ptr<GstPlayer> player =
+            PlayerRegistry::acquire(getSourceKey(), m_eglDisplay, m_eglContext, isCreated);
+    if (player == m_sharedPlayer) {
+        // Same source again, reloading would restart it for the other items
+        return false;
+    }
+
+    detachSharedPlayer();
+    m_sharedPlayer = player;
+    m_player = player.get();
+    m_player->addListener(this);
+    m_renderedGeneration = 0;
+    m_playerHasFrame = false;
+    m_isUpdatePending = false;
+    if (isCreated) {
+        configurePlayer();
+        return true;
+    }
+
+    // Catch up with the player: its preroll and first frame may be long done
+    if (m_player->isPrerollDone()) {
+        QMetaObject::invokeMethod(this, &MediaStream::handlePrerollDone, Qt::QueuedConnection);
+    }
+    if (m_player->getFrameGeneration() != 0) {
+        m_playerHasFrame = true;
+        updateRatio();
+        update();
+    }
+    return false;
+}
+
+void MediaStream::detachSharedPlayer()
+{
+    if (m_sharedPlayer == nullptr) {
+        return;
+    }
+    // Not notified anymore once removed, the player is released with its last item
+    m_sharedPlayer->removeListener(this);
+    m_sharedPlayer.reset();
+    m_player = nullptr;
+}
+
 void MediaStream::updateRatio()
 {
     if (m_player != nullptr) {
         int width = m_player->getWidth();
         int height = m_player->getHeight();
 
-        if ((width != -1 && m_width != width) || (height != -1 && m_height != height)) {
-            m_width = width;
-            m_height = height;
-            m_ratio = (float)m_width / (float)m_height;
+        if (width <= 0 || height <= 0) {
+            return;
+        }
+        m_width = width;
+        m_height = height;
+
+        // Aspect ratio of what is shown, after cropping and rotation
+        float visibleWidth = m_width * m_crop.width();
+        float visibleHeight = m_height * m_crop.height();
+        if ((m_player->getRotation() + m_videoRotation) % 180 != 0) {
+            std::swap(visibleWidth, visibleHeight);
+        }
+        float ratio = (visibleHeight > 0.0f) ? visibleWidth / visibleHeight : 1.0f;
+        if (qFuzzyCompare(ratio, m_ratio) == false) {
+            m_ratio = ratio;
             Q_EMIT ratioChanged();
         }
     }
@@ -192,9 +638,15 @@ void MediaStream::skip(int n_sec)
 void MediaStream::updateStreamPositionPercentage()
 {
     m_streamPositionPercentage = m_player->getPercentage();
+    if (m_live) {
+        gint64 latency = m_player->getLatency();
+        m_latency = (latency < 0) ? -1.0f : (float)latency / (float)GST_MSECOND;
+        Q_EMIT latencyChanged();
+    }
     // If stream is paused make sure the state of the player is changed (allows progress bar and
-    // frame to update when stream is paused by user)
-    if (!m_playing) {
+    // frame to update when stream is paused by user). Shared players follow the item controlling
+    // them.
+    if (!m_playing && usesSharedPlayer() == false) {
         m_player->pause();
     }
     Q_EMIT positionChanged();
@@ -255,6 +707,190 @@ float MediaStream::getRatio()
     return m_ratio;
 }
 
+bool MediaStream::getLive()
+{
+    return m_live;
+}
+
+void MediaStream::setLive(bool live)
+{
+    if (m_live != live) {
+        m_live = live;
+        // Rebuild the pipeline with the live source settings
+        if (m_isInitialized == true && m_source != "") {
+            loadSource();
+            if (m_playing) {
+                m_player->play();
+            }
+        }
+        Q_EMIT liveChanged();
+    }
+}
+
+float MediaStream::getLatency()
+{
+    return m_latency;
+}
+
+QString MediaStream::getFrameTap()
+{
+    return m_frameTap;
+}
+
+void MediaStream::setFrameTap(QString name)
+{
+    // Applied when the next source is loaded
+    m_frameTap = name;
+    if (m_isInitialized == true) {
+        m_player->setFrameTap(m_frameTap.toStdString());
+    }
+}
+
+bool MediaStream::getDedicatedUpload()
+{
+    return m_dedicatedUpload;
+}
+
+void MediaStream::setDedicatedUpload(bool enabled)
+{
+    // Applied when the next source is loaded
+    m_dedicatedUpload = enabled;
+    if (m_isInitialized == true) {
+        m_player->setDedicatedUpload(m_dedicatedUpload);
+    }
+}
+
+bool MediaStream::getAdaptiveBitrate()
+{
+    return m_adaptiveBitrate;
+}
+
+void MediaStream::setAdaptiveBitrate(bool enabled)
+{
+    // Applied when the next source is loaded
+    m_adaptiveBitrate = enabled;
+    if (m_isInitialized == true) {
+        m_player->setAdaptiveBitrate(m_adaptiveBitrate);
+    }
+}
+
+bool MediaStream::getReadAhead()
+{
+    return m_readAhead;
+}
+
+void MediaStream::setReadAhead(bool enabled)
+{
+    // Applied when the next source is loaded
+    m_readAhead = enabled;
+    if (m_isInitialized == true) {
+        m_player->setReadAhead(m_readAhead ? ReadAheadMode::Read : ReadAheadMode::Off);
+    }
+}
+
+QString MediaStream::getFilters()
+{
+    return m_filters;
+}
+
+void MediaStream::setFilters(QString filters)
+{
+    // Parsed here, handed over to the renderer in updatePaintNode()
+    m_filters = filters;
+    m_filterList = GlFilterChain::parse(filters);
+    m_isFiltersChanged = true;
+    update();
+}
+
+QRectF MediaStream::getCrop()
+{
+    return m_crop;
+}
+
+void MediaStream::setCrop(QRectF crop)
+{
+    m_crop = crop.intersected(QRectF(0.0, 0.0, 1.0, 1.0));
+    m_isViewportChanged = true;
+    updateRatio();
+    update();
+}
+
+int MediaStream::getVideoRotation()
+{
+    return m_videoRotation;
+}
+
+void MediaStream::setVideoRotation(int degrees)
+{
+    // Only quarter turns
+    m_videoRotation = ((qRound(degrees / 90.0) * 90) % 360 + 360) % 360;
+    m_isViewportChanged = true;
+    updateRatio();
+    update();
+}
+
+bool MediaStream::getLetterbox()
+{
+    return m_letterbox;
+}
+
+void MediaStream::setLetterbox(bool letterbox)
+{
+    m_letterbox = letterbox;
+    m_isViewportChanged = true;
+    update();
+}
+
+QString MediaStream::getExportPath()
+{
+    return m_exportPath;
+}
+
+void MediaStream::setExportPath(QString path)
+{
+    m_exportPath = path;
+    if (m_exportPath.isEmpty()) {
+        setFrameExportCallback(nullptr);
+        return;
+    }
+
+    QDir().mkpath(m_exportPath);
+    setFrameExportCallback([path](const GlFrameExporter::Frame &frame) {
+        // Pixels are only valid during the callback, encoding runs in the thread pool
+        QImage image = QImage(frame.data, frame.width, frame.height, frame.stride,
+                              QImage::Format_RGBA8888)
+                               .copy();
+        QString fileName =
+                QDir(path).filePath(QString("frame-%1.png").arg(frame.index, 6, 10, QChar('0')));
+        QThreadPool::globalInstance()->start([image, fileName]() { image.save(fileName); });
+    });
+}
+
+void MediaStream::setFrameExportCallback(GlFrameExporter::Callback callback, int width,
+                                         int height)
+{
+    m_exportCallback = std::move(callback);
+    m_exportWidth = width;
+    m_exportHeight = height;
+    m_isExportChanged = true;
+    update();
+}
+
+bool MediaStream::getShared()
+{
+    return m_shared;
+}
+
+void MediaStream::setShared(bool shared)
+{
+    // The player is created or acquired once, when the item is initialized
+    if (m_isInitialized == true) {
+        qWarning() << "MediaStream: shared must be set before the item is shown";
+        return;
+    }
+    m_shared = shared;
+}
+
 void MediaStream::releaseResources()
 {
     cleanup();
@@ -9,25 +9,47 @@
 
 #include <QQuickItem>
 #include <QQuickWindow>
+#include <QElapsedTimer>
+#include <QImage>
 #include <QString>
+#include <QTimer>
+#include <memory>
 #include "gstplayer.hpp"
+#include "glframeexporter.hpp"
 
-class GlTextureRenderer;
+class VideoRenderNode;
 
 class MediaStream : public QQuickItem, public GstPlayerListener
 {
     Q_OBJECT
-    Q_PROPERTY(QString source READ getSource WRITE setSource)
+    Q_PROPERTY(QString source READ getSource WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(QString pipeline READ getPipeline WRITE setPipeline NOTIFY pipelineChanged)
     Q_PROPERTY(float position READ getPosition WRITE setPosition NOTIFY positionChanged)
     Q_PROPERTY(bool looping READ getLooping WRITE setLooping NOTIFY loopingChanged)
     Q_PROPERTY(bool playing READ getPlaying WRITE setPlaying NOTIFY playingChanged)
     Q_PROPERTY(float ratio READ getRatio NOTIFY ratioChanged)
+    Q_PROPERTY(bool live READ getLive WRITE setLive NOTIFY liveChanged)
+    Q_PROPERTY(float latency READ getLatency NOTIFY latencyChanged)
+    Q_PROPERTY(QString exportPath READ getExportPath WRITE setExportPath)
+    Q_PROPERTY(QString frameTap READ getFrameTap WRITE setFrameTap)
+    Q_PROPERTY(bool dedicatedUpload READ getDedicatedUpload WRITE setDedicatedUpload)
+    Q_PROPERTY(bool adaptiveBitrate READ getAdaptiveBitrate WRITE setAdaptiveBitrate)
+    Q_PROPERTY(bool readAhead READ getReadAhead WRITE setReadAhead)
+    Q_PROPERTY(QString filters READ getFilters WRITE setFilters)
+    Q_PROPERTY(QRectF crop READ getCrop WRITE setCrop)
+    Q_PROPERTY(int videoRotation READ getVideoRotation WRITE setVideoRotation)
+    Q_PROPERTY(bool letterbox READ getLetterbox WRITE setLetterbox)
+    Q_PROPERTY(bool onScreen READ isOnScreen NOTIFY onScreenChanged)
+    Q_PROPERTY(int releaseDelay READ getReleaseDelay WRITE setReleaseDelay)
+    Q_PROPERTY(bool shared READ getShared WRITE setShared)
     QML_ELEMENT
 
 public:
     MediaStream();
     QString getSource();
     void setSource(QString source);
+    QString getPipeline();
+    void setPipeline(QString pipeline);
     float getPosition();
     void setPosition(float percent);
     bool getLooping();
@@ -35,11 +57,50 @@ public:
     bool getPlaying();
     void setPlaying(bool playing);
     float getRatio();
+    bool getLive();
+    void setLive(bool live);
+    float getLatency();
+    QString getFrameTap();
+    void setFrameTap(QString name);
+    bool getDedicatedUpload();
+    void setDedicatedUpload(bool enabled);
+    bool getAdaptiveBitrate();
+    // Limit HLS and DASH variants to what the device renders in time, from the next source on
+    void setAdaptiveBitrate(bool enabled);
+    bool getReadAhead();
+    // Read local files in large blocks ahead of the demuxer, from the next source on
+    void setReadAhead(bool enabled);
+    QString getFilters();
+    void setFilters(QString filters);
+    QRectF getCrop();
+    void setCrop(QRectF crop);
+    int getVideoRotation();
+    void setVideoRotation(int degrees);
+    bool getLetterbox();
+    void setLetterbox(bool letterbox);
+    bool isOnScreen();
+    int getReleaseDelay();
+    // Milliseconds off screen before the pipeline and GL resources are released, < 0 to keep them
+    void setReleaseDelay(int delayMs);
+    bool getShared();
+    // Decode the source once for all shared items showing it, in all windows when the contexts
+    // are shared (Qt::AA_ShareOpenGLContexts). They share the playback state, and the player is
+    // only released with the last of them: shared items are not paused nor released when off
+    // screen.
+    void setShared(bool shared);
+    QString getExportPath();
+    void setExportPath(QString path);
+    // Callback is called in the rendering thread for each new frame, after asynchronous readback
+    void setFrameExportCallback(GlFrameExporter::Callback callback, int width = 0,
+                                int height = 0);
     QSGNode *updatePaintNode(QSGNode *node, UpdatePaintNodeData *);
 
+    static constexpr int DefaultReleaseDelayMs = 5000;
+
 public Q_SLOTS:
     virtual void paint();
     void cleanup();
+    void reportRenderTime();
 
     void pause();
     void play();
@@ -50,33 +111,95 @@ public Q_SLOTS:
     // Inherited from GstPlayerListener
     virtual void onNewFrame() override;
     virtual void onPrerollDone() override;
+    virtual void onCommandDone(GstPlayerCommand command, bool success) override;
 
 Q_SIGNALS:
     void newFrame();
+    void sourceChanged();
+    void pipelineChanged();
     void positionChanged();
     void loopingChanged();
     void playingChanged();
     void ratioChanged();
+    void liveChanged();
+    void latencyChanged();
+    void sourceLoaded(bool success);
+    void onScreenChanged();
 
 protected Q_SLOTS:
     virtual void handleWindowChanged(QQuickWindow *win);
+    virtual void handlePrerollDone();
+    virtual void applyPowerPolicy();
+    void updateVisibility();
+    virtual void hibernate();
 
 protected:
     virtual void init();
+    void loadSource();
+    // MediaScreenshot seeks and stops its player, it never shares it
+    virtual bool usesSharedPlayer() { return m_shared; }
+    bool attachSharedPlayer();
+    void detachSharedPlayer();
+    void configurePlayer();
+    std::string getSourceKey();
     void updateRatio();
     void releaseResources() override;
+    bool computeOnScreen();
+    virtual void onHidden();
+    virtual void onShown();
+    virtual void rehydrate();
 
-    GlTextureRenderer *m_renderer;
+    VideoRenderNode *m_renderer;
     GstPlayer *m_player;
+    // Owns m_player when it comes from PlayerRegistry
+    std::shared_ptr<GstPlayer> m_sharedPlayer;
+    // Player picked up by paint() in the rendering thread, replaced during synchronization
+    GstPlayer *m_renderPlayer;
+    std::shared_ptr<GstPlayer> m_sharedRenderPlayer;
+    EGLDisplay m_eglDisplay;
+    EGLContext m_eglContext;
+    bool m_shared;
     bool m_isInitialized;
     bool m_isReadyToRender;
     bool m_playerHasFrame;
     bool m_autostart;
     bool m_looping;
     bool m_playing;
+    bool m_live;
+    float m_latency;
     float m_streamPositionPercentage;
     int m_width;
     int m_height;
     float m_ratio;
     QString m_source;
+    QString m_pipeline;
+    QString m_frameTap;
+    bool m_dedicatedUpload;
+    bool m_adaptiveBitrate;
+    bool m_readAhead;
+    // Rendering thread: time spent picking up the latest new frame, -1 once reported to the
+    // adaptive bitrate controller with the render time of the node
+    qint64 m_paintTime;
+    QString m_exportPath;
+    QString m_filters;
+    std::vector<GlFilterChain::Filter> m_filterList;
+    bool m_isFiltersChanged;
+    QRectF m_crop;
+    int m_videoRotation;
+    bool m_letterbox;
+    bool m_isViewportChanged;
+    GlFrameExporter::Callback m_exportCallback;
+    int m_exportWidth;
+    int m_exportHeight;
+    bool m_isExportChanged;
+    std::atomic<bool> m_isExportPending;
+    std::atomic<bool> m_isUpdatePending;
+    quint64 m_renderedGeneration;
+    bool m_isOnScreen;
+    bool m_isHibernated;
+    bool m_isSnapshotPending;
+    int m_releaseDelay;
+    float m_resumePosition;
+    QTimer m_releaseTimer;
+    QImage m_snapshot;
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "playerregistry.hpp"
+#include <algorithm>
+
+std::mutex PlayerRegistry::m_lock;
+std::vector<PlayerRegistry::Slot> PlayerRegistry::m_slots;
+
+/**************************************************************************************************************
+ *
+ * @brief  			PlayerRegistry Class
+ *
+ * @remarks 		Hands out one GstPlayer per source and rendering context, so that items showing
+ *                  the same source (main view and preview, mirrored video wall tiles) share a
+ *                  single decode, its buffer pools and its uploaded textures. Renderers keep the
+ *                  frame they draw with GstPlayer::Texture::hold, so each of them may pick up new
+ *                  frames at its own pace.
+ *
+ **************************************************************************************************************/
+
+std::shared_ptr<GstPlayer> PlayerRegistry::acquire(const std::string &sourceKey,
+                                                   EGLDisplay eglDisplay, EGLContext eglContext,
+                                                   bool &isCreated)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    // Players released since the last call
+    m_slots.erase(std::remove_if(m_slots.begin(), m_slots.end(),
+                                 [](const Slot &slot) { return slot.player.expired(); }),
+                  m_slots.end());
+
+    for (const Slot &slot : m_slots) {
+        if (slot.sourceKey == sourceKey && slot.eglContext == eglContext) {
+            std::shared_ptr<GstPlayer> player = slot.player.lock();
+            if (player != nullptr) {
+                isCreated = false;
+                return player;
+            }
+        }
+    }
+
+    auto player = std::make_shared<GstPlayer>(eglDisplay, eglContext);
+    m_slots.push_back({ sourceKey, eglContext, player });
+    isCreated = true;
+    return player;
+}
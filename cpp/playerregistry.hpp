@@ -0,0 +1,34 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gstplayer.hpp"
+
+class PlayerRegistry
+{
+public:
+    // Player of the source for the rendering context, shared by all the callers passing the same
+    // source key. isCreated is set for the first caller, which configures and loads the player.
+    // The player is destroyed with its last reference.
+    static std::shared_ptr<GstPlayer> acquire(const std::string &sourceKey, EGLDisplay eglDisplay,
+                                              EGLContext eglContext, bool &isCreated);
+
+private:
+    struct Slot
+    {
+        std::string sourceKey;
+        EGLContext eglContext;
+        std::weak_ptr<GstPlayer> player;
+    };
+    static std::mutex m_lock;
+    static std::vector<Slot> m_slots;
+};
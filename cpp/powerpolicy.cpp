@@ -0,0 +1,239 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "powerpolicy.hpp"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QPointer>
+#include <algorithm>
+
+namespace {
+// Below the passive trip point, where the kernel starts throttling
+constexpr float ReducedBelowPassiveCelsius = 10.0f;
+
+constexpr float ReducedFrequencyRatio = 0.8f;
+constexpr float CriticalFrequencyRatio = 0.5f;
+constexpr int ReducedBatteryCapacity = 25;
+constexpr int CriticalBatteryCapacity = 10;
+constexpr int HysteresisBatteryCapacity = 5;
+
+// Frame rate caps of the Reduced and Critical levels
+constexpr int ReducedFrameRate = 30;
+constexpr int CriticalFrameRate = 15;
+
+QString readValue(const QString &path)
+{
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text) == false) {
+        return QString();
+    }
+    return QString::fromLatin1(file.readAll()).trimmed();
+}
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			PowerPolicy Class
+ *
+ * @remarks 		Reads thermal zones, CPU frequency caps and battery state from sysfs and maps them
+ *                  to a degradation level. Levels are raised immediately and lowered one step at a
+ *                  time, after several calmer readings below hysteresis thresholds.
+ *
+ **************************************************************************************************************/
+
+PowerPolicy &PowerPolicy::instance()
+{
+    // Destroyed with the application rather than at exit, so that its timer is stopped while the
+    // event dispatcher still exists. The sysfs root can point to a fake tree, e.g. to reproduce a
+    // throttled board.
+    static QPointer<PowerPolicy> policy;
+    if (policy.isNull()) {
+        policy = new PowerPolicy(qEnvironmentVariable("IMX_V2T_SYSFS_ROOT", "/sys"),
+                                 QCoreApplication::instance());
+    }
+    return *policy;
+}
+
+PowerPolicy::PowerPolicy(QString sysfsRoot, QObject *parent)
+    : QObject(parent), m_root(std::move(sysfsRoot))
+{
+    readTripPoints();
+    poll();
+
+    connect(&m_timer, &QTimer::timeout, this, &PowerPolicy::poll);
+    m_timer.start(PollIntervalMs);
+}
+
+int PowerPolicy::getMaxFrameRate()
+{
+    switch (m_level) {
+    case Level::Reduced:
+        return ReducedFrameRate;
+    case Level::Critical:
+        return CriticalFrameRate;
+    default:
+        return 0;
+    }
+}
+
+bool PowerPolicy::isThumbnailDecodeAllowed()
+{
+    return m_level != Level::Critical;
+}
+
+bool PowerPolicy::isKeyFramePreview()
+{
+    return m_level != Level::Normal;
+}
+
+const char *PowerPolicy::toString(Level level)
+{
+    switch (level) {
+    case Level::Reduced:
+        return "reduced";
+    case Level::Critical:
+        return "critical";
+    default:
+        return "normal";
+    }
+}
+
+void PowerPolicy::poll()
+{
+    m_readings = read();
+
+    Level level = evaluate(m_readings, 0.0f, 0.0f);
+    if (level > m_level) {
+        m_calmSamples = 0;
+    } else if (evaluate(m_readings, HysteresisCelsius, HysteresisRatio) < m_level) {
+        // Step down only after several readings clear of the thresholds
+        if (++m_calmSamples < RecoverySamples) {
+            return;
+        }
+        m_calmSamples = 0;
+        level = static_cast<Level>(static_cast<int>(m_level) - 1);
+    } else {
+        m_calmSamples = 0;
+        return;
+    }
+    if (level == m_level) {
+        return;
+    }
+
+    qInfo() << "Power policy:" << toString(m_level) << "->" << toString(level)
+            << "(temperature" << m_readings.temperature << "C, cpu frequency"
+            << qRound(m_readings.frequencyRatio * 100) << "%, battery"
+            << m_readings.batteryCapacity << "%)";
+    m_level = level;
+    Q_EMIT levelChanged(m_level);
+}
+
+PowerPolicy::Level PowerPolicy::evaluate(const Readings &readings, float margin, float ratioMargin)
+{
+    // Margins make the thresholds stricter, to test whether a lower level can be left
+    int batteryMargin = (margin > 0.0f) ? HysteresisBatteryCapacity : 0;
+    bool hasBattery = readings.batteryCapacity >= 0;
+
+    if (readings.temperature >= m_criticalCelsius - margin
+        || readings.frequencyRatio <= CriticalFrequencyRatio + ratioMargin
+        || (hasBattery && readings.batteryCapacity <= CriticalBatteryCapacity + batteryMargin)) {
+        return Level::Critical;
+    }
+    if (readings.temperature >= m_reducedCelsius - margin
+        || readings.frequencyRatio <= ReducedFrequencyRatio + ratioMargin
+        || (hasBattery && readings.batteryCapacity <= ReducedBatteryCapacity + batteryMargin)) {
+        return Level::Reduced;
+    }
+    return Level::Normal;
+}
+
+PowerPolicy::Readings PowerPolicy::read()
+{
+    Readings readings;
+    readings.temperature = readTemperature();
+    readings.frequencyRatio = readFrequencyRatio();
+    readings.batteryCapacity = readBatteryCapacity();
+    return readings;
+}
+
+float PowerPolicy::readTemperature()
+{
+    QDir thermal(m_root + "/class/thermal");
+    float temperature = -1.0f;
+    for (const QString &zone : thermal.entryList({ "thermal_zone*" }, QDir::Dirs | QDir::System)) {
+        bool ok = false;
+        float value = readValue(thermal.filePath(zone + "/temp")).toFloat(&ok) / 1000.0f;
+        if (ok) {
+            temperature = std::max(temperature, value);
+        }
+    }
+    return temperature;
+}
+
+float PowerPolicy::readFrequencyRatio()
+{
+    QDir cpus(m_root + "/devices/system/cpu");
+    float ratio = 1.0f;
+    for (const QString &cpu : cpus.entryList({ "cpu[0-9]*" }, QDir::Dirs | QDir::System)) {
+        // Thermal cooling lowers scaling_max_freq below what the CPU can do
+        bool okMax = false;
+        bool okCap = false;
+        float maximum = readValue(cpus.filePath(cpu + "/cpufreq/cpuinfo_max_freq")).toFloat(&okMax);
+        float cap = readValue(cpus.filePath(cpu + "/cpufreq/scaling_max_freq")).toFloat(&okCap);
+        if (okMax && okCap && maximum > 0.0f) {
+            ratio = std::min(ratio, cap / maximum);
+        }
+    }
+    return ratio;
+}
+
+int PowerPolicy::readBatteryCapacity()
+{
+    QDir supplies(m_root + "/class/power_supply");
+    QDir::Filters filters = QDir::Dirs | QDir::System | QDir::NoDotAndDotDot;
+    for (const QString &supply : supplies.entryList(filters)) {
+        if (readValue(supplies.filePath(supply + "/type")) == "Battery"
+            && readValue(supplies.filePath(supply + "/status")) == "Discharging") {
+            bool ok = false;
+            int capacity = readValue(supplies.filePath(supply + "/capacity")).toInt(&ok);
+            if (ok) {
+                return capacity;
+            }
+        }
+    }
+    return -1;
+}
+
+void PowerPolicy::readTripPoints()
+{
+    // Lowest passive trip point of all zones, defaults are kept when there is none
+    QDir thermal(m_root + "/class/thermal");
+    float passive = -1.0f;
+    for (const QString &zone : thermal.entryList({ "thermal_zone*" }, QDir::Dirs | QDir::System)) {
+        QDir trips(thermal.filePath(zone));
+        for (const QString &type : trips.entryList({ "trip_point_*_type" }, QDir::Files)) {
+            if (readValue(trips.filePath(type)) != "passive") {
+                continue;
+            }
+            QString temp = type;
+            temp.replace("_type", "_temp");
+            bool ok = false;
+            float value = readValue(trips.filePath(temp)).toFloat(&ok) / 1000.0f;
+            if (ok && (passive < 0.0f || value < passive)) {
+                passive = value;
+            }
+        }
+    }
+
+    if (passive > 0.0f) {
+        m_criticalCelsius = passive;
+        m_reducedCelsius = passive - ReducedBelowPassiveCelsius;
+    }
+    qInfo() << "Power policy: sysfs" << m_root << ", reduced at" << m_reducedCelsius
+            << "C, critical at" << m_criticalCelsius << "C";
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class PowerPolicy : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Level { Normal, Reduced, Critical };
+    Q_ENUM(Level)
+
+    struct Readings
+    {
+        // Hottest thermal zone, degrees Celsius, < 0 when unknown
+        float temperature = -1.0f;
+        // Lowest ratio of allowed to maximum CPU frequency, 1 when not capped
+        float frequencyRatio = 1.0f;
+        // Battery capacity in percent while discharging, < 0 on mains power
+        int batteryCapacity = -1;
+    };
+
+    // Shared instance reading the sysfs tree at $IMX_V2T_SYSFS_ROOT, or /sys. Created on first
+    // use in the GUI thread and owned by the application, which must exist by then.
+    static PowerPolicy &instance();
+
+    Level getLevel() { return m_level; }
+    const Readings &getReadings() { return m_readings; }
+
+    // What the consumers do at the current level
+    int getMaxFrameRate();
+    bool isThumbnailDecodeAllowed();
+    bool isKeyFramePreview();
+
+    static const char *toString(Level level);
+
+    static constexpr int PollIntervalMs = 2000;
+    // Consecutive calmer readings required before stepping down one level
+    static constexpr int RecoverySamples = 3;
+    static constexpr float HysteresisCelsius = 5.0f;
+    static constexpr float HysteresisRatio = 0.1f;
+
+Q_SIGNALS:
+    void levelChanged(PowerPolicy::Level level);
+
+public Q_SLOTS:
+    void poll();
+
+protected:
+    PowerPolicy(QString sysfsRoot, QObject *parent);
+
+    Readings read();
+    float readTemperature();
+    float readFrequencyRatio();
+    int readBatteryCapacity();
+    Level evaluate(const Readings &readings, float margin, float ratioMargin);
+    void readTripPoints();
+
+private:
+    QString m_root;
+    QTimer m_timer;
+    Level m_level = Level::Normal;
+    Readings m_readings;
+    int m_calmSamples = 0;
+    // Passive and critical trip points of the hottest zone, or defaults
+    float m_reducedCelsius = 75.0f;
+    float m_criticalCelsius = 85.0f;
+};
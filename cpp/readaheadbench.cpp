@@ -0,0 +1,271 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <gst/gst.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include "readaheadsource.hpp"
+
+namespace {
+// Demuxed frames buffered before the consumer, as decodebin's multiqueue does in playbin
+constexpr GstClockTime QueueTime = 2 * GST_SECOND;
+
+// Lateness of a frame that counts as an underrun
+constexpr GstClockTimeDiff UnderrunTolerance = 20 * GST_MSECOND;
+
+struct Candidate
+{
+    const char *name;
+    const char *factory;
+    bool isMmap;
+};
+
+const Candidate Candidates[] = {
+    { "filesrc", "filesrc", false },
+    { "readaheadsrc", ReadAheadSource::ElementName.data(), false },
+    { "readaheadsrc mmap", ReadAheadSource::ElementName.data(), true },
+};
+
+struct RunStats
+{
+    GstElement *sink = nullptr;
+    // Consume frames at their decoding time instead of as fast as they come
+    bool isPaced = false;
+    GstSegment segment;
+    guint64 bytes = 0;
+    int underruns = 0;
+    GstClockTime longestStall = 0;
+    bool isLate = false;
+    std::string error;
+    GstClockTime elapsed = 0;
+};
+
+// Drops the clean pages of the file from the page cache, so that each run reads the storage
+bool dropCache(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool isDropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return isDropped;
+}
+
+// Links the first video stream of parsebin to the queue, other streams are left unlinked
+void onPadAdded(GstElement *demux, GstPad *pad, gpointer data)
+{
+    GstPad *queuePad = gst_element_get_static_pad(GST_ELEMENT(data), "sink");
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (caps == nullptr) {
+        caps = gst_pad_query_caps(pad, nullptr);
+    }
+    const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if (gst_pad_is_linked(queuePad) == false && g_str_has_prefix(name, "video/")) {
+        gst_pad_link(pad, queuePad);
+    }
+    gst_caps_unref(caps);
+    gst_object_unref(GST_OBJECT(queuePad));
+}
+
+GstPadProbeReturn onSinkData(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    auto *stats = static_cast<RunStats *>(data);
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT) {
+            gst_event_copy_segment(event, &stats->segment);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClockTime position = GST_BUFFER_DTS_OR_PTS(buffer);
+    GstClock *clock = gst_element_get_clock(stats->sink);
+    if (stats->isPaced == false || clock == nullptr || stats->segment.format != GST_FORMAT_TIME
+        || GST_CLOCK_TIME_IS_VALID(position) == false) {
+        if (clock != nullptr) {
+            gst_object_unref(GST_OBJECT(clock));
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    // Decoding order: presentation times of reordered frames would look late
+    GstClockTime baseTime = gst_element_get_base_time(stats->sink);
+    GstClockTime runningTime =
+            gst_segment_to_running_time(&stats->segment, GST_FORMAT_TIME, position);
+    GstClockTimeDiff lateness = GST_CLOCK_DIFF(runningTime + baseTime, gst_clock_get_time(clock));
+    if (lateness < 0) {
+        GstClockID id = gst_clock_new_single_shot_id(clock, runningTime + baseTime);
+        gst_clock_id_wait(id, nullptr);
+        gst_clock_id_unref(id);
+        stats->isLate = false;
+    } else if (lateness > UnderrunTolerance) {
+        // The queue ran dry: the storage did not deliver in time
+        if (stats->isLate == false) {
+            stats->underruns += 1;
+        }
+        stats->isLate = true;
+        stats->longestStall = std::max<GstClockTime>(stats->longestStall, lateness);
+    }
+    gst_object_unref(GST_OBJECT(clock));
+    return GST_PAD_PROBE_OK;
+}
+
+// Bytes delivered by the source, whatever stream they belong to
+GstPadProbeReturn onSourceData(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    auto *stats = static_cast<RunStats *>(data);
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        stats->bytes += gst_buffer_list_calculate_size(list);
+    } else {
+        stats->bytes += gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+// Reads the video stream of the file through parsebin, as playbin would, for at most duration
+RunStats run(const Candidate &candidate, const char *path, bool isPaced, GstClockTime duration)
+{
+    RunStats stats;
+    stats.isPaced = isPaced;
+    gst_segment_init(&stats.segment, GST_FORMAT_UNDEFINED);
+
+    GError *error = nullptr;
+    std::string description = "parsebin name=demux queue name=buffer max-size-buffers=0 "
+                              "max-size-bytes=0 max-size-time="
+            + std::to_string(QueueTime) + " ! fakesink name=sink sync=false";
+    GstElement *pipeline = gst_parse_launch(description.data(), &error);
+    if (error != nullptr) {
+        stats.error = error->message;
+        g_clear_error(&error);
+        if (pipeline != nullptr) {
+            gst_object_unref(GST_OBJECT(pipeline));
+        }
+        return stats;
+    }
+    GstElement *source = gst_element_factory_make(candidate.factory, nullptr);
+    if (source == nullptr) {
+        stats.error = std::string("missing element ") + candidate.factory;
+        gst_object_unref(GST_OBJECT(pipeline));
+        return stats;
+    }
+    g_object_set(source, "location", path, nullptr);
+    if (candidate.isMmap) {
+        g_object_set(source, "mmap", TRUE, nullptr);
+    }
+    GstElement *demux = gst_bin_get_by_name(GST_BIN(pipeline), "demux");
+    GstElement *queue = gst_bin_get_by_name(GST_BIN(pipeline), "buffer");
+    stats.sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+    gst_bin_add(GST_BIN(pipeline), source);
+    gst_element_link(source, demux);
+    g_signal_connect(demux, "pad-added", G_CALLBACK(onPadAdded), queue);
+    GstPad *sinkPad = gst_element_get_static_pad(stats.sink, "sink");
+    gst_pad_add_probe(sinkPad,
+                      static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER
+                                                   | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                      onSinkData, &stats, nullptr);
+    gst_object_unref(GST_OBJECT(sinkPad));
+    // Counted at the source rather than after the queue: audio, headers and indexes are read too
+    GstPad *sourcePad = gst_element_get_static_pad(source, "src");
+    gst_pad_add_probe(sourcePad,
+                      static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER
+                                                   | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                      onSourceData, &stats, nullptr);
+    gst_object_unref(GST_OBJECT(sourcePad));
+
+    GstClockTime start = gst_util_get_timestamp();
+    GstBus *bus = gst_element_get_bus(pipeline);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstMessage *message = gst_bus_timed_pop_filtered(
+            bus, duration, static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    stats.elapsed = gst_util_get_timestamp() - start;
+    if (message != nullptr && GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
+        gst_message_parse_error(message, &error, nullptr);
+        stats.error = error->message;
+        g_clear_error(&error);
+    }
+    if (message != nullptr) {
+        gst_message_unref(message);
+    }
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+
+    gst_object_unref(GST_OBJECT(bus));
+    gst_object_unref(GST_OBJECT(demux));
+    gst_object_unref(GST_OBJECT(queue));
+    gst_object_unref(GST_OBJECT(stats.sink));
+    gst_object_unref(GST_OBJECT(pipeline));
+    stats.sink = nullptr;
+    return stats;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    gint durationSec = 30;
+    gint passes = 1;
+    gboolean isCached = FALSE;
+    gchar **inputs = nullptr;
+    GOptionEntry entries[] = {
+        { "duration", 'd', 0, G_OPTION_ARG_INT, &durationSec,
+          "Seconds of each run at most (default: 30)", "SEC" },
+        { "passes", 'n', 0, G_OPTION_ARG_INT, &passes, "Runs of each source (default: 1)", "N" },
+        { "cached", 0, 0, G_OPTION_ARG_NONE, &isCached,
+          "Keep the file in the page cache between runs", nullptr },
+        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &inputs, nullptr, "FILE" },
+        { nullptr }
+    };
+
+    GError *error = nullptr;
+    GOptionContext *optionContext =
+            g_option_context_new("- compare file sources on the storage holding FILE");
+    g_option_context_add_main_entries(optionContext, entries, nullptr);
+    bool isParsed = g_option_context_parse(optionContext, &argc, &argv, &error);
+    g_option_context_free(optionContext);
+    if (isParsed == false || inputs == nullptr || inputs[0] == nullptr) {
+        g_print("%s\n", error != nullptr ? error->message : "No input, see --help");
+        g_clear_error(&error);
+        return 1;
+    }
+
+    gst_init(&argc, &argv);
+    ReadAheadSource::registerElement();
+
+    const char *path = inputs[0];
+    GstClockTime duration = std::max(durationSec, 1) * GST_SECOND;
+    int failures = 0;
+    for (int pass = 0; pass < std::max(passes, 1); pass++) {
+        for (const Candidate &candidate : Candidates) {
+            // Throughput: as fast as the demuxer pulls. Underruns: consumed in real time.
+            RunStats results[2];
+            for (int paced = 0; paced < 2; paced++) {
+                if (isCached == FALSE && dropCache(path) == false) {
+                    g_print("Cannot drop %s from the page cache\n", path);
+                }
+                results[paced] = run(candidate, path, paced == 1, duration);
+            }
+            if (results[0].error.empty() == false || results[1].error.empty() == false) {
+                failures += 1;
+                g_print("%s: failed: %s\n", candidate.name,
+                        (results[0].error.empty() ? results[1] : results[0]).error.data());
+                continue;
+            }
+            double readSec = static_cast<double>(results[0].elapsed) / GST_SECOND;
+            double readMiB = static_cast<double>(results[0].bytes) / (1 << 20);
+            g_print("%s: read %.1f MiB in %.2f s (%.1f MiB/s); playback %.1f s: %d underrun(s), "
+                    "longest stall %.1f ms\n",
+                    candidate.name, readMiB, readSec, readMiB / std::max(readSec, 0.001),
+                    static_cast<double>(results[1].elapsed) / GST_SECOND, results[1].underruns,
+                    static_cast<double>(results[1].longestStall) / GST_MSECOND);
+        }
+    }
+
+    g_strfreev(inputs);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,486 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "readaheadsource.hpp"
+#include <gst/base/gstbasesrc.h>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+enum { PropLocation = 1, PropReadSize, PropReadAhead, PropMmap };
+
+// Mapped file shared by the buffers handed downstream, unmapped with the last of them
+struct Mapping
+{
+    guint8 *data;
+    gsize size;
+    gint refs;
+};
+
+Mapping *refMapping(Mapping *mapping)
+{
+    g_atomic_int_inc(&mapping->refs);
+    return mapping;
+}
+
+void unrefMapping(gpointer data)
+{
+    auto *mapping = static_cast<Mapping *>(data);
+    if (g_atomic_int_dec_and_test(&mapping->refs)) {
+        munmap(mapping->data, mapping->size);
+        delete mapping;
+    }
+}
+
+struct ReadAheadSrc
+{
+    GstBaseSrc parent;
+    gchar *location;
+    guint readSize;
+    guint readAhead;
+    gboolean isMmap;
+
+    int fd;
+    guint64 size;
+    // Page size: reads and prefetches start on page boundaries
+    guint64 alignment;
+    // Read mode: latest block read, requests within it are served as sub-buffers
+    GstBuffer *block;
+    guint64 blockOffset;
+    // Range the kernel was last asked to prefetch
+    guint64 prefetchStart;
+    guint64 prefetchEnd;
+    Mapping *mapping;
+};
+
+struct ReadAheadSrcClass
+{
+    GstBaseSrcClass parent;
+};
+
+GstStaticPadTemplate SrcTemplate =
+        GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+void read_ahead_src_uri_handler_init(gpointer iface, gpointer data);
+
+G_DEFINE_TYPE_WITH_CODE(ReadAheadSrc, read_ahead_src, GST_TYPE_BASE_SRC,
+                        G_IMPLEMENT_INTERFACE(GST_TYPE_URI_HANDLER,
+                                              read_ahead_src_uri_handler_init))
+
+ReadAheadSrc *toSource(gpointer object)
+{
+    return reinterpret_cast<ReadAheadSrc *>(object);
+}
+
+bool setLocation(ReadAheadSrc *self, const gchar *location, GError **error)
+{
+    GST_OBJECT_LOCK(self);
+    GstState state = GST_STATE(self);
+    if (state != GST_STATE_READY && state != GST_STATE_NULL) {
+        GST_OBJECT_UNLOCK(self);
+        g_set_error(error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+                    "Changing the location of a running source is not supported");
+        return false;
+    }
+    g_free(self->location);
+    self->location = g_strdup(location);
+    GST_OBJECT_UNLOCK(self);
+    g_object_notify(G_OBJECT(self), "location");
+    return true;
+}
+
+// Keeps the kernel a window ahead of the reader: asynchronous, the next reads find the pages
+// cached instead of waiting for the storage
+void prefetch(ReadAheadSrc *self, guint64 position)
+{
+    if (self->readAhead == 0 || position >= self->size) {
+        return;
+    }
+    bool isInWindow = position >= self->prefetchStart && position <= self->prefetchEnd;
+    if (isInWindow && position + self->readAhead / 2 <= self->prefetchEnd) {
+        return;
+    }
+    // Extends the window when reading on, restarts it after a seek
+    guint64 start = (isInWindow ? self->prefetchEnd : position) & ~(self->alignment - 1);
+    guint64 end = std::min<guint64>(position + self->readAhead, self->size);
+    if (isInWindow == false) {
+        self->prefetchStart = start;
+    }
+    self->prefetchEnd = end;
+    if (end <= start) {
+        return;
+    }
+    if (self->mapping != nullptr) {
+        madvise(self->mapping->data + start, end - start, MADV_WILLNEED);
+    } else {
+        posix_fadvise(self->fd, start, end - start, POSIX_FADV_WILLNEED);
+    }
+}
+
+// Reads the aligned block holding [offset, offset + length), of readSize bytes at least
+GstFlowReturn readBlock(ReadAheadSrc *self, guint64 offset, guint length)
+{
+    guint64 start = offset & ~(self->alignment - 1);
+    guint64 end = std::min(std::max<guint64>(start + self->readSize, offset + length), self->size);
+    gsize size = end - start;
+
+    GstAllocationParams params;
+    gst_allocation_params_init(&params);
+    params.align = self->alignment - 1;
+    GstBuffer *block = gst_buffer_new_allocate(nullptr, size, &params);
+    GstMapInfo map;
+    gst_buffer_map(block, &map, GST_MAP_WRITE);
+    gsize done = 0;
+    ssize_t count = 0;
+    while (done < size) {
+        count = pread(self->fd, map.data + done, size - done, start + done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        done += count;
+    }
+    gst_buffer_unmap(block, &map);
+
+    if (done < size) {
+        const gchar *reason = (count == 0) ? "unexpected end of file" : g_strerror(errno);
+        gst_buffer_unref(block);
+        GST_ELEMENT_ERROR(self, RESOURCE, READ, (nullptr),
+                          ("Cannot read %s at %" G_GUINT64_FORMAT ": %s", self->location,
+                           start + done, reason));
+        return GST_FLOW_ERROR;
+    }
+    gst_clear_buffer(&self->block);
+    self->block = block;
+    self->blockOffset = start;
+    return GST_FLOW_OK;
+}
+
+void read_ahead_src_set_property(GObject *object, guint id, const GValue *value,
+                                 GParamSpec *pspec)
+{
+    ReadAheadSrc *self = toSource(object);
+    switch (id) {
+    case PropLocation:
+        setLocation(self, g_value_get_string(value), nullptr);
+        break;
+    case PropReadSize:
+        self->readSize = g_value_get_uint(value);
+        // Size of the buffers pushed when the source drives the pipeline
+        gst_base_src_set_blocksize(GST_BASE_SRC(self), self->readSize);
+        break;
+    case PropReadAhead:
+        self->readAhead = g_value_get_uint(value);
+        break;
+    case PropMmap:
+        self->isMmap = g_value_get_boolean(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+        break;
+    }
+}
+
+void read_ahead_src_get_property(GObject *object, guint id, GValue *value, GParamSpec *pspec)
+{
+    ReadAheadSrc *self = toSource(object);
+    switch (id) {
+    case PropLocation:
+        GST_OBJECT_LOCK(self);
+        g_value_set_string(value, self->location);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PropReadSize:
+        g_value_set_uint(value, self->readSize);
+        break;
+    case PropReadAhead:
+        g_value_set_uint(value, self->readAhead);
+        break;
+    case PropMmap:
+        g_value_set_boolean(value, self->isMmap);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+        break;
+    }
+}
+
+void read_ahead_src_finalize(GObject *object)
+{
+    g_free(toSource(object)->location);
+    G_OBJECT_CLASS(read_ahead_src_parent_class)->finalize(object);
+}
+
+gboolean read_ahead_src_start(GstBaseSrc *base)
+{
+    ReadAheadSrc *self = toSource(base);
+    if (self->location == nullptr) {
+        GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, ("No file name specified for reading."),
+                          (nullptr));
+        return FALSE;
+    }
+    self->fd = open(self->location, O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    const gchar *reason = nullptr;
+    if (self->fd < 0 || fstat(self->fd, &status) != 0) {
+        reason = g_strerror(errno);
+    } else if (S_ISREG(status.st_mode) == false) {
+        // Devices and pipes can neither be mapped nor prefetched
+        reason = "not a regular file";
+    }
+    if (reason != nullptr) {
+        GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ, ("Cannot open %s", self->location),
+                          ("%s", reason));
+        if (self->fd >= 0) {
+            close(self->fd);
+            self->fd = -1;
+        }
+        return FALSE;
+    }
+    self->size = status.st_size;
+    self->alignment = std::max<long>(sysconf(_SC_PAGESIZE), 4096);
+    self->blockOffset = 0;
+    self->prefetchStart = 0;
+    self->prefetchEnd = 0;
+    // Doubles the read-ahead window the kernel uses for the file
+    posix_fadvise(self->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (self->isMmap && self->size > 0) {
+        // Fails for files larger than the address space of 32-bit systems. Pages that cannot be
+        // read later (I/O error, removed card, truncated file) raise SIGBUS in whichever thread
+        // touches them, which is not recoverable here.
+        void *data = mmap(nullptr, static_cast<size_t>(self->size), PROT_READ, MAP_PRIVATE,
+                          self->fd, 0);
+        if (data == MAP_FAILED) {
+            g_print("Cannot map %s (%s), reading it instead\n", self->location, g_strerror(errno));
+        } else {
+            madvise(data, static_cast<size_t>(self->size), MADV_SEQUENTIAL);
+            self->mapping =
+                    new Mapping { static_cast<guint8 *>(data), static_cast<gsize>(self->size), 1 };
+        }
+    }
+    prefetch(self, 0);
+    return TRUE;
+}
+
+gboolean read_ahead_src_stop(GstBaseSrc *base)
+{
+    ReadAheadSrc *self = toSource(base);
+    gst_clear_buffer(&self->block);
+    if (self->mapping != nullptr) {
+        unrefMapping(self->mapping);
+        self->mapping = nullptr;
+    }
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    return TRUE;
+}
+
+gboolean read_ahead_src_get_size(GstBaseSrc *base, guint64 *size)
+{
+    *size = toSource(base)->size;
+    return TRUE;
+}
+
+gboolean read_ahead_src_is_seekable(GstBaseSrc *base)
+{
+    return TRUE;
+}
+
+GstFlowReturn read_ahead_src_create(GstBaseSrc *base, guint64 offset, guint length,
+                                    GstBuffer **buffer)
+{
+    ReadAheadSrc *self = toSource(base);
+    if (offset >= self->size) {
+        return GST_FLOW_EOS;
+    }
+    length = static_cast<guint>(std::min<guint64>(length, self->size - offset));
+
+    GstBuffer *result;
+    if (self->mapping != nullptr) {
+        result = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+                                             self->mapping->data + offset, length, 0, length,
+                                             refMapping(self->mapping), unrefMapping);
+    } else {
+        // Demuxers pulling small atoms and samples share the memory of one large read
+        if (self->block == nullptr || offset < self->blockOffset
+            || offset + length > self->blockOffset + gst_buffer_get_size(self->block)) {
+            GstFlowReturn ret = readBlock(self, offset, length);
+            if (ret != GST_FLOW_OK) {
+                return ret;
+            }
+        }
+        result = gst_buffer_copy_region(self->block, GST_BUFFER_COPY_MEMORY,
+                                        offset - self->blockOffset, length);
+    }
+    prefetch(self, offset + length);
+
+    if (*buffer != nullptr) {
+        // Downstream provided the buffer to fill
+        GstMapInfo map;
+        gst_buffer_map(result, &map, GST_MAP_READ);
+        gst_buffer_fill(*buffer, 0, map.data, map.size);
+        gst_buffer_unmap(result, &map);
+        gst_buffer_set_size(*buffer, length);
+        gst_buffer_unref(result);
+        result = *buffer;
+    }
+    GST_BUFFER_OFFSET(result) = offset;
+    GST_BUFFER_OFFSET_END(result) = offset + length;
+    *buffer = result;
+    return GST_FLOW_OK;
+}
+
+void read_ahead_src_class_init(ReadAheadSrcClass *klass)
+{
+    GObjectClass *objectClass = G_OBJECT_CLASS(klass);
+    GstElementClass *elementClass = GST_ELEMENT_CLASS(klass);
+    GstBaseSrcClass *baseClass = GST_BASE_SRC_CLASS(klass);
+
+    objectClass->set_property = read_ahead_src_set_property;
+    objectClass->get_property = read_ahead_src_get_property;
+    objectClass->finalize = read_ahead_src_finalize;
+
+    auto flags = static_cast<GParamFlags>(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+    g_object_class_install_property(
+            objectClass, PropLocation,
+            g_param_spec_string("location", "File Location", "Location of the file to read",
+                                nullptr, flags));
+    g_object_class_install_property(
+            objectClass, PropReadSize,
+            g_param_spec_uint("read-size", "Read size", "Size of each read in bytes", 4096,
+                              G_MAXINT, ReadAheadSource::DefaultReadSize, flags));
+    g_object_class_install_property(
+            objectClass, PropReadAhead,
+            g_param_spec_uint("read-ahead", "Read ahead",
+                              "Bytes prefetched beyond the latest read, 0 to leave it to the "
+                              "kernel",
+                              0, G_MAXINT, ReadAheadSource::DefaultReadAhead, flags));
+    g_object_class_install_property(
+            objectClass, PropMmap,
+            g_param_spec_boolean("mmap", "Mmap", "Map the file instead of reading it", FALSE,
+                                 flags));
+
+    gst_element_class_set_static_metadata(elementClass, "Read-ahead file source", "Source/File",
+                                          "Reads files in large aligned blocks and prefetches "
+                                          "the following ones, for slow storage",
+                                          "NXP");
+    gst_element_class_add_static_pad_template(elementClass, &SrcTemplate);
+
+    baseClass->start = read_ahead_src_start;
+    baseClass->stop = read_ahead_src_stop;
+    baseClass->get_size = read_ahead_src_get_size;
+    baseClass->is_seekable = read_ahead_src_is_seekable;
+    baseClass->create = read_ahead_src_create;
+}
+
+void read_ahead_src_init(ReadAheadSrc *self)
+{
+    self->location = nullptr;
+    self->readSize = ReadAheadSource::DefaultReadSize;
+    self->readAhead = ReadAheadSource::DefaultReadAhead;
+    self->isMmap = FALSE;
+    self->fd = -1;
+    self->size = 0;
+    self->alignment = 4096;
+    self->block = nullptr;
+    self->blockOffset = 0;
+    self->prefetchStart = 0;
+    self->prefetchEnd = 0;
+    self->mapping = nullptr;
+    gst_base_src_set_blocksize(GST_BASE_SRC(self), self->readSize);
+}
+
+GstURIType read_ahead_src_uri_get_type(GType type)
+{
+    return GST_URI_SRC;
+}
+
+const gchar *const *read_ahead_src_uri_get_protocols(GType type)
+{
+    static const gchar *protocols[] = { ReadAheadSource::Protocol.data(), nullptr };
+    return protocols;
+}
+
+gchar *read_ahead_src_uri_get_uri(GstURIHandler *handler)
+{
+    ReadAheadSrc *self = toSource(handler);
+    GST_OBJECT_LOCK(self);
+    gchar *fileUri =
+            (self->location != nullptr) ? gst_filename_to_uri(self->location, nullptr) : nullptr;
+    GST_OBJECT_UNLOCK(self);
+    if (fileUri == nullptr) {
+        return nullptr;
+    }
+    std::string uri = ReadAheadSource::getUri(fileUri);
+    g_free(fileUri);
+    return g_strdup(uri.data());
+}
+
+gboolean read_ahead_src_uri_set_uri(GstURIHandler *handler, const gchar *uri, GError **error)
+{
+    std::string_view view(uri);
+    std::string prefix = std::string(ReadAheadSource::Protocol) + ":";
+    if (view.substr(0, prefix.size()) != prefix) {
+        g_set_error(error, GST_URI_ERROR, GST_URI_ERROR_UNSUPPORTED_PROTOCOL,
+                    "Unsupported URI %s", uri);
+        return FALSE;
+    }
+    // Same path and escaping as the file:// URI it was made of
+    std::string fileUri = "file:" + std::string(view.substr(prefix.size()));
+    gchar *location = g_filename_from_uri(fileUri.data(), nullptr, error);
+    if (location == nullptr) {
+        return FALSE;
+    }
+    bool isSet = setLocation(toSource(handler), location, error);
+    g_free(location);
+    return isSet;
+}
+
+void read_ahead_src_uri_handler_init(gpointer iface, gpointer data)
+{
+    auto *handler = static_cast<GstURIHandlerInterface *>(iface);
+    handler->get_type = read_ahead_src_uri_get_type;
+    handler->get_protocols = read_ahead_src_uri_get_protocols;
+    handler->get_uri = read_ahead_src_uri_get_uri;
+    handler->set_uri = read_ahead_src_uri_set_uri;
+}
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			ReadAheadSource Class
+ *
+ * @remarks 		readaheadsrc, a file source for slow SD cards, eMMC and USB storage. filesrc reads
+ *                  what the demuxer pulls, often a few kilobytes at a time, and waits for the
+ *                  storage on each read. readaheadsrc reads page aligned blocks of read-size and
+ *                  serves the requests within them without copy, or maps the file, and asks the
+ *                  kernel to prefetch read-ahead bytes beyond the reader so that the storage
+ *                  works while the pipeline decodes.
+ *
+ **************************************************************************************************************/
+
+void ReadAheadSource::registerElement()
+{
+    // Only claims its own protocol: file:// URIs keep filesrc unless rewritten with getUri()
+    gst_element_register(nullptr, ElementName.data(), GST_RANK_MARGINAL, read_ahead_src_get_type());
+}
+
+std::string ReadAheadSource::getUri(const std::string &uri)
+{
+    if (uri.compare(0, 5, "file:") != 0) {
+        return uri;
+    }
+    return std::string(Protocol) + uri.substr(4);
+}
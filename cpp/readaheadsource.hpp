@@ -0,0 +1,39 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+#include <string>
+#include <string_view>
+
+// How readaheadsrc gets the file into memory
+enum class ReadAheadMode {
+    // Plain filesrc
+    Off,
+    // Large page aligned reads, the following blocks prefetched by the kernel
+    Read,
+    // File mapped once, the following pages prefetched by the kernel. A read error, a removed
+    // card or a truncated file raises SIGBUS in the thread touching the pages instead of an
+    // error message: only for storage that cannot go away.
+    Mmap
+};
+
+class ReadAheadSource
+{
+public:
+    // Registers the readaheadsrc element, which handles readahead:// URIs. Called by GstLib.
+    static void registerElement();
+    // readahead:// URI of a file:// URI, other URIs are returned unchanged
+    static std::string getUri(const std::string &uri);
+
+    static constexpr std::string_view ElementName = "readaheadsrc";
+    static constexpr std::string_view Protocol = "readahead";
+    // Size of each read, requests of the demuxer are served from the latest block
+    static constexpr guint DefaultReadSize = 1 << 20;
+    // Bytes the kernel is asked to prefetch beyond the latest read
+    static constexpr guint DefaultReadAhead = 16 << 20;
+};
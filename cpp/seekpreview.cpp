@@ -0,0 +1,247 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "seekpreview.hpp"
+#include "powerpolicy.hpp"
+#include <QDebug>
+#include <QQuickWindow>
+#include <QSGImageNode>
+#include <algorithm>
+#include <cmath>
+
+/**************************************************************************************************************
+ *
+ * @brief  			SeekPreview Class
+ *
+ * @remarks 		Preview of any position of a media file for seek bars. Once the source is set, key
+ *                  frames at fixed intervals of the duration are decoded at low resolution into a
+ *                  sprite sheet by a Thumbnailer on a worker thread. The sheet is uploaded once as
+ *                  a texture and moving the position only changes the tile drawn from it.
+ *
+ **************************************************************************************************************/
+
+SeekPreview::SeekPreview()
+    : m_position(0.0f),
+      m_tileCount(DefaultTileCount),
+      m_tileWidth(DefaultTileWidth),
+      m_sheetTileWidth(0),
+      m_sheetTileHeight(0),
+      m_sheetTileCount(0),
+      m_isSheetChanged(false),
+      m_isDeferred(false),
+      m_generation(0),
+      m_thread(nullptr)
+{
+    setFlag(ItemHasContents, true);
+    connect(&PowerPolicy::instance(), &PowerPolicy::levelChanged, this,
+            &SeekPreview::applyPowerPolicy);
+}
+
+SeekPreview::~SeekPreview()
+{
+    stop();
+}
+
+QString SeekPreview::getSource()
+{
+    return m_source;
+}
+
+void SeekPreview::setSource(QString source)
+{
+    if (source == m_source) {
+        return;
+    }
+    m_source = source;
+    Q_EMIT sourceChanged();
+    start();
+}
+
+float SeekPreview::getPosition()
+{
+    return m_position;
+}
+
+void SeekPreview::setPosition(float percent)
+{
+    int index = getTileIndex();
+    m_position = std::clamp(percent, 0.0f, 1.0f);
+    Q_EMIT positionChanged();
+    // Same tile, nothing to draw
+    if (getTileIndex() != index) {
+        update();
+    }
+}
+
+int SeekPreview::getTileCount()
+{
+    return m_tileCount;
+}
+
+void SeekPreview::setTileCount(int count)
+{
+    m_tileCount = std::max(count, 1);
+}
+
+int SeekPreview::getTileWidth()
+{
+    return m_tileWidth;
+}
+
+void SeekPreview::setTileWidth(int width)
+{
+    m_tileWidth = std::max(width, 16);
+}
+
+float SeekPreview::getRatio()
+{
+    if (m_sheetTileHeight <= 0) {
+        return 16.0f / 9.0f;
+    }
+    return static_cast<float>(m_sheetTileWidth) / m_sheetTileHeight;
+}
+
+bool SeekPreview::isReady()
+{
+    return m_sheet.isNull() == false;
+}
+
+void SeekPreview::applyPowerPolicy()
+{
+    if (m_isDeferred && PowerPolicy::instance().isThumbnailDecodeAllowed()) {
+        start();
+    }
+}
+
+void SeekPreview::start()
+{
+    stop();
+    bool wasReady = isReady();
+    quint64 generation = ++m_generation;
+    m_sheet = QImage();
+    m_sheetTileCount = 0;
+    m_isSheetChanged = true;
+    m_isDeferred = false;
+    if (wasReady) {
+        Q_EMIT readyChanged();
+    }
+    update();
+
+    // Files only: live sources and test patterns cannot seek
+    if (m_source.startsWith("file:") == false) {
+        return;
+    }
+    if (PowerPolicy::instance().isThumbnailDecodeAllowed() == false) {
+        m_isDeferred = true;
+        return;
+    }
+
+    // Frames are scaled on the CPU, the worker needs no GL context
+    ThumbnailOptions options;
+    options.width = m_tileWidth;
+    options.columns = std::min(m_tileCount, SheetColumns);
+    options.rows = (m_tileCount + options.columns - 1) / options.columns;
+    options.keyFramesOnly = true;
+    auto thumbnailer = std::make_shared<Thumbnailer>(EGL_NO_DISPLAY, EGL_NO_CONTEXT, options);
+    m_thumbnailer = thumbnailer;
+
+    std::string uri = m_source.toStdString();
+    m_thread = QThread::create([this, thumbnailer, uri, generation]() mutable {
+        ThumbnailResult result = thumbnailer->render(uri);
+        QImage sheet;
+        if (result.isSuccess) {
+            // Copied out of the thumbnailer, which is released below
+            sheet = QImage(thumbnailer->getPixels().data(), result.width, result.height,
+                           result.width * 4, QImage::Format_RGBA8888)
+                            .copy();
+        }
+        // Stopping its pipeline must not block the GUI thread
+        thumbnailer.reset();
+        QMetaObject::invokeMethod(
+                this,
+                [this, generation, result, sheet]() { onSheetDone(generation, result, sheet); },
+                Qt::QueuedConnection);
+    });
+    m_thread->start(QThread::LowPriority);
+}
+
+void SeekPreview::stop()
+{
+    if (m_thread == nullptr) {
+        return;
+    }
+    // Wakes up the worker from its current wait, the result is dropped by the generation check
+    if (std::shared_ptr<Thumbnailer> thumbnailer = m_thumbnailer.lock()) {
+        thumbnailer->cancel();
+    }
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+}
+
+void SeekPreview::onSheetDone(quint64 generation, ThumbnailResult result, QImage sheet)
+{
+    if (generation != m_generation) {
+        return;
+    }
+    if (m_thread != nullptr) {
+        m_thread->wait();
+        delete m_thread;
+        m_thread = nullptr;
+    }
+    if (result.isSuccess == false) {
+        qWarning() << "No seek preview for" << m_source << ":" << result.error.data();
+        return;
+    }
+    qInfo() << "Seek preview of" << m_source << ":" << result.frames << "frames in"
+            << result.elapsed / GST_MSECOND << "ms";
+
+    m_sheet = sheet;
+    m_sheetTileWidth = result.tileWidth;
+    m_sheetTileHeight = result.tileHeight;
+    m_sheetTileCount = result.frames;
+    m_isSheetChanged = true;
+    Q_EMIT readyChanged();
+    update();
+}
+
+int SeekPreview::getTileIndex()
+{
+    if (m_sheetTileCount <= 0) {
+        return -1;
+    }
+    // Tile i shows the middle of [i, i + 1) / count
+    return std::clamp(static_cast<int>(std::floor(m_position * m_sheetTileCount)), 0,
+                      m_sheetTileCount - 1);
+}
+
+QSGNode *SeekPreview::updatePaintNode(QSGNode *node, UpdatePaintNodeData *)
+{
+    auto *imageNode = static_cast<QSGImageNode *>(node);
+    if (m_sheet.isNull()) {
+        delete imageNode;
+        m_isSheetChanged = false;
+        return nullptr;
+    }
+    if (imageNode == nullptr) {
+        imageNode = window()->createImageNode();
+        imageNode->setFiltering(QSGTexture::Linear);
+        imageNode->setOwnsTexture(true);
+    }
+    if (m_isSheetChanged) {
+        // The only upload: the position picks a tile of the same texture
+        imageNode->setTexture(window()->createTextureFromImage(m_sheet));
+        m_isSheetChanged = false;
+    }
+
+    int index = getTileIndex();
+    int column = index % SheetColumns;
+    int row = index / SheetColumns;
+    imageNode->setSourceRect(QRectF(column * m_sheetTileWidth, row * m_sheetTileHeight,
+                                    m_sheetTileWidth, m_sheetTileHeight));
+    imageNode->setRect(boundingRect());
+    return imageNode;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <QImage>
+#include <QQuickItem>
+#include <QString>
+#include <QThread>
+#include <QtQml/qqmlregistration.h>
+#include <memory>
+#include "thumbnailer.hpp"
+
+class SeekPreview : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QString source READ getSource WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(float position READ getPosition WRITE setPosition NOTIFY positionChanged)
+    Q_PROPERTY(int tileCount READ getTileCount WRITE setTileCount)
+    Q_PROPERTY(int tileWidth READ getTileWidth WRITE setTileWidth)
+    Q_PROPERTY(float ratio READ getRatio NOTIFY readyChanged)
+    Q_PROPERTY(bool ready READ isReady NOTIFY readyChanged)
+    QML_ELEMENT
+
+public:
+    SeekPreview();
+    ~SeekPreview();
+
+    QString getSource();
+    // Media URI, the sprite sheet is generated in the background once set
+    void setSource(QString source);
+    float getPosition();
+    // Shows the tile nearest to position, in percent of the duration (0 to 1)
+    void setPosition(float percent);
+    int getTileCount();
+    // Frames spread over the duration, applied from the next source
+    void setTileCount(int count);
+    int getTileWidth();
+    void setTileWidth(int width);
+    float getRatio();
+    bool isReady();
+
+    QSGNode *updatePaintNode(QSGNode *node, UpdatePaintNodeData *) override;
+
+    static constexpr int DefaultTileCount = 100;
+    static constexpr int DefaultTileWidth = 160;
+    static constexpr int SheetColumns = 10;
+
+Q_SIGNALS:
+    void sourceChanged();
+    void positionChanged();
+    void readyChanged();
+
+protected Q_SLOTS:
+    void applyPowerPolicy();
+
+protected:
+    void start();
+    void stop();
+    void onSheetDone(quint64 generation, ThumbnailResult result, QImage sheet);
+    int getTileIndex();
+
+private:
+    QString m_source;
+    float m_position;
+    int m_tileCount;
+    int m_tileWidth;
+    // Sheet of the current source, columns of tiles from the top-left corner
+    QImage m_sheet;
+    int m_sheetTileWidth;
+    int m_sheetTileHeight;
+    int m_sheetTileCount;
+    bool m_isSheetChanged;
+    // Deferred until the power policy allows decoding thumbnails again
+    bool m_isDeferred;
+    quint64 m_generation;
+    QThread *m_thread;
+    // Owned by the worker thread, which also releases it
+    std::weak_ptr<Thumbnailer> m_thumbnailer;
+};
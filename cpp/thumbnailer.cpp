@@ -0,0 +1,485 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "thumbnailer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// Decodes the video stream only: audio and subtitle streams are not exposed nor decoded
+constexpr std::string_view PipelineCaps = "video/x-raw(ANY)";
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			Thumbnailer Class
+ *
+ * @remarks 		Takes thumbnails (single frame or contact sheet) of media files without Qt: frames are
+ *                  drawn by EglTextureRenderer into a framebuffer object when a GL context is
+ *                  given, converted on the CPU from the player's system memory frames otherwise,
+ *                  then encoded by the GStreamer image encoders.
+ *
+ **************************************************************************************************************/
+
+Thumbnailer::Thumbnailer(EGLDisplay eglDisplay, EGLContext eglContext,
+                         const ThumbnailOptions &options)
+    : m_options(options), m_isGl(eglContext != EGL_NO_CONTEXT)
+{
+    m_options.columns = std::max(m_options.columns, 1);
+    m_options.rows = std::max(m_options.rows, 1);
+    m_options.width = std::max(m_options.width, 1);
+
+    m_player = std::make_unique<GstPlayer>(eglDisplay, eglContext);
+    m_player->setListener(this);
+    if (m_isGl) {
+        m_renderer.init();
+    }
+}
+
+Thumbnailer::~Thumbnailer()
+{
+    // Joins the player worker, no notification comes after this
+    m_player.reset();
+    releaseSheet();
+    if (m_isGl) {
+        m_renderer.release();
+    }
+}
+
+ThumbnailResult Thumbnailer::take(const std::string &path, const std::string &output)
+{
+    GstClockTime start = gst_util_get_timestamp();
+    GError *uriError = nullptr;
+    gchar *uri = gst_filename_to_uri(path.data(), &uriError);
+    if (uri == nullptr) {
+        ThumbnailResult result;
+        result.error = uriError->message;
+        g_clear_error(&uriError);
+        return result;
+    }
+    ThumbnailResult result = render(uri);
+    g_free(uri);
+
+    if (result.isSuccess) {
+        result.isSuccess = encode(output, result.error);
+    }
+    releaseSheet();
+    result.elapsed = gst_util_get_timestamp() - start;
+    return result;
+}
+
+ThumbnailResult Thumbnailer::render(const std::string &uri)
+{
+    ThumbnailResult result;
+    GstClockTime start = gst_util_get_timestamp();
+    releaseSheet();
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_isPrerollDone = false;
+        m_commandsDone.clear();
+    }
+
+    m_player->setPipeline("uridecodebin uri=\"" + uri + "\" caps=\"" + std::string(PipelineCaps)
+                          + "\" expose-all-streams=false "
+                          + "! identity name=" + std::string(GstPlayer::PipelinePlaceholder));
+
+    bool isSuccess = waitCommand(GstPlayerCommand::Load, result.error)
+            && waitPreroll(result.error);
+
+    int count = m_options.columns * m_options.rows;
+    for (int i = 0; isSuccess && i < count; i++) {
+        if (m_isCancelled) {
+            result.error = "cancelled";
+            isSuccess = false;
+            break;
+        }
+        // Contact sheet frames at the middle of equal parts of the duration
+        float percent = (count == 1) ? m_options.atPercent : (i + 0.5f) / count;
+        isSuccess = acquireFrame(percent, result.error);
+
+        if (isSuccess && i == 0) {
+            // Tile size from the visible region of the first frame
+            int frameWidth = m_player->getWidth();
+            int frameHeight = m_player->getHeight();
+            float crop[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+            if (m_isGl) {
+                GstPlayer::Texture texture = m_player->getTexture();
+                std::copy(std::begin(texture.crop), std::end(texture.crop), crop);
+            } else {
+                GstPlayer::Frame frame = m_player->getFrame();
+                std::copy(std::begin(frame.crop), std::end(frame.crop), crop);
+                frameWidth = GST_VIDEO_INFO_WIDTH(&frame.info);
+                frameHeight = GST_VIDEO_INFO_HEIGHT(&frame.info);
+            }
+            int tileHeight = m_options.width * 9 / 16;
+            if (frameWidth > 0 && frameHeight > 0) {
+                float ratio = (frameWidth * crop[2]) / (frameHeight * crop[3]);
+                // Frames drawn on the GPU are shown upright
+                if (m_isGl && m_player->getRotation() % 180 != 0) {
+                    ratio = 1.0f / ratio;
+                }
+                tileHeight = std::max(1, static_cast<int>(std::lround(m_options.width / ratio)));
+            }
+            isSuccess = allocateSheet(m_options.width, tileHeight, result.error);
+        }
+        if (isSuccess) {
+            isSuccess = m_isGl ? drawTile(i, result.error) : copyTile(i, result.error);
+            result.frames += isSuccess ? 1 : 0;
+        }
+    }
+
+    if (isSuccess && m_isGl) {
+        readSheet();
+    }
+
+    // The next load releases the pipeline anyway, the frames are dropped right away
+    std::string stopError;
+    m_player->deinit();
+    waitCommand(GstPlayerCommand::Stop, stopError);
+    result.isSuccess = isSuccess;
+    result.width = m_sheetWidth;
+    result.height = m_sheetHeight;
+    result.tileWidth = m_tileWidth;
+    result.tileHeight = m_tileHeight;
+    result.elapsed = gst_util_get_timestamp() - start;
+    if (isSuccess == false) {
+        releaseSheet();
+    }
+    return result;
+}
+
+void Thumbnailer::cancel()
+{
+    // Wakes up the current wait, under the lock so that it cannot be missed
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_isCancelled = true;
+    m_condition.notify_all();
+}
+
+void Thumbnailer::onNewFrame()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_condition.notify_all();
+}
+
+void Thumbnailer::onPrerollDone()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_isPrerollDone = true;
+    m_condition.notify_all();
+}
+
+void Thumbnailer::onCommandDone(GstPlayerCommand command, bool success)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_commandsDone.push_back({ command, success });
+    m_condition.notify_all();
+}
+
+bool Thumbnailer::waitCommand(GstPlayerCommand command, std::string &error)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    auto isDone = [this, command]() {
+        return m_isCancelled
+                || std::any_of(m_commandsDone.begin(), m_commandsDone.end(),
+                               [command](const CommandDone &done) {
+                                   return done.command == command;
+                               });
+    };
+    if (m_condition.wait_for(lock, std::chrono::nanoseconds(m_options.timeout), isDone) == false) {
+        error = "timed out";
+        return false;
+    }
+    if (m_isCancelled) {
+        error = "cancelled";
+        return false;
+    }
+    auto it = std::find_if(m_commandsDone.begin(), m_commandsDone.end(),
+                           [command](const CommandDone &done) { return done.command == command; });
+    bool success = it->success;
+    m_commandsDone.erase(it);
+    if (success == false) {
+        error = (command == GstPlayerCommand::Load) ? "cannot load pipeline" : "command failed";
+    }
+    return success;
+}
+
+bool Thumbnailer::waitPreroll(std::string &error)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (m_condition.wait_for(lock, std::chrono::nanoseconds(m_options.timeout),
+                             [this]() { return m_isPrerollDone || m_isCancelled; })
+        == false) {
+        error = "timed out waiting for preroll, no video stream or no decoder";
+        return false;
+    }
+    if (m_isCancelled) {
+        error = "cancelled";
+        return false;
+    }
+    return true;
+}
+
+bool Thumbnailer::waitFrame(guint64 generation, std::string &error)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (m_condition.wait_for(lock, std::chrono::nanoseconds(m_options.timeout),
+                             [this, generation]() {
+                                 return m_player->getFrameGeneration() > generation
+                                         || m_isCancelled;
+                             })
+        == false) {
+        error = "timed out waiting for a frame";
+        return false;
+    }
+    if (m_isCancelled) {
+        error = "cancelled";
+        return false;
+    }
+    return true;
+}
+
+bool Thumbnailer::acquireFrame(float percent, std::string &error)
+{
+    // Seeks in paused state, so that no frame is handed over before the seek is done. Streams
+    // without duration cannot seek: the next frame is taken instead.
+    if (percent >= 0.0f) {
+        std::string seekError;
+        m_player->seekToPercent(std::min(percent, 1.0f), m_options.keyFramesOnly);
+        waitCommand(GstPlayerCommand::Seek, seekError);
+    }
+    guint64 generation = m_player->getFrameGeneration();
+    m_player->play();
+    bool isSuccess = waitCommand(GstPlayerCommand::Play, error) && waitFrame(generation, error);
+    m_player->pause();
+    std::string pauseError;
+    waitCommand(GstPlayerCommand::Pause, pauseError);
+    return isSuccess;
+}
+
+bool Thumbnailer::allocateSheet(int tileWidth, int tileHeight, std::string &error)
+{
+    m_tileWidth = tileWidth;
+    m_tileHeight = tileHeight;
+    m_sheetWidth = tileWidth * m_options.columns;
+    m_sheetHeight = tileHeight * m_options.rows;
+    m_sheet.assign(static_cast<size_t>(m_sheetWidth) * m_sheetHeight * 4, 0);
+    // Letterboxed tiles leave opaque black borders
+    for (size_t i = 3; i < m_sheet.size(); i += 4) {
+        m_sheet[i] = 0xff;
+    }
+    if (m_isGl == false) {
+        return true;
+    }
+
+    glGenTextures(1, &m_sheetTexture);
+    glBindTexture(GL_TEXTURE_2D, m_sheetTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_sheetWidth, m_sheetHeight, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_sheetTexture,
+                           0);
+    bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (isComplete) {
+        glViewport(0, 0, m_sheetWidth, m_sheetHeight);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (isComplete == false) {
+        error = "incomplete framebuffer";
+    }
+    return isComplete;
+}
+
+bool Thumbnailer::drawTile(int index, std::string &error)
+{
+    // The frame's buffer is held until the tile is drawn
+    GstPlayer::Texture texture = m_player->getTexture();
+    if (texture.id == GL_INVALID_ID) {
+        error = "no texture";
+        return false;
+    }
+
+    // Tiles from the top-left corner, drawFrame() puts the texture row 0 at the top
+    int x = (index % m_options.columns) * m_tileWidth;
+    int y = m_sheetHeight - (index / m_options.columns + 1) * m_tileHeight;
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(x, y, m_tileWidth, m_tileHeight);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, m_tileWidth, m_tileHeight);
+    m_renderer.drawFrame(texture, m_player->getWidth(), m_player->getHeight(), m_tileWidth,
+                         m_tileHeight, m_player->getRotation(), m_player->isFlipped());
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // The decoder may reuse the buffer once released
+    glFinish();
+    return true;
+}
+
+bool Thumbnailer::copyTile(int index, std::string &error)
+{
+    GstPlayer::Frame frame = m_player->getFrame();
+    if (frame.buffer == nullptr) {
+        error = "no frame";
+        return false;
+    }
+    if (frame.modifier != 0) {
+        error = "tiled dma-buf frames need the EGL path";
+        return false;
+    }
+
+    int width = 0;
+    int height = 0;
+    getContentSize(GST_VIDEO_INFO_WIDTH(&frame.info), GST_VIDEO_INFO_HEIGHT(&frame.info),
+                   frame.crop, width, height);
+
+    // Crop meta, conversion and scaling in one pass
+    GstCaps *caps = gst_video_info_to_caps(&frame.info);
+    GstSample *sample = gst_sample_new(frame.buffer, caps, nullptr, nullptr);
+    gst_caps_unref(caps);
+    GstCaps *rgbaCaps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, "RGBA",
+                                            "width", G_TYPE_INT, width, "height", G_TYPE_INT,
+                                            height, "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+                                            nullptr);
+    GError *convertError = nullptr;
+    GstSample *converted =
+            gst_video_convert_sample(sample, rgbaCaps, m_options.timeout, &convertError);
+    gst_caps_unref(rgbaCaps);
+    gst_sample_unref(sample);
+    if (converted == nullptr) {
+        error = (convertError != nullptr) ? convertError->message : "cannot convert frame";
+        g_clear_error(&convertError);
+        return false;
+    }
+
+    GstVideoInfo info;
+    GstVideoFrame videoFrame;
+    bool isMapped = gst_video_info_from_caps(&info, gst_sample_get_caps(converted))
+            && gst_video_frame_map(&videoFrame, &info, gst_sample_get_buffer(converted),
+                                   GST_MAP_READ);
+    if (isMapped) {
+        // Centered in the tile
+        int x = (index % m_options.columns) * m_tileWidth + (m_tileWidth - width) / 2;
+        int y = (index / m_options.columns) * m_tileHeight + (m_tileHeight - height) / 2;
+        auto *pixels = static_cast<const guint8 *>(GST_VIDEO_FRAME_PLANE_DATA(&videoFrame, 0));
+        gint stride = GST_VIDEO_FRAME_PLANE_STRIDE(&videoFrame, 0);
+        int rows = std::min(height, GST_VIDEO_FRAME_HEIGHT(&videoFrame));
+        int columns = std::min(width, GST_VIDEO_FRAME_WIDTH(&videoFrame));
+        for (int row = 0; row < rows; row++) {
+            std::memcpy(&m_sheet[(static_cast<size_t>(y + row) * m_sheetWidth + x) * 4],
+                        pixels + static_cast<size_t>(row) * stride, columns * 4);
+        }
+        gst_video_frame_unmap(&videoFrame);
+    } else {
+        error = "cannot map converted frame";
+    }
+    gst_sample_unref(converted);
+    return isMapped;
+}
+
+void Thumbnailer::readSheet()
+{
+    // Bottom row first in GL
+    std::vector<guint8> pixels(m_sheet.size());
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_sheetWidth, m_sheetHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    size_t rowSize = static_cast<size_t>(m_sheetWidth) * 4;
+    for (int row = 0; row < m_sheetHeight; row++) {
+        std::memcpy(&m_sheet[row * rowSize], &pixels[(m_sheetHeight - 1 - row) * rowSize],
+                    rowSize);
+    }
+}
+
+bool Thumbnailer::encode(const std::string &output, std::string &error)
+{
+    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, m_sheet.size(), nullptr);
+    gst_buffer_fill(buffer, 0, m_sheet.data(), m_sheet.size());
+    GstCaps *caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, "RGBA", "width",
+                                        G_TYPE_INT, m_sheetWidth, "height", G_TYPE_INT,
+                                        m_sheetHeight, "framerate", GST_TYPE_FRACTION, 0, 1,
+                                        "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, nullptr);
+    GstSample *sample = gst_sample_new(buffer, caps, nullptr, nullptr);
+    gst_buffer_unref(buffer);
+    gst_caps_unref(caps);
+
+    // pngenc or webpenc, picked by the conversion pipeline
+    std::string imageCaps = "image/" + m_options.format;
+    GstCaps *encodedCaps = gst_caps_from_string(imageCaps.data());
+    GError *encodeError = nullptr;
+    GstSample *encoded =
+            gst_video_convert_sample(sample, encodedCaps, m_options.timeout, &encodeError);
+    gst_caps_unref(encodedCaps);
+    gst_sample_unref(sample);
+    if (encoded == nullptr) {
+        error = (encodeError != nullptr) ? std::string(encodeError->message)
+                                         : "cannot encode " + imageCaps;
+        g_clear_error(&encodeError);
+        return false;
+    }
+
+    GstMapInfo map;
+    bool isWritten = false;
+    if (gst_buffer_map(gst_sample_get_buffer(encoded), &map, GST_MAP_READ)) {
+        GError *writeError = nullptr;
+        isWritten = g_file_set_contents(output.data(), reinterpret_cast<const gchar *>(map.data),
+                                        map.size, &writeError);
+        if (isWritten == false) {
+            error = writeError->message;
+            g_clear_error(&writeError);
+        }
+        gst_buffer_unmap(gst_sample_get_buffer(encoded), &map);
+    } else {
+        error = "cannot map encoded image";
+    }
+    gst_sample_unref(encoded);
+    return isWritten;
+}
+
+void Thumbnailer::releaseSheet()
+{
+    if (m_framebuffer != 0) {
+        glDeleteFramebuffers(1, &m_framebuffer);
+        m_framebuffer = 0;
+    }
+    if (m_sheetTexture != 0) {
+        glDeleteTextures(1, &m_sheetTexture);
+        m_sheetTexture = 0;
+    }
+    m_sheet.clear();
+    m_sheet.shrink_to_fit();
+    m_sheetWidth = 0;
+    m_sheetHeight = 0;
+    m_tileWidth = 0;
+    m_tileHeight = 0;
+}
+
+void Thumbnailer::getContentSize(int frameWidth, int frameHeight, const float crop[4], int &width,
+                                 int &height)
+{
+    width = m_tileWidth;
+    height = m_tileHeight;
+    if (frameWidth <= 0 || frameHeight <= 0) {
+        return;
+    }
+    float videoRatio = (frameWidth * crop[2]) / (frameHeight * crop[3]);
+    float tileRatio = static_cast<float>(m_tileWidth) / m_tileHeight;
+    if (videoRatio > tileRatio) {
+        height = std::max(1, static_cast<int>(std::lround(m_tileWidth / videoRatio)));
+    } else {
+        width = std::max(1, static_cast<int>(std::lround(m_tileHeight * videoRatio)));
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "egltexturerenderer.hpp"
+#include "gstplayer.hpp"
+
+struct ThumbnailOptions
+{
+    // Width of each frame of the thumbnail, the height follows the video aspect ratio
+    int width = 320;
+    // Contact sheet of columns x rows frames spread over the duration, 1 x 1 for a single frame
+    int columns = 1;
+    int rows = 1;
+    // Position of a single frame, -1 for the first frame
+    float atPercent = -1.0f;
+    // Decode key frames only when seeking, faster but less accurate positions
+    bool keyFramesOnly = true;
+    // "png" or "webp", encoded by the GStreamer image encoders
+    std::string format = "png";
+    // Per step (load, seek, frame), files taking longer are reported as failed
+    GstClockTime timeout = 10 * GST_SECOND;
+};
+
+struct ThumbnailResult
+{
+    bool isSuccess = false;
+    std::string error;
+    int width = 0;
+    int height = 0;
+    int tileWidth = 0;
+    int tileHeight = 0;
+    int frames = 0;
+    // Load to encoded image
+    GstClockTime elapsed = 0;
+};
+
+class Thumbnailer : public GstPlayerListener
+{
+public:
+    // With EGL_NO_CONTEXT frames are scaled on the CPU, otherwise they are drawn by
+    // EglTextureRenderer in eglContext, which must be current in the calling thread.
+    Thumbnailer(EGLDisplay eglDisplay, EGLContext eglContext, const ThumbnailOptions &options);
+    ~Thumbnailer();
+    Thumbnailer(const Thumbnailer &) = delete;
+    Thumbnailer &operator=(const Thumbnailer &) = delete;
+
+    // Blocking, writes the thumbnail of the media file at path to output
+    ThumbnailResult take(const std::string &path, const std::string &output);
+    // Blocking, draws the thumbnail of uri into getPixels(), kept until the next call
+    ThumbnailResult render(const std::string &uri);
+    // RGBA, top row first, tiles from the top-left corner row by row
+    const std::vector<guint8> &getPixels() { return m_sheet; }
+    // From any thread: render() gives up without waiting for the player, and so do the next
+    // calls
+    void cancel();
+
+    // Inherited from GstPlayerListener
+    void onNewFrame() override;
+    void onPrerollDone() override;
+    void onCommandDone(GstPlayerCommand command, bool success) override;
+
+protected:
+    bool waitCommand(GstPlayerCommand command, std::string &error);
+    bool waitPreroll(std::string &error);
+    bool waitFrame(guint64 generation, std::string &error);
+    bool acquireFrame(float percent, std::string &error);
+    bool allocateSheet(int tileWidth, int tileHeight, std::string &error);
+    bool drawTile(int index, std::string &error);
+    bool copyTile(int index, std::string &error);
+    void readSheet();
+    bool encode(const std::string &output, std::string &error);
+    void releaseSheet();
+    // Largest size of the cropped frame fitting in a tile
+    void getContentSize(int frameWidth, int frameHeight, const float crop[4], int &width,
+                        int &height);
+
+private:
+    ThumbnailOptions m_options;
+    bool m_isGl;
+    std::atomic<bool> m_isCancelled = false;
+    std::unique_ptr<GstPlayer> m_player;
+    EglTextureRenderer m_renderer;
+
+    // Contact sheet, drawn in a framebuffer object then read into m_sheet, or composed in m_sheet
+    int m_sheetWidth = 0;
+    int m_sheetHeight = 0;
+    int m_tileWidth = 0;
+    int m_tileHeight = 0;
+    GLuint m_framebuffer = 0;
+    GLuint m_sheetTexture = 0;
+    // RGBA, top row first
+    std::vector<guint8> m_sheet;
+
+    // Notifications of the player, waited for by take()
+    std::mutex m_lock;
+    std::condition_variable m_condition;
+    bool m_isPrerollDone = false;
+    struct CommandDone
+    {
+        GstPlayerCommand command;
+        bool success;
+    };
+    std::vector<CommandDone> m_commandsDone;
+};
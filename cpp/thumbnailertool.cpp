@@ -0,0 +1,326 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mediaprobe.hpp"
+#include "thumbnailer.hpp"
+
+namespace {
+// Hardware decoders run a limited number of instances in parallel
+constexpr int DefaultMaxJobs = 4;
+
+struct Job
+{
+    std::string path;
+    std::string output;
+};
+
+// One display for all workers, each worker owns a context
+struct EglSetup
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLConfig config = nullptr;
+    bool isSurfaceless = false;
+};
+
+bool hasExtension(const char *extensions, const char *name)
+{
+    if (extensions == nullptr) {
+        return false;
+    }
+    size_t length = std::strlen(name);
+    for (const char *it = std::strstr(extensions, name); it != nullptr;
+         it = std::strstr(it + length, name)) {
+        if ((it == extensions || it[-1] == ' ') && (it[length] == ' ' || it[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool initEgl(EglSetup &egl)
+{
+    // No window system needed on servers with EGL_MESA_platform_surfaceless, the default display
+    // otherwise (Vivante fbdev, Wayland or X11 session)
+    const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr
+        && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        egl.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY,
+                                         nullptr);
+    }
+    if (egl.display == EGL_NO_DISPLAY) {
+        egl.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (egl.display == EGL_NO_DISPLAY || eglInitialize(egl.display, nullptr, nullptr) == EGL_FALSE
+        || eglBindAPI(EGL_OPENGL_ES_API) == EGL_FALSE) {
+        return false;
+    }
+
+    // Contexts are made current without surface when possible, with a small pbuffer otherwise
+    egl.isSurfaceless = hasExtension(eglQueryString(egl.display, EGL_EXTENSIONS),
+                                     "EGL_KHR_surfaceless_context");
+    const EGLint attributes[] = { EGL_RENDERABLE_TYPE,
+                                  EGL_OPENGL_ES2_BIT,
+                                  EGL_SURFACE_TYPE,
+                                  egl.isSurfaceless ? 0 : EGL_PBUFFER_BIT,
+                                  EGL_RED_SIZE,
+                                  8,
+                                  EGL_GREEN_SIZE,
+                                  8,
+                                  EGL_BLUE_SIZE,
+                                  8,
+                                  EGL_NONE };
+    EGLint count = 0;
+    if (eglChooseConfig(egl.display, attributes, &egl.config, 1, &count) == EGL_FALSE
+        || count == 0) {
+        eglTerminate(egl.display);
+        egl.display = EGL_NO_DISPLAY;
+        return false;
+    }
+    return true;
+}
+
+void runWorker(const EglSetup &egl, const ThumbnailOptions &options, const std::vector<Job> &jobs,
+               std::atomic<size_t> &next, std::atomic<int> &failures, std::atomic<int> &frames,
+               std::atomic<int> &stoppedWorkers)
+{
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (egl.display != EGL_NO_DISPLAY) {
+        const EGLint contextAttributes[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+        const EGLint surfaceAttributes[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+        context = eglCreateContext(egl.display, egl.config, EGL_NO_CONTEXT, contextAttributes);
+        if (context != EGL_NO_CONTEXT && egl.isSurfaceless == false) {
+            surface = eglCreatePbufferSurface(egl.display, egl.config, surfaceAttributes);
+        }
+        if (context == EGL_NO_CONTEXT
+            || eglMakeCurrent(egl.display, surface, surface, context) == EGL_FALSE) {
+            // Not a file failure: the files are left to the other workers
+            g_print("Cannot create EGL context, worker stopped\n");
+            if (context != EGL_NO_CONTEXT) {
+                if (surface != EGL_NO_SURFACE) {
+                    eglDestroySurface(egl.display, surface);
+                }
+                eglDestroyContext(egl.display, context);
+            }
+            stoppedWorkers += 1;
+            return;
+        }
+    }
+
+    {
+        Thumbnailer thumbnailer(egl.display, context, options);
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            ThumbnailResult result = thumbnailer.take(jobs[i].path, jobs[i].output);
+            double elapsedMs = static_cast<double>(result.elapsed) / GST_MSECOND;
+            if (result.isSuccess) {
+                frames += result.frames;
+                g_print("%s: %dx%d, %d frame(s) in %.1f ms (%.1f fps)\n", jobs[i].path.data(),
+                        result.width, result.height, result.frames, elapsedMs,
+                        result.frames * 1000.0 / std::max(elapsedMs, 1.0));
+            } else {
+                failures += 1;
+                g_print("%s: failed after %.1f ms: %s\n", jobs[i].path.data(), elapsedMs,
+                        result.error.data());
+            }
+        }
+    }
+
+    if (context != EGL_NO_CONTEXT) {
+        eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE) {
+            eglDestroySurface(egl.display, surface);
+        }
+        eglDestroyContext(egl.display, context);
+    }
+}
+
+// Media files of the inputs, directories are scanned recursively. Outputs keep the tree of each
+// input directory below the output directory, named after the file and its extension. Files of
+// different inputs with the same relative path get a numbered output instead of overwriting.
+std::vector<Job> collectJobs(gchar **inputs, const std::filesystem::path &outputDir,
+                             const std::string &format)
+{
+    std::vector<std::string> filters = MediaProbe::getVideoNameFilters();
+    auto isMedia = [&filters](const std::filesystem::path &path) {
+        gchar *name = g_ascii_strdown(path.filename().c_str(), -1);
+        bool isMatch = std::any_of(filters.begin(), filters.end(), [name](const std::string &f) {
+            return g_pattern_match_simple(f.data(), name);
+        });
+        g_free(name);
+        return isMatch;
+    };
+
+    std::vector<Job> jobs;
+    std::error_code error;
+    for (gchar **input = inputs; input != nullptr && *input != nullptr; input++) {
+        std::filesystem::path root(*input);
+        if (std::filesystem::is_directory(root, error) == false) {
+            std::filesystem::path output = outputDir / root.filename();
+            jobs.push_back({ root.string(), output.string() });
+            continue;
+        }
+        std::filesystem::recursive_directory_iterator it(
+                root, std::filesystem::directory_options::skip_permission_denied, error);
+        for (; it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            if (it->is_regular_file(error) && isMedia(it->path())) {
+                std::filesystem::path output =
+                        outputDir / std::filesystem::relative(it->path(), root, error);
+                jobs.push_back({ it->path().string(), output.string() });
+            }
+        }
+    }
+    std::sort(jobs.begin(), jobs.end(),
+              [](const Job &a, const Job &b) { return a.path < b.path; });
+    // The same file given twice, or through an input and its parent directory
+    jobs.erase(std::unique(jobs.begin(), jobs.end(),
+                           [](const Job &a, const Job &b) { return a.path == b.path; }),
+               jobs.end());
+
+    std::set<std::string> outputs;
+    for (Job &job : jobs) {
+        std::string output = job.output + "." + format;
+        int index = 1;
+        while (outputs.insert(output).second == false) {
+            output = job.output + "-" + std::to_string(++index) + "." + format;
+        }
+        if (index > 1) {
+            g_print("%s: same output as another file, written to %s\n", job.path.data(),
+                    output.data());
+        }
+        job.output = output;
+    }
+    return jobs;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    gchar *outputDir = nullptr;
+    gchar *grid = nullptr;
+    gchar *format = nullptr;
+    gint width = ThumbnailOptions().width;
+    gdouble atPercent = -1.0;
+    gint jobCount = 0;
+    gint timeoutSec = 10;
+    gboolean isSoftware = FALSE;
+    gboolean isAccurate = FALSE;
+    gchar **inputs = nullptr;
+    GOptionEntry entries[] = {
+        { "output", 'o', 0, G_OPTION_ARG_FILENAME, &outputDir,
+          "Output directory (default: thumbnails)", "DIR" },
+        { "width", 'w', 0, G_OPTION_ARG_INT, &width, "Width of each frame (default: 320)", "PX" },
+        { "grid", 'g', 0, G_OPTION_ARG_STRING, &grid,
+          "Contact sheet of COLUMNSxROWS frames (default: 1x1)", "CxR" },
+        { "at", 'a', 0, G_OPTION_ARG_DOUBLE, &atPercent,
+          "Position of a single frame, 0 to 1 (default: first frame)", "RATIO" },
+        { "format", 'f', 0, G_OPTION_ARG_STRING, &format, "png or webp (default: png)", "FORMAT" },
+        { "jobs", 'j', 0, G_OPTION_ARG_INT, &jobCount,
+          "Parallel pipelines (default: CPU count, at most 4)", "N" },
+        { "timeout", 't', 0, G_OPTION_ARG_INT, &timeoutSec,
+          "Seconds per load, seek or frame before a file fails (default: 10)", "SEC" },
+        { "software", 's', 0, G_OPTION_ARG_NONE, &isSoftware,
+          "Scale frames on the CPU instead of drawing them with EGL", nullptr },
+        { "accurate", 0, 0, G_OPTION_ARG_NONE, &isAccurate,
+          "Decode the frames up to each position, not only key frames", nullptr },
+        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &inputs, nullptr,
+          "DIR|FILE..." },
+        { nullptr }
+    };
+
+    GError *error = nullptr;
+    GOptionContext *optionContext = g_option_context_new("- precompute media thumbnails");
+    g_option_context_add_main_entries(optionContext, entries, nullptr);
+    bool isParsed = g_option_context_parse(optionContext, &argc, &argv, &error);
+    g_option_context_free(optionContext);
+    if (isParsed == false || inputs == nullptr) {
+        g_print("%s\n", error != nullptr ? error->message : "No input, see --help");
+        g_clear_error(&error);
+        return 1;
+    }
+
+    ThumbnailOptions options;
+    options.width = std::max(width, 16);
+    options.atPercent = static_cast<float>(atPercent);
+    options.keyFramesOnly = (isAccurate == FALSE);
+    options.format = (format != nullptr) ? format : "png";
+    options.timeout = std::max(timeoutSec, 1) * GST_SECOND;
+    if (grid != nullptr && sscanf(grid, "%dx%d", &options.columns, &options.rows) != 2) {
+        g_print("Invalid grid %s, expected COLUMNSxROWS\n", grid);
+        return 1;
+    }
+    if (options.format != "png" && options.format != "webp") {
+        g_print("Unsupported format %s\n", options.format.data());
+        return 1;
+    }
+
+    std::string output = (outputDir != nullptr) ? outputDir : "thumbnails";
+    std::vector<Job> jobs = collectJobs(inputs, output, options.format);
+    std::error_code directoryError;
+    for (const Job &job : jobs) {
+        std::filesystem::create_directories(std::filesystem::path(job.output).parent_path(),
+                                            directoryError);
+    }
+
+    EglSetup egl;
+    if (isSoftware == FALSE && initEgl(egl) == false) {
+        g_print("No EGL display, frames are scaled on the CPU\n");
+    }
+    if (jobCount <= 0) {
+        jobCount = std::min<int>(std::max(1u, std::thread::hardware_concurrency()),
+                                 DefaultMaxJobs);
+    }
+    jobCount = std::min<int>(jobCount, std::max<size_t>(jobs.size(), 1));
+    g_print("%zu file(s), %d worker(s), %s\n", jobs.size(), jobCount,
+            egl.display != EGL_NO_DISPLAY ? (egl.isSurfaceless ? "surfaceless EGL" : "EGL pbuffer")
+                                           : "software");
+
+    GstClockTime start = gst_util_get_timestamp();
+    std::atomic<size_t> next(0);
+    std::atomic<int> failures(0);
+    std::atomic<int> frames(0);
+    std::atomic<int> stoppedWorkers(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobCount; i++) {
+        workers.emplace_back(runWorker, std::cref(egl), std::cref(options), std::cref(jobs),
+                             std::ref(next), std::ref(failures), std::ref(frames),
+                             std::ref(stoppedWorkers));
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    double elapsedSec = static_cast<double>(gst_util_get_timestamp() - start) / GST_SECOND;
+
+    g_print("%zu file(s), %d failed, %d frame(s) in %.2f s: %.1f files/s, %.1f frames/s\n",
+            jobs.size(), failures.load(), frames.load(), elapsedSec,
+            jobs.size() / std::max(elapsedSec, 0.001), frames.load() / std::max(elapsedSec, 0.001));
+    // Files never taken when every worker stopped
+    size_t skipped = jobs.size() - std::min(next.load(), jobs.size());
+    if (stoppedWorkers > 0) {
+        g_print("%d worker(s) stopped, %zu file(s) skipped\n", stoppedWorkers.load(), skipped);
+    }
+
+    if (egl.display != EGL_NO_DISPLAY) {
+        eglTerminate(egl.display);
+    }
+    g_strfreev(inputs);
+    g_free(outputDir);
+    g_free(grid);
+    g_free(format);
+    return (failures == 0 && stoppedWorkers == 0) ? 0 : 1;
+}
@@ -0,0 +1,392 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "videoconverter.hpp"
+#include <array>
+#include <string_view>
+
+namespace {
+struct ConverterCandidate
+{
+    std::string_view factory;
+    bool afterUpload;
+};
+
+// Candidates, in order of preference when the input format cannot be benchmarked
+constexpr std::array<ConverterCandidate, 6> Candidates = { {
+        { "", false }, // glupload imports the decoded frames directly
+        { "imxvideoconvert_g2d", false },
+        { "imxvideoconvert_pxp", false },
+        { "v4l2convert", false },
+        { "glcolorconvert", true },
+        { "videoconvert", false },
+} };
+
+// The renderer samples a single RGB texture (2D or external-oes)
+constexpr std::string_view OutputCaps =
+        "video/x-raw(memory:GLMemory), format=(string){ RGBA, BGRA, RGBx, BGRx }";
+
+// Formats glupload alone turns into such a texture, whatever the memory
+constexpr std::string_view RgbCaps = "video/x-raw, format=(string){ RGBA, BGRA, RGBx, BGRx }";
+
+// Imported by glupload without copy, as an external-oes texture for YUV formats
+constexpr std::string_view DmaBufFeature = "memory:DMABuf";
+
+constexpr std::string_view DirectUpload = "none";
+constexpr std::string_view CacheGroup = "converters";
+constexpr int BenchmarkFrames = 60;
+constexpr GstClockTime BenchmarkTimeout = 10 * GST_SECOND;
+// Interval at which a running benchmark checks whether the selector is being destroyed
+constexpr GstClockTime BenchmarkPollInterval = 100 * GST_MSECOND;
+
+bool isDmaBuf(GstCaps *caps)
+{
+    GstCapsFeatures *features = gst_caps_get_features(caps, 0);
+    return features != nullptr && gst_caps_features_contains(features, DmaBufFeature.data());
+}
+
+// True if caps, in any memory, intersect RgbCaps
+bool isRgb(GstCaps *caps)
+{
+    GstCaps *plain = gst_caps_copy(caps);
+    gst_caps_set_features_simple(plain, nullptr);
+    GstCaps *rgb = gst_caps_from_string(RgbCaps.data());
+    bool isMatch = gst_caps_can_intersect(plain, rgb) != FALSE;
+    gst_caps_unref(rgb);
+    gst_caps_unref(plain);
+    return isMatch;
+}
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			VideoConverterSelector Class
+ *
+ * @remarks 		Chooses the color converter placed before the appsink for each decoded format.
+ *                  Converters available in the registry are benchmarked once per format and
+ *                  resolution on a worker thread, and the winner is cached on disk.
+ *
+ **************************************************************************************************************/
+
+VideoConverterSelector &VideoConverterSelector::instance()
+{
+    static VideoConverterSelector selector;
+    return selector;
+}
+
+VideoConverterSelector::VideoConverterSelector() : m_inputCaps(nullptr), m_isStopping(false)
+{
+    gchar *path = g_build_filename(g_get_user_cache_dir(), "imx-video-to-texture",
+                                   "converters.ini", nullptr);
+    m_cachePath = path;
+    g_free(path);
+
+    probe();
+    loadCache();
+    m_worker = std::thread(&VideoConverterSelector::runBenchmarks, this);
+}
+
+VideoConverterSelector::~VideoConverterSelector()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+    m_worker.join();
+    for (PendingBenchmark &pending : m_pending) {
+        gst_caps_unref(pending.caps);
+    }
+    gst_caps_unref(m_inputCaps);
+}
+
+GstCaps *VideoConverterSelector::getInputCaps()
+{
+    return gst_caps_ref(m_inputCaps);
+}
+
+GstCaps *VideoConverterSelector::getOutputCaps()
+{
+    return gst_caps_from_string(OutputCaps.data());
+}
+
+VideoConverterSelector::Converter VideoConverterSelector::select(GstCaps *caps)
+{
+    // Benchmark input: same format and resolution in system memory
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    const gchar *format = gst_structure_get_string(structure, "format");
+    gint width = 0;
+    gint height = 0;
+    gst_structure_get_int(structure, "width", &width);
+    gst_structure_get_int(structure, "height", &height);
+    if (format == nullptr || width <= 0 || height <= 0) {
+        return Converter { "", false };
+    }
+
+    // Frames of hardware decoders: the system memory benchmark cannot measure their zero-copy
+    // import, which no converter beats
+    if (isDmaBuf(caps)) {
+        for (const Converter &converter : m_available) {
+            if (converter.factory.empty()) {
+                return converter;
+            }
+        }
+    }
+
+    GstCaps *input = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, format, "width",
+                                         G_TYPE_INT, width, "height", G_TYPE_INT, height,
+                                         "framerate", GST_TYPE_FRACTION, 30, 1, nullptr);
+
+    // Frames in other memory than the system memory of the benchmark are cached apart
+    std::string key =
+            std::string(format) + "-" + std::to_string(width) + "x" + std::to_string(height);
+    GstCapsFeatures *features = gst_caps_get_features(caps, 0);
+    if (features != nullptr && gst_caps_features_is_any(features) == FALSE
+        && gst_caps_features_is_equal(features, GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY)
+                == FALSE) {
+        gchar *name = gst_caps_features_to_string(features);
+        key += std::string("-") + name;
+        g_free(name);
+    }
+
+    // Until the benchmark is done, and for formats that cannot be generated for the benchmark
+    // (e.g. tiled decoder output): the first converter turning the frames into a texture the
+    // appsink accepts
+    Converter selected = { "", false };
+    for (const Converter &converter : m_available) {
+        if (isSupported(converter, caps)) {
+            selected = converter;
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    // Cached winner, if still available on this system
+    auto cached = m_cache.find(key);
+    if (cached != m_cache.end()) {
+        for (const Converter &converter : m_available) {
+            if (converter.factory == cached->second
+                || (converter.factory.empty() && cached->second == DirectUpload)) {
+                gst_caps_unref(input);
+                return converter;
+            }
+        }
+    }
+    if (m_queued.insert(key).second) {
+        m_pending.push_back({ key, input });
+        m_condition.notify_one();
+    } else {
+        gst_caps_unref(input);
+    }
+    return selected;
+}
+
+void VideoConverterSelector::runBenchmarks()
+{
+    while (true) {
+        PendingBenchmark pending;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_condition.wait(lock, [this]() { return m_isStopping || m_pending.empty() == false; });
+            if (m_isStopping) {
+                return;
+            }
+            pending = m_pending.front();
+            m_pending.pop_front();
+        }
+
+        // Without the lock: players keep negotiating meanwhile
+        const Converter *best = nullptr;
+        const Converter *fallback = nullptr;
+        gint64 bestTime = -1;
+        for (const Converter &converter : m_available) {
+            if (m_isStopping || isSupported(converter, pending.caps) == false) {
+                continue;
+            }
+            if (fallback == nullptr) {
+                fallback = &converter;
+            }
+            gint64 time = benchmark(converter, pending.caps);
+            std::string result = (time < 0) ? "failed" : std::to_string(time) + " us";
+            g_print("Converter %s for %s: %s\n",
+                    converter.factory.empty() ? DirectUpload.data() : converter.factory.data(),
+                    pending.key.data(), result.data());
+            if (time >= 0 && (best == nullptr || time < bestTime)) {
+                best = &converter;
+                bestTime = time;
+            }
+        }
+        gst_caps_unref(pending.caps);
+
+        if (best == nullptr) {
+            best = fallback;
+        }
+        if (best == nullptr || m_isStopping) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_cache[pending.key] = best->factory.empty() ? std::string(DirectUpload) : best->factory;
+        saveCache();
+    }
+}
+
+void VideoConverterSelector::probe()
+{
+    m_inputCaps = gst_caps_new_empty();
+    for (const ConverterCandidate &candidate : Candidates) {
+        const gchar *name = candidate.factory.empty() ? "glupload" : candidate.factory.data();
+        GstElementFactory *factory = gst_element_factory_find(name);
+        if (factory == nullptr) {
+            continue;
+        }
+        m_available.push_back({ std::string(candidate.factory), candidate.afterUpload });
+
+        // Converters after glupload accept what glupload does
+        if (candidate.afterUpload == false) {
+            const GList *templates = gst_element_factory_get_static_pad_templates(factory);
+            for (const GList *item = templates; item != nullptr; item = item->next) {
+                auto *padTemplate = static_cast<GstStaticPadTemplate *>(item->data);
+                if (padTemplate->direction == GST_PAD_SINK) {
+                    m_inputCaps = gst_caps_merge(m_inputCaps,
+                                                 gst_static_pad_template_get_caps(padTemplate));
+                }
+            }
+        }
+        gst_object_unref(GST_OBJECT(factory));
+    }
+}
+
+bool VideoConverterSelector::isSupported(const Converter &converter, GstCaps *caps)
+{
+    // Converters after glupload get whatever glupload accepts
+    const gchar *name = (converter.factory.empty() || converter.afterUpload)
+            ? "glupload"
+            : converter.factory.data();
+    GstElementFactory *factory = gst_element_factory_find(name);
+    if (factory == nullptr) {
+        return false;
+    }
+    bool supported = gst_element_factory_can_sink_any_caps(factory, caps) != FALSE;
+
+    // The chain must also end with a single RGB texture: glcolorconvert always outputs one,
+    // glupload alone only for RGB frames and imported dma-bufs, and converters before glupload
+    // when they can output RGB
+    if (supported && converter.afterUpload == false) {
+        if (converter.factory.empty()) {
+            supported = isRgb(caps) || isDmaBuf(caps);
+        } else {
+            supported = false;
+            const GList *templates = gst_element_factory_get_static_pad_templates(factory);
+            for (const GList *item = templates; item != nullptr && supported == false;
+                 item = item->next) {
+                auto *padTemplate = static_cast<GstStaticPadTemplate *>(item->data);
+                if (padTemplate->direction == GST_PAD_SRC) {
+                    GstCaps *templateCaps = gst_static_pad_template_get_caps(padTemplate);
+                    supported = isRgb(templateCaps);
+                    gst_caps_unref(templateCaps);
+                }
+            }
+        }
+    }
+    gst_object_unref(GST_OBJECT(factory));
+    return supported;
+}
+
+gint64 VideoConverterSelector::benchmark(const Converter &converter, GstCaps *caps)
+{
+    // Same path as the video sink bin, from raw frames to a single RGB texture
+    std::string description = "videotestsrc num-buffers=" + std::to_string(BenchmarkFrames)
+            + " ! capsfilter name=input ! ";
+    if (converter.factory.empty()) {
+        description += "glupload";
+    } else if (converter.afterUpload) {
+        description += "glupload ! " + converter.factory;
+    } else {
+        description += converter.factory + " ! glupload";
+    }
+    description += " ! capsfilter name=output ! fakesink sync=false";
+
+    GError *error = nullptr;
+    GstElement *pipeline = gst_parse_launch(description.data(), &error);
+    if (error != nullptr) {
+        g_clear_error(&error);
+        if (pipeline != nullptr) {
+            gst_object_unref(GST_OBJECT(pipeline));
+        }
+        return -1;
+    }
+
+    GstElement *input = gst_bin_get_by_name(GST_BIN(pipeline), "input");
+    GstElement *output = gst_bin_get_by_name(GST_BIN(pipeline), "output");
+    GstCaps *outputCaps = getOutputCaps();
+    g_object_set(input, "caps", caps, nullptr);
+    g_object_set(output, "caps", outputCaps, nullptr);
+    gst_caps_unref(outputCaps);
+    gst_object_unref(GST_OBJECT(input));
+    gst_object_unref(GST_OBJECT(output));
+
+    gint64 elapsed = -1;
+    gint64 start = g_get_monotonic_time();
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE) {
+        GstBus *bus = gst_element_get_bus(pipeline);
+        // Given up when the selector is destroyed, not to hold the application exit
+        GstClockTime waited = 0;
+        GstMessage *msg = nullptr;
+        while (msg == nullptr && waited < BenchmarkTimeout && m_isStopping == false) {
+            msg = gst_bus_timed_pop_filtered(
+                    bus, BenchmarkPollInterval,
+                    (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+            waited += BenchmarkPollInterval;
+        }
+        if (msg != nullptr) {
+            if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS) {
+                elapsed = (g_get_monotonic_time() - start) / BenchmarkFrames;
+            }
+            gst_message_unref(msg);
+        }
+        gst_object_unref(GST_OBJECT(bus));
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(GST_OBJECT(pipeline));
+    return elapsed;
+}
+
+void VideoConverterSelector::loadCache()
+{
+    GKeyFile *file = g_key_file_new();
+    if (g_key_file_load_from_file(file, m_cachePath.data(), G_KEY_FILE_NONE, nullptr)) {
+        gchar **keys = g_key_file_get_keys(file, CacheGroup.data(), nullptr, nullptr);
+        for (gchar **key = keys; key != nullptr && *key != nullptr; key++) {
+            gchar *value = g_key_file_get_string(file, CacheGroup.data(), *key, nullptr);
+            if (value != nullptr) {
+                m_cache[*key] = value;
+                g_free(value);
+            }
+        }
+        g_strfreev(keys);
+    }
+    g_key_file_free(file);
+}
+
+void VideoConverterSelector::saveCache()
+{
+    GKeyFile *file = g_key_file_new();
+    for (const auto &[key, value] : m_cache) {
+        g_key_file_set_string(file, CacheGroup.data(), key.data(), value.data());
+    }
+
+    gchar *directory = g_path_get_dirname(m_cachePath.data());
+    g_mkdir_with_parents(directory, 0755);
+    g_free(directory);
+
+    GError *error = nullptr;
+    if (g_key_file_save_to_file(file, m_cachePath.data(), &error) == FALSE) {
+        g_print("Cannot save converter cache: %s\n", error->message);
+        g_clear_error(&error);
+    }
+    g_key_file_free(file);
+}
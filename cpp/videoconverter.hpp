@@ -0,0 +1,69 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class VideoConverterSelector
+{
+public:
+    struct Converter
+    {
+        // Element factory name, empty when glupload imports the frames directly
+        std::string factory;
+        // Converter working on GL memory, inserted after glupload
+        bool afterUpload;
+    };
+
+    static VideoConverterSelector &instance();
+
+    // Never blocks on a benchmark: formats not benchmarked yet get the first converter accepting
+    // them while the benchmark runs in the background, the next streams get the fastest one.
+    Converter select(GstCaps *caps);
+    // Formats accepted by any of the converters (or by glupload directly)
+    GstCaps *getInputCaps();
+    GstCaps *getOutputCaps();
+
+protected:
+    VideoConverterSelector();
+    ~VideoConverterSelector();
+
+    void probe();
+    bool isSupported(const Converter &converter, GstCaps *caps);
+    void runBenchmarks();
+    gint64 benchmark(const Converter &converter, GstCaps *caps);
+    void loadCache();
+    void saveCache();
+
+private:
+    std::vector<Converter> m_available;
+    GstCaps *m_inputCaps;
+    std::map<std::string, std::string> m_cache;
+    std::string m_cachePath;
+    std::mutex m_lock;
+
+    struct PendingBenchmark
+    {
+        std::string key;
+        GstCaps *caps = nullptr;
+    };
+    // Formats waiting for their benchmark, and those already queued during this run
+    std::deque<PendingBenchmark> m_pending;
+    std::set<std::string> m_queued;
+    std::condition_variable m_condition;
+    std::atomic<bool> m_isStopping;
+    std::thread m_worker;
+};
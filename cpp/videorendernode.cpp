@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 NXP
+ * Copyright (C) 2017 The Qt Company Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "videorendernode.hpp"
+#include <algorithm>
+
+/**************************************************************************************************************
+ *
+ * @brief  			VideoRenderNode Class
+ *
+ * @remarks 		QSGRenderNode base Class of the video renderers: keeps the geometry of the frame
+ *                  in the item (crop, rotation, flip, letterboxing) common to all graphics APIs
+ *
+ **************************************************************************************************************/
+
+QRectF VideoRenderNode::rect() const
+{
+    return QRect(0, 0, m_width, m_height);
+}
+
+void VideoRenderNode::setSize(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    updateGeometry();
+}
+
+void VideoRenderNode::setTextureSize(int width, int height)
+{
+    if (m_textureWidth != width || m_textureHeight != height) {
+        m_textureWidth = width;
+        m_textureHeight = height;
+        updateGeometry();
+    }
+}
+
+void VideoRenderNode::setFrameTransform(const QRectF &crop, int rotation, bool isFlipped,
+                                        const QMatrix4x4 &transform)
+{
+    m_transform = transform;
+    if (m_frameCrop != crop || m_frameRotation != rotation || m_isFlipped != isFlipped) {
+        m_frameCrop = crop;
+        m_frameRotation = rotation;
+        m_isFlipped = isFlipped;
+        updateGeometry();
+    }
+}
+
+QMatrix4x4 VideoRenderNode::getItemTransform()
+{
+    // Around the center of the quad, item coordinates are top-down
+    QMatrix4x4 transform;
+    if (m_transform.isIdentity() == false && m_width > 0 && m_height > 0) {
+        QMatrix4x4 toNdc;
+        toNdc.scale(2.0f / m_width, -2.0f / m_height);
+        toNdc.translate(-0.5f * m_width, -0.5f * m_height);
+        transform = toNdc.inverted() * m_transform * toNdc;
+    }
+    return transform;
+}
+
+void VideoRenderNode::setViewport(const QRectF &crop, int rotation, bool isLetterbox)
+{
+    m_viewCrop = crop;
+    m_viewRotation = rotation;
+    m_isLetterbox = isLetterbox;
+    updateGeometry();
+}
+
+void VideoRenderNode::updateGeometry()
+{
+    // Texture coordinates of the top-left, top-right, bottom-left and bottom-right corners: undo
+    // the rotation, then the flip, then map into the visible region of the texture.
+    int rotation = (((m_frameRotation + m_viewRotation) % 360) + 360) % 360;
+    const std::array<QPointF, 4> corners = { m_viewCrop.topLeft(), m_viewCrop.topRight(),
+                                             m_viewCrop.bottomLeft(), m_viewCrop.bottomRight() };
+    for (size_t i = 0; i < corners.size(); i++) {
+        QPointF p = corners[i];
+        switch (rotation) {
+        case 90:
+            p = QPointF(p.y(), 1.0 - p.x());
+            break;
+        case 180:
+            p = QPointF(1.0 - p.x(), 1.0 - p.y());
+            break;
+        case 270:
+            p = QPointF(1.0 - p.y(), p.x());
+            break;
+        default:
+            break;
+        }
+        if (m_isFlipped) {
+            p.setX(1.0 - p.x());
+        }
+        m_texcoords[2 * i] = m_frameCrop.x() + p.x() * m_frameCrop.width();
+        m_texcoords[2 * i + 1] = m_frameCrop.y() + p.y() * m_frameCrop.height();
+    }
+
+    // Letterbox: largest rectangle with the aspect ratio of the visible region
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = m_width;
+    float height = m_height;
+    if (m_isLetterbox && m_textureWidth > 0 && m_textureHeight > 0 && m_width > 0
+        && m_height > 0) {
+        float videoWidth = m_textureWidth * m_frameCrop.width();
+        float videoHeight = m_textureHeight * m_frameCrop.height();
+        if (rotation % 180 != 0) {
+            std::swap(videoWidth, videoHeight);
+        }
+        videoWidth *= m_viewCrop.width();
+        videoHeight *= m_viewCrop.height();
+        if (videoWidth > 0.0f && videoHeight > 0.0f) {
+            float scale = std::min(m_width / videoWidth, m_height / videoHeight);
+            width = videoWidth * scale;
+            height = videoHeight * scale;
+            x = 0.5f * (m_width - width);
+            y = 0.5f * (m_height - height);
+        }
+    }
+    m_vertices = { x, y, x + width - 1.0f, y, x, y + height - 1.0f, x + width - 1.0f,
+                   y + height - 1.0f };
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <QSGRenderNode>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QImage>
+#include <QRectF>
+#include <array>
+#include <vector>
+#include "glfilterchain.hpp"
+#include "glframeexporter.hpp"
+#include "gstplayer.hpp"
+
+class VideoRenderNode : public QSGRenderNode
+{
+public:
+    // Inherited from QSGRenderNode
+    QRectF rect() const override;
+
+    void setSize(int width, int height);
+    virtual void setTextureSize(int width, int height);
+    // Frame geometry: crop in texture coordinates, clockwise rotation in degrees, horizontal flip
+    // applied before the rotation, and affine transformation in normalized device coordinates
+    void setFrameTransform(const QRectF &crop, int rotation, bool isFlipped,
+                           const QMatrix4x4 &transform);
+    // Region of the rotated frame to show, normalized, additional clockwise rotation and aspect
+    // ratio preservation
+    void setViewport(const QRectF &crop, int rotation, bool isLetterbox);
+    bool isFirstRenderDone() { return m_isFirstRenderDone; }
+    // Time the latest render() of this node took in the rendering thread, in nanoseconds
+    qint64 getRenderTime() { return m_renderTime; }
+
+    // Picks up the latest frame of the player, in the rendering thread. Returns its generation.
+    virtual guint64 updateFrame(GstPlayer *player) = 0;
+    // Keeps showing the last rendered frame after the player is released
+    virtual void holdFrame() { }
+    virtual void setOffscreen(bool isOffscreen) { }
+    // Features below are only available with some graphics APIs
+    virtual void setFilters(const std::vector<GlFilterChain::Filter> &filters) { }
+    virtual void setFrameExport(GlFrameExporter::Callback callback, int width = 0,
+                                int height = 0)
+    {
+    }
+    virtual void requestFrameExport() { }
+    // Delivers the exported frames the GPU is done with, true while others are still in flight
+    virtual bool collectFrameExports() { return false; }
+    // Copy of the current frame, before filters and geometry, in CPU memory. Scaled down to the
+    // item size.
+    virtual QImage grabImage() { return QImage(); }
+    // Shows an image grabbed earlier until the next frame
+    virtual void setImage(const QImage &image) { }
+    // Releases the resources tied to the current frame, keeps the pipelines and programs
+    virtual void releaseFrameResources() { }
+
+protected:
+    void updateGeometry();
+    // Affine transformation of the frame in item coordinates
+    QMatrix4x4 getItemTransform();
+
+    // Declared first in render(): measures it into m_renderTime
+    class RenderTimer
+    {
+    public:
+        explicit RenderTimer(VideoRenderNode *node) : m_node(node) { m_timer.start(); }
+        ~RenderTimer() { m_node->m_renderTime = m_timer.nsecsElapsed(); }
+
+    private:
+        VideoRenderNode *m_node;
+        QElapsedTimer m_timer;
+    };
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_textureWidth = 0;
+    int m_textureHeight = 0;
+    // Top-left, top-right, bottom-left and bottom-right corners, in item coordinates
+    std::array<float, 4 * 2> m_vertices = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+    std::array<float, 4 * 2> m_texcoords = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+    QRectF m_frameCrop = QRectF(0.0, 0.0, 1.0, 1.0);
+    QRectF m_viewCrop = QRectF(0.0, 0.0, 1.0, 1.0);
+    int m_frameRotation = 0;
+    int m_viewRotation = 0;
+    bool m_isFlipped = false;
+    bool m_isLetterbox = false;
+    QMatrix4x4 m_transform;
+    bool m_isFirstRenderDone = false;
+    qint64 m_renderTime = 0;
+};
@@ -0,0 +1,1111 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "vktexturerenderer.hpp"
+#include <QFile>
+#include <QSGRendererInterface>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+#include <rhi/qshader.h>
+#else
+#include <QtGui/private/qshader_p.h>
+#endif
+#include <gst/allocators/gstdmabuf.h>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char *const DmaBufExtensions[] = {
+    "VK_KHR_external_memory_fd",
+    "VK_EXT_external_memory_dma_buf",
+    "VK_EXT_image_drm_format_modifier",
+};
+const char *const ForeignQueueExtension = "VK_EXT_queue_family_foreign";
+const char *const YcbcrExtension = "VK_KHR_sampler_ycbcr_conversion";
+
+// Formats of the frame caps, DMA_DRM caps are resolved to them by the player
+struct FormatMapping
+{
+    GstVideoFormat videoFormat;
+    VkFormat format;
+    VkComponentMapping components;
+};
+
+const VkComponentMapping IdentityMapping = {
+    VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+    VK_COMPONENT_SWIZZLE_IDENTITY
+};
+const VkComponentMapping OpaqueMapping = { VK_COMPONENT_SWIZZLE_IDENTITY,
+                                           VK_COMPONENT_SWIZZLE_IDENTITY,
+                                           VK_COMPONENT_SWIZZLE_IDENTITY,
+                                           VK_COMPONENT_SWIZZLE_ONE };
+
+const FormatMapping Formats[] = {
+    { GST_VIDEO_FORMAT_NV12, VK_FORMAT_G8_B8R8_2PLANE_420_UNORM, IdentityMapping },
+    { GST_VIDEO_FORMAT_BGRA, VK_FORMAT_B8G8R8A8_UNORM, IdentityMapping },
+    { GST_VIDEO_FORMAT_BGRx, VK_FORMAT_B8G8R8A8_UNORM, OpaqueMapping },
+    { GST_VIDEO_FORMAT_RGBA, VK_FORMAT_R8G8B8A8_UNORM, IdentityMapping },
+    { GST_VIDEO_FORMAT_RGBx, VK_FORMAT_R8G8B8A8_UNORM, OpaqueMapping },
+};
+
+const FormatMapping *findFormat(GstVideoFormat videoFormat)
+{
+    for (const FormatMapping &mapping : Formats) {
+        if (mapping.videoFormat == videoFormat) {
+            return &mapping;
+        }
+    }
+    return nullptr;
+}
+
+bool isYcbcrFormat(VkFormat format)
+{
+    return format == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+}
+
+bool hasExtension(const std::vector<VkExtensionProperties> &extensions, const char *name)
+{
+    for (const VkExtensionProperties &extension : extensions) {
+        if (strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+/**************************************************************************************************************
+ *
+ * @brief  			VkTextureRenderer Class
+ *
+ * @remarks 		Vulkan counterpart of GlTextureRenderer, used when the scene graph runs on the
+ *                  Vulkan RHI backend. The player hands frames over without GL upload: dma-bufs
+ *                  are imported as VkImages with their DRM format modifier, other frames are copied
+ *                  through a staging buffer. NV12 is sampled with a YCbCr conversion, so no color
+ *                  conversion pass is needed. Upload commands are recorded in prepare(), outside
+ *                  of the render pass, and the quad is drawn in render().
+ *
+ *                  Objects the GPU may still use are retired with the frame count and destroyed
+ *                  once all frames in flight have completed.
+ *
+ **************************************************************************************************************/
+
+VkTextureRenderer::VkTextureRenderer(QQuickWindow *window) : m_window(window)
+{
+    gst_video_info_init(&m_pendingInfo);
+}
+
+VkTextureRenderer::~VkTextureRenderer()
+{
+    releaseResources();
+}
+
+QByteArrayList VkTextureRenderer::getDeviceExtensions()
+{
+    QByteArrayList extensions;
+    for (const char *name : DmaBufExtensions) {
+        extensions.append(name);
+    }
+    extensions.append(ForeignQueueExtension);
+    // Promoted to Vulkan 1.1, requested for 1.0 devices
+    extensions.append(YcbcrExtension);
+    return extensions;
+}
+
+bool VkTextureRenderer::initResources()
+{
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    QVulkanInstance *instance = reinterpret_cast<QVulkanInstance *>(
+            rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
+    VkPhysicalDevice *physicalDevice = static_cast<VkPhysicalDevice *>(
+            rif->getResource(m_window, QSGRendererInterface::PhysicalDeviceResource));
+    VkDevice *device = static_cast<VkDevice *>(
+            rif->getResource(m_window, QSGRendererInterface::DeviceResource));
+    uint32_t *queueFamily = static_cast<uint32_t *>(
+            rif->getResource(m_window, QSGRendererInterface::GraphicsQueueFamilyIndexResource));
+    if (instance == nullptr || physicalDevice == nullptr || device == nullptr
+        || queueFamily == nullptr) {
+        qWarning() << "Vulkan resources of the scene graph are not available";
+        return false;
+    }
+    m_physicalDevice = *physicalDevice;
+    m_device = *device;
+    m_queueFamily = *queueFamily;
+    m_functions = instance->functions();
+    m_deviceFunctions = instance->deviceFunctions(m_device);
+
+    // Extensions enabled by the scene graph among the requested ones, assumed supported
+    uint32_t count = 0;
+    m_functions->vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    m_functions->vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &count,
+                                                      extensions.data());
+    m_isDmaBufImport = true;
+    for (const char *name : DmaBufExtensions) {
+        m_isDmaBufImport = m_isDmaBufImport && hasExtension(extensions, name);
+    }
+    m_isForeignQueue = hasExtension(extensions, ForeignQueueExtension);
+
+    PFN_vkGetDeviceProcAddr getDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(
+            instance->getInstanceProcAddr("vkGetDeviceProcAddr"));
+    m_getMemoryFdProperties = reinterpret_cast<PFN_vkGetMemoryFdPropertiesKHR>(
+            getDeviceProcAddr(m_device, "vkGetMemoryFdPropertiesKHR"));
+    m_isDmaBufImport = m_isDmaBufImport && m_getMemoryFdProperties != nullptr;
+
+    // Core in Vulkan 1.1, extension before
+    m_createYcbcrConversion = reinterpret_cast<PFN_vkCreateSamplerYcbcrConversion>(
+            getDeviceProcAddr(m_device, "vkCreateSamplerYcbcrConversion"));
+    m_destroyYcbcrConversion = reinterpret_cast<PFN_vkDestroySamplerYcbcrConversion>(
+            getDeviceProcAddr(m_device, "vkDestroySamplerYcbcrConversion"));
+    if (m_createYcbcrConversion == nullptr) {
+        m_createYcbcrConversion = reinterpret_cast<PFN_vkCreateSamplerYcbcrConversion>(
+                getDeviceProcAddr(m_device, "vkCreateSamplerYcbcrConversionKHR"));
+        m_destroyYcbcrConversion = reinterpret_cast<PFN_vkDestroySamplerYcbcrConversion>(
+                getDeviceProcAddr(m_device, "vkDestroySamplerYcbcrConversionKHR"));
+    }
+    PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 =
+            reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+                    instance->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2"));
+    if (getFeatures2 == nullptr) {
+        getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+                instance->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2KHR"));
+    }
+    m_isYcbcr = false;
+    if (m_createYcbcrConversion != nullptr && getFeatures2 != nullptr) {
+        VkPhysicalDeviceSamplerYcbcrConversionFeatures ycbcrFeatures = {};
+        ycbcrFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &ycbcrFeatures;
+        getFeatures2(m_physicalDevice, &features);
+        m_isYcbcr = ycbcrFeatures.samplerYcbcrConversion == VK_TRUE;
+    }
+    qInfo() << "Vulkan video renderer, dma-buf import:" << m_isDmaBufImport
+            << "YCbCr sampling:" << m_isYcbcr;
+
+    m_vertexShader = loadShader(QStringLiteral(":/shaders/vktexture.vert.qsb"));
+    m_fragmentShader = loadShader(QStringLiteral(":/shaders/vktexture.frag.qsb"));
+    if (m_vertexShader == VK_NULL_HANDLE || m_fragmentShader == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    // One combined image sampler per frame in flight and format
+    const uint32_t maxSets = 8 * QSGRendererInterface::MaxFramesInFlight;
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxSets * 3 };
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.maxSets = maxSets;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (m_deviceFunctions->vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool)
+        != VK_SUCCESS) {
+        qWarning() << "Cannot create Vulkan descriptor pool";
+        return false;
+    }
+
+    m_staging.resize(m_window->graphicsStateInfo().framesInFlight);
+    return true;
+}
+
+VkShaderModule VkTextureRenderer::loadShader(const QString &name)
+{
+    QFile file(name);
+    if (file.open(QIODevice::ReadOnly) == false) {
+        qWarning() << "Cannot open shader" << name;
+        return VK_NULL_HANDLE;
+    }
+    QShader shader = QShader::fromSerialized(file.readAll());
+    QByteArray code = shader.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader();
+    if (code.isEmpty()) {
+        qWarning() << "No SPIR-V code in shader" << name;
+        return VK_NULL_HANDLE;
+    }
+
+    VkShaderModuleCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = code.size();
+    info.pCode = reinterpret_cast<const uint32_t *>(code.constData());
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (m_deviceFunctions->vkCreateShaderModule(m_device, &info, nullptr, &module) != VK_SUCCESS) {
+        qWarning() << "Cannot create shader module" << name;
+        return VK_NULL_HANDLE;
+    }
+    return module;
+}
+
+guint64 VkTextureRenderer::updateFrame(GstPlayer *player)
+{
+    GstPlayer::Frame frame = player->getFrame();
+    if (frame.buffer != nullptr && frame.buffer != m_pendingBuffer
+        && frame.buffer != m_currentBuffer) {
+        // Kept until prepare() has recorded the upload, the player may replace it meanwhile
+        if (m_pendingBuffer != nullptr) {
+            gst_buffer_unref(m_pendingBuffer);
+        }
+        m_pendingBuffer = gst_buffer_ref(frame.buffer);
+        m_pendingInfo = frame.info;
+        m_pendingModifier = frame.modifier;
+    }
+
+    if (frame.buffer != nullptr) {
+        setTextureSize(GST_VIDEO_INFO_WIDTH(&frame.info), GST_VIDEO_INFO_HEIGHT(&frame.info));
+        setFrameTransform(QRectF(frame.crop[0], frame.crop[1], frame.crop[2], frame.crop[3]),
+                          player->getRotation(), player->isFlipped(),
+                          QMatrix4x4(frame.transform).transposed());
+    }
+    return frame.generation;
+}
+
+void VkTextureRenderer::prepare()
+{
+    if (m_isInitialized == false) {
+        m_isInitialized = initResources();
+        if (m_isInitialized == false) {
+            return;
+        }
+    }
+    m_frameCount++;
+    collectRetired(false);
+    if (m_pendingBuffer == nullptr) {
+        return;
+    }
+
+    GstBuffer *buffer = m_pendingBuffer;
+    m_pendingBuffer = nullptr;
+    Pipeline *pipeline = getPipeline(m_pendingInfo);
+    if (pipeline == nullptr) {
+        gst_buffer_unref(buffer);
+        return;
+    }
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    VkCommandBuffer commandBuffer = *static_cast<VkCommandBuffer *>(
+            rif->getResource(m_window, QSGRendererInterface::CommandListResource));
+    int slot = m_window->graphicsStateInfo().currentFrameSlot;
+
+    // The imported image of the previous frame goes back to the producer
+    if (m_current != nullptr && m_current->source != nullptr) {
+        transition(commandBuffer, *m_current, VK_IMAGE_LAYOUT_GENERAL, m_queueFamily,
+                   getForeignQueueFamily());
+    }
+
+    // Zero-copy when the driver imports the dma-buf, copy of the mapped frame otherwise
+    bool isDone = m_isDmaBufImport
+            && importFrame(commandBuffer, buffer, m_pendingInfo, m_pendingModifier, pipeline);
+    if (isDone == false) {
+        isDone = copyFrame(commandBuffer, buffer, m_pendingInfo, m_pendingModifier, pipeline,
+                           slot);
+    }
+    if (isDone == false) {
+        m_current = nullptr;
+        gst_buffer_unref(buffer);
+        return;
+    }
+
+    // The previous frame may still be sampled by frames in flight
+    if (m_currentBuffer != nullptr) {
+        retire(m_currentBuffer);
+    }
+    m_currentBuffer = buffer;
+}
+
+bool VkTextureRenderer::importFrame(VkCommandBuffer commandBuffer, GstBuffer *buffer,
+                                    const GstVideoInfo &info, guint64 modifier,
+                                    Pipeline *pipeline)
+{
+    // All planes in one dma-buf, as produced by the VPU and the G2D converter
+    if (gst_buffer_n_memory(buffer) != 1) {
+        return false;
+    }
+    GstMemory *memory = gst_buffer_peek_memory(buffer, 0);
+    if (gst_is_dmabuf_memory(memory) == false) {
+        return false;
+    }
+    int fd = gst_dmabuf_memory_get_fd(memory);
+    // Descriptor numbers are reused, the inode identifies the dma-buf
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        return false;
+    }
+    quint64 inode = status.st_ino;
+    int width = GST_VIDEO_INFO_WIDTH(&info);
+    int height = GST_VIDEO_INFO_HEIGHT(&info);
+
+    // Decoders recycle their buffers, the import of a previous round is still valid
+    for (auto it = m_imports.begin(); it != m_imports.end(); ++it) {
+        if (it->source == memory && it->inode == inode && it->pipeline == pipeline
+            && it->width == width && it->height == height) {
+            Image image = *it;
+            m_imports.erase(it);
+            m_imports.push_back(image);
+            m_current = &m_imports.back();
+            // The producer wrote the memory again, its writes become visible with the acquire
+            transition(commandBuffer, *m_current, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       getForeignQueueFamily(), m_queueFamily);
+            return true;
+        }
+    }
+
+    VkSubresourceLayout planeLayouts[GST_VIDEO_MAX_PLANES] = {};
+    guint planes = GST_VIDEO_INFO_N_PLANES(&info);
+    for (guint i = 0; i < planes; i++) {
+        planeLayouts[i].offset = memory->offset + GST_VIDEO_INFO_PLANE_OFFSET(&info, i);
+        planeLayouts[i].rowPitch = GST_VIDEO_INFO_PLANE_STRIDE(&info, i);
+    }
+    VkImageDrmFormatModifierExplicitCreateInfoEXT modifierInfo = {};
+    modifierInfo.sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT;
+    modifierInfo.drmFormatModifier = modifier;
+    modifierInfo.drmFormatModifierPlaneCount = planes;
+    modifierInfo.pPlaneLayouts = planeLayouts;
+    VkExternalMemoryImageCreateInfo externalInfo = {};
+    externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
+    externalInfo.pNext = &modifierInfo;
+    externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext = &externalInfo;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = pipeline->format;
+    imageInfo.extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkMemoryFdPropertiesKHR fdProperties = {};
+    fdProperties.sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR;
+    if (m_getMemoryFdProperties(m_device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT, fd,
+                                &fdProperties)
+        != VK_SUCCESS) {
+        return false;
+    }
+
+    // The allocation takes ownership of the descriptor
+    Image image;
+    image.pipeline = pipeline;
+    image.width = width;
+    image.height = height;
+    image.source = memory;
+    image.inode = inode;
+    VkImportMemoryFdInfoKHR importInfo = {};
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
+    importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+    importInfo.fd = dup(fd);
+    if (createImage(image, imageInfo, &importInfo, fdProperties.memoryTypeBits, 0) == false) {
+        if (image.memory == VK_NULL_HANDLE) {
+            close(importInfo.fd);
+        }
+        destroyImage(image);
+        g_print("Cannot import dma-buf frame (modifier 0x%" G_GINT64_MODIFIER "x), copying "
+                "frames instead\n",
+                modifier);
+        // Same format and modifier for the next frames
+        m_isDmaBufImport = false;
+        return false;
+    }
+    if (createImageView(image) == false) {
+        destroyImage(image);
+        return false;
+    }
+    // The producer already wrote the memory: the first acquire must keep the contents, which an
+    // UNDEFINED old layout allows the driver to discard. External owners use the general layout.
+    image.layout = VK_IMAGE_LAYOUT_GENERAL;
+
+    if (m_imports.size() >= MaxImportedImages) {
+        retire(m_imports.front());
+        m_imports.pop_front();
+    }
+    m_imports.push_back(image);
+    m_current = &m_imports.back();
+    transition(commandBuffer, *m_current, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+               getForeignQueueFamily(), m_queueFamily);
+    return true;
+}
+
+bool VkTextureRenderer::copyFrame(VkCommandBuffer commandBuffer, GstBuffer *buffer,
+                                  const GstVideoInfo &info, guint64 modifier, Pipeline *pipeline,
+                                  int slot)
+{
+    // Tiled or compressed layouts cannot be copied as rows
+    if (modifier != 0) {
+        g_print("Cannot copy dma-buf frame with modifier 0x%" G_GINT64_MODIFIER "x\n",
+                modifier);
+        return false;
+    }
+    GstVideoInfo mapInfo = info;
+    GstVideoFrame frame;
+    if (gst_video_frame_map(&frame, &mapInfo, buffer, GST_MAP_READ) == false) {
+        return false;
+    }
+
+    int width = GST_VIDEO_FRAME_WIDTH(&frame);
+    int height = GST_VIDEO_FRAME_HEIGHT(&frame);
+    guint planes = GST_VIDEO_FRAME_N_PLANES(&frame);
+    VkBufferImageCopy regions[GST_VIDEO_MAX_PLANES] = {};
+    gsize planeSizes[GST_VIDEO_MAX_PLANES] = {};
+    VkDeviceSize size = 0;
+    for (guint i = 0; i < planes; i++) {
+        // Component of the plane: luma then interleaved chroma for NV12, all for RGB
+        guint component = (i == 0) ? 0 : 1;
+        gint stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, i);
+        gint pixelStride = GST_VIDEO_FRAME_COMP_PSTRIDE(&frame, component);
+        gint columns = GST_VIDEO_FRAME_COMP_WIDTH(&frame, component);
+        gint rows = GST_VIDEO_FRAME_COMP_HEIGHT(&frame, component);
+        // The last row may end before the stride
+        planeSizes[i] = static_cast<gsize>(stride) * (rows - 1) + columns * pixelStride;
+        regions[i].bufferOffset = size;
+        regions[i].bufferRowLength = stride / pixelStride;
+        regions[i].imageSubresource.aspectMask = (planes == 1)
+                ? VK_IMAGE_ASPECT_COLOR_BIT
+                : static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_PLANE_0_BIT << i);
+        regions[i].imageSubresource.layerCount = 1;
+        regions[i].imageExtent = { static_cast<uint32_t>(columns), static_cast<uint32_t>(rows),
+                                   1 };
+        // Offsets are multiples of the texel size, 4 covers all formats
+        size = (size + planeSizes[i] + 3) & ~VkDeviceSize(3);
+    }
+
+    Staging &staging = m_staging[slot];
+    if (ensureStaging(staging, size) == false) {
+        gst_video_frame_unmap(&frame);
+        return false;
+    }
+    for (guint i = 0; i < planes; i++) {
+        memcpy(static_cast<guint8 *>(staging.data) + regions[i].bufferOffset,
+               GST_VIDEO_FRAME_PLANE_DATA(&frame, i), planeSizes[i]);
+    }
+    gst_video_frame_unmap(&frame);
+
+    // A single image, recreated when the format or the size changes
+    if (m_copy.image == VK_NULL_HANDLE || m_copy.pipeline != pipeline || m_copy.width != width
+        || m_copy.height != height) {
+        if (m_copy.image != VK_NULL_HANDLE) {
+            retire(m_copy);
+        }
+        m_copy = Image();
+        m_copy.pipeline = pipeline;
+        m_copy.width = width;
+        m_copy.height = height;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = pipeline->format;
+        imageInfo.extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (createImage(m_copy, imageInfo, nullptr, ~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+                    == false
+            || createImageView(m_copy) == false) {
+            destroyImage(m_copy);
+            return false;
+        }
+    }
+
+    transition(commandBuffer, m_copy, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    m_deviceFunctions->vkCmdCopyBufferToImage(commandBuffer, staging.buffer, m_copy.image,
+                                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, planes,
+                                              regions);
+    transition(commandBuffer, m_copy, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+               VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    m_current = &m_copy;
+    return true;
+}
+
+bool VkTextureRenderer::createImage(Image &image, const VkImageCreateInfo &info,
+                                    const void *allocateNext, uint32_t memoryTypeBits,
+                                    VkMemoryPropertyFlags properties)
+{
+    if (m_deviceFunctions->vkCreateImage(m_device, &info, nullptr, &image.image) != VK_SUCCESS) {
+        image.image = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    m_deviceFunctions->vkGetImageMemoryRequirements(m_device, image.image, &requirements);
+    uint32_t typeIndex = findMemoryType(requirements.memoryTypeBits & memoryTypeBits, properties);
+    if (typeIndex == UINT32_MAX) {
+        return false;
+    }
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.pNext = allocateNext;
+    dedicatedInfo.image = image.image;
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.pNext = &dedicatedInfo;
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = typeIndex;
+    if (m_deviceFunctions->vkAllocateMemory(m_device, &allocateInfo, nullptr, &image.memory)
+        != VK_SUCCESS) {
+        image.memory = VK_NULL_HANDLE;
+        return false;
+    }
+    return m_deviceFunctions->vkBindImageMemory(m_device, image.image, image.memory, 0)
+            == VK_SUCCESS;
+}
+
+bool VkTextureRenderer::createImageView(Image &image)
+{
+    // Formats without alpha read it as opaque
+    const FormatMapping *mapping = findFormat(image.pipeline->videoFormat);
+
+    VkSamplerYcbcrConversionInfo conversionInfo = {};
+    conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO;
+    conversionInfo.conversion = image.pipeline->conversion;
+    VkImageViewCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    info.pNext = (image.pipeline->conversion != VK_NULL_HANDLE) ? &conversionInfo : nullptr;
+    info.image = image.image;
+    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    info.format = image.pipeline->format;
+    info.components = mapping->components;
+    info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    return m_deviceFunctions->vkCreateImageView(m_device, &info, nullptr, &image.view)
+            == VK_SUCCESS;
+}
+
+bool VkTextureRenderer::ensureStaging(Staging &staging, VkDeviceSize size)
+{
+    if (staging.buffer != VK_NULL_HANDLE && staging.size >= size) {
+        return true;
+    }
+    // Only this slot's copy may be pending, its frame has completed
+    if (staging.buffer != VK_NULL_HANDLE) {
+        m_deviceFunctions->vkDestroyBuffer(m_device, staging.buffer, nullptr);
+        m_deviceFunctions->vkFreeMemory(m_device, staging.memory, nullptr);
+        staging = Staging();
+    }
+
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (m_deviceFunctions->vkCreateBuffer(m_device, &info, nullptr, &staging.buffer)
+        != VK_SUCCESS) {
+        staging.buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    m_deviceFunctions->vkGetBufferMemoryRequirements(m_device, staging.buffer, &requirements);
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex =
+            findMemoryType(requirements.memoryTypeBits,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                   | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (allocateInfo.memoryTypeIndex == UINT32_MAX
+        || m_deviceFunctions->vkAllocateMemory(m_device, &allocateInfo, nullptr, &staging.memory)
+                != VK_SUCCESS) {
+        m_deviceFunctions->vkDestroyBuffer(m_device, staging.buffer, nullptr);
+        staging = Staging();
+        return false;
+    }
+    m_deviceFunctions->vkBindBufferMemory(m_device, staging.buffer, staging.memory, 0);
+    // Persistently mapped, coherent memory needs no flush
+    m_deviceFunctions->vkMapMemory(m_device, staging.memory, 0, VK_WHOLE_SIZE, 0, &staging.data);
+    staging.size = size;
+    return true;
+}
+
+uint32_t VkTextureRenderer::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    m_functions->vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) != 0
+            && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+uint32_t VkTextureRenderer::getForeignQueueFamily()
+{
+    return m_isForeignQueue ? VK_QUEUE_FAMILY_FOREIGN_EXT : VK_QUEUE_FAMILY_EXTERNAL;
+}
+
+void VkTextureRenderer::transition(VkCommandBuffer commandBuffer, Image &image,
+                                   VkImageLayout layout, uint32_t srcQueueFamily,
+                                   uint32_t dstQueueFamily)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = image.layout;
+    barrier.newLayout = layout;
+    barrier.srcQueueFamilyIndex = srcQueueFamily;
+    barrier.dstQueueFamilyIndex = dstQueueFamily;
+    barrier.image = image.image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    if (layout == VK_IMAGE_LAYOUT_GENERAL) {
+        // Released to the external producer once sampled
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    } else if (srcQueueFamily != VK_QUEUE_FAMILY_IGNORED) {
+        // Acquired from the external producer, its writes are made visible
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    } else if (layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        // Previous frames may still sample the image
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    m_deviceFunctions->vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0,
+                                            nullptr, 1, &barrier);
+    image.layout = layout;
+}
+
+VkTextureRenderer::Pipeline *VkTextureRenderer::getPipeline(const GstVideoInfo &info)
+{
+    const FormatMapping *mapping = findFormat(GST_VIDEO_INFO_FORMAT(&info));
+    if (mapping == nullptr) {
+        g_print("Video format %s is not supported by the Vulkan renderer\n",
+                gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&info)));
+        return nullptr;
+    }
+
+    Pipeline key;
+    key.videoFormat = mapping->videoFormat;
+    key.format = mapping->format;
+    if (isYcbcrFormat(mapping->format)) {
+        if (m_isYcbcr == false) {
+            g_print("NV12 frames need sampler YCbCr conversion support\n");
+            return nullptr;
+        }
+        switch (GST_VIDEO_INFO_COLORIMETRY(&info).matrix) {
+        case GST_VIDEO_COLOR_MATRIX_BT601:
+            key.model = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_601;
+            break;
+        case GST_VIDEO_COLOR_MATRIX_BT2020:
+            key.model = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_2020;
+            break;
+        default:
+            key.model = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709;
+            break;
+        }
+        key.range = (GST_VIDEO_INFO_COLORIMETRY(&info).range == GST_VIDEO_COLOR_RANGE_0_255)
+                ? VK_SAMPLER_YCBCR_RANGE_ITU_FULL
+                : VK_SAMPLER_YCBCR_RANGE_ITU_NARROW;
+        GstVideoChromaSite site = GST_VIDEO_INFO_CHROMA_SITE(&info);
+        key.xChromaOffset = (site & GST_VIDEO_CHROMA_SITE_H_COSITED)
+                ? VK_CHROMA_LOCATION_COSITED_EVEN
+                : VK_CHROMA_LOCATION_MIDPOINT;
+        key.yChromaOffset = (site & GST_VIDEO_CHROMA_SITE_V_COSITED)
+                ? VK_CHROMA_LOCATION_COSITED_EVEN
+                : VK_CHROMA_LOCATION_MIDPOINT;
+    }
+
+    for (const std::unique_ptr<Pipeline> &pipeline : m_pipelines) {
+        if (pipeline->videoFormat == key.videoFormat && pipeline->model == key.model
+            && pipeline->range == key.range && pipeline->xChromaOffset == key.xChromaOffset
+            && pipeline->yChromaOffset == key.yChromaOffset) {
+            return pipeline.get();
+        }
+    }
+
+    std::unique_ptr<Pipeline> pipeline = std::make_unique<Pipeline>(key);
+    VkSamplerYcbcrConversionInfo conversionInfo = {};
+    conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO;
+    VkFilter filter = VK_FILTER_LINEAR;
+    if (isYcbcrFormat(key.format)) {
+        // Linear chroma reconstruction when the format supports it
+        VkFormatProperties properties;
+        m_functions->vkGetPhysicalDeviceFormatProperties(m_physicalDevice, key.format,
+                                                         &properties);
+        VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+        if ((features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT) == 0) {
+            filter = VK_FILTER_NEAREST;
+        }
+        // Keyed on the offsets of the caps, the driver may only support cosited samples
+        bool isMidpoint = (features & VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT) != 0;
+
+        VkSamplerYcbcrConversionCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO;
+        info.format = key.format;
+        info.ycbcrModel = key.model;
+        info.ycbcrRange = key.range;
+        info.components = IdentityMapping;
+        info.xChromaOffset = isMidpoint ? key.xChromaOffset : VK_CHROMA_LOCATION_COSITED_EVEN;
+        info.yChromaOffset = isMidpoint ? key.yChromaOffset : VK_CHROMA_LOCATION_COSITED_EVEN;
+        info.chromaFilter = filter;
+        if (m_createYcbcrConversion(m_device, &info, nullptr, &pipeline->conversion)
+            != VK_SUCCESS) {
+            g_print("Cannot create YCbCr conversion\n");
+            return nullptr;
+        }
+        conversionInfo.conversion = pipeline->conversion;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.pNext = (pipeline->conversion != VK_NULL_HANDLE) ? &conversionInfo : nullptr;
+    samplerInfo.magFilter = filter;
+    samplerInfo.minFilter = filter;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.25f;
+    m_deviceFunctions->vkCreateSampler(m_device, &samplerInfo, nullptr, &pipeline->sampler);
+
+    // Immutable sampler, required for YCbCr conversions
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    binding.pImmutableSamplers = &pipeline->sampler;
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = 1;
+    setLayoutInfo.pBindings = &binding;
+    m_deviceFunctions->vkCreateDescriptorSetLayout(m_device, &setLayoutInfo, nullptr,
+                                                   &pipeline->setLayout);
+
+    VkPushConstantRange pushRange = {};
+    pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushRange.size = sizeof(PushConstants);
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &pipeline->setLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushRange;
+    m_deviceFunctions->vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &pipeline->layout);
+
+    pipeline->sets.resize(m_window->graphicsStateInfo().framesInFlight, VK_NULL_HANDLE);
+    m_pipelines.push_back(std::move(pipeline));
+    return m_pipelines.back().get();
+}
+
+bool VkTextureRenderer::createPipeline(Pipeline &pipeline, VkRenderPass renderPass)
+{
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = m_vertexShader;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = m_fragmentShader;
+    stages[1].pName = "main";
+
+    // Corners are generated from the vertex index
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.lineWidth = 1.0f;
+    // Must match the samples of the window render target
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples =
+            static_cast<VkSampleCountFlagBits>(qMax(1, m_window->format().samples()));
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    // Premultiplied alpha, as the rest of the scene graph
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.blendEnable = VK_TRUE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+            | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.stageCount = 2;
+    info.pStages = stages;
+    info.pVertexInputState = &vertexInput;
+    info.pInputAssemblyState = &inputAssembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &rasterization;
+    info.pMultisampleState = &multisample;
+    info.pDepthStencilState = &depthStencil;
+    info.pColorBlendState = &blend;
+    info.pDynamicState = &dynamic;
+    info.layout = pipeline.layout;
+    info.renderPass = renderPass;
+    if (m_deviceFunctions->vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &info, nullptr,
+                                                     &pipeline.pipeline)
+        != VK_SUCCESS) {
+        pipeline.pipeline = VK_NULL_HANDLE;
+        qWarning() << "Cannot create Vulkan video pipeline";
+        return false;
+    }
+    return true;
+}
+
+VkDescriptorSet VkTextureRenderer::getDescriptorSet(Pipeline &pipeline, int slot)
+{
+    if (pipeline.sets[slot] == VK_NULL_HANDLE) {
+        VkDescriptorSetAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        info.descriptorPool = m_descriptorPool;
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &pipeline.setLayout;
+        if (m_deviceFunctions->vkAllocateDescriptorSets(m_device, &info, &pipeline.sets[slot])
+            != VK_SUCCESS) {
+            pipeline.sets[slot] = VK_NULL_HANDLE;
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    // The set of this slot is no longer used by the GPU
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = pipeline.sampler;
+    imageInfo.imageView = m_current->view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = pipeline.sets[slot];
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    m_deviceFunctions->vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+    return pipeline.sets[slot];
+}
+
+void VkTextureRenderer::render(const RenderState *state)
+{
+    RenderTimer timer(this);
+    if (m_isInitialized == false || m_current == nullptr) {
+        return;
+    }
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    VkCommandBuffer commandBuffer = *static_cast<VkCommandBuffer *>(
+            rif->getResource(m_window, QSGRendererInterface::CommandListResource));
+    VkRenderPass renderPass = *static_cast<VkRenderPass *>(
+            rif->getResource(m_window, QSGRendererInterface::RenderPassResource));
+    int slot = m_window->graphicsStateInfo().currentFrameSlot;
+
+    // Pipelines are tied to the render pass, which changes with the swapchain
+    if (renderPass != m_renderPass) {
+        for (std::unique_ptr<Pipeline> &pipeline : m_pipelines) {
+            if (pipeline->pipeline != VK_NULL_HANDLE) {
+                m_retired.push_back({ m_frameCount, Image(), pipeline->pipeline, nullptr });
+                pipeline->pipeline = VK_NULL_HANDLE;
+            }
+        }
+        m_renderPass = renderPass;
+    }
+    Pipeline &pipeline = *m_current->pipeline;
+    if (pipeline.pipeline == VK_NULL_HANDLE && createPipeline(pipeline, renderPass) == false) {
+        return;
+    }
+    VkDescriptorSet set = getDescriptorSet(pipeline, slot);
+    if (set == VK_NULL_HANDLE) {
+        return;
+    }
+
+    PushConstants constants;
+    QMatrix4x4 matrix = *state->projectionMatrix() * *this->matrix() * getItemTransform();
+    memcpy(constants.matrix, matrix.constData(), sizeof(constants.matrix));
+    constants.rect[0] = m_vertices[0];
+    constants.rect[1] = m_vertices[1];
+    constants.rect[2] = m_vertices[6] - m_vertices[0];
+    constants.rect[3] = m_vertices[7] - m_vertices[1];
+    memcpy(constants.texcoords, m_texcoords.data(), sizeof(constants.texcoords));
+    constants.opacity = static_cast<float>(inheritedOpacity());
+
+    const QSize size = m_window->size() * m_window->effectiveDevicePixelRatio();
+    VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(size.width()),
+                            static_cast<float>(size.height()), 0.0f, 1.0f };
+    // Scissor rectangles of the scene graph are bottom-up
+    VkRect2D scissor = { { 0, 0 },
+                         { static_cast<uint32_t>(size.width()),
+                           static_cast<uint32_t>(size.height()) } };
+    if (state->scissorEnabled()) {
+        const QRect &rect = state->scissorRect();
+        scissor.offset = { qMax(0, rect.x()), qMax(0, size.height() - rect.y() - rect.height()) };
+        scissor.extent = { static_cast<uint32_t>(qMax(0, rect.width())),
+                           static_cast<uint32_t>(qMax(0, rect.height())) };
+    }
+
+    m_deviceFunctions->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                         pipeline.pipeline);
+    m_deviceFunctions->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                               pipeline.layout, 0, 1, &set, 0, nullptr);
+    m_deviceFunctions->vkCmdPushConstants(commandBuffer, pipeline.layout,
+                                          VK_SHADER_STAGE_VERTEX_BIT
+                                                  | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                          0, sizeof(constants), &constants);
+    m_deviceFunctions->vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    m_deviceFunctions->vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    m_deviceFunctions->vkCmdDraw(commandBuffer, 4, 1, 0, 0);
+    m_isFirstRenderDone = true;
+}
+
+QSGRenderNode::StateFlags VkTextureRenderer::changedStates() const
+{
+    return BlendState | ScissorState | ViewportState;
+}
+
+QSGRenderNode::RenderingFlags VkTextureRenderer::flags() const
+{
+    // The quad stays within rect(), drawn without depth test
+    return BoundedRectRendering;
+}
+
+void VkTextureRenderer::retire(const Image &image)
+{
+    m_retired.push_back({ m_frameCount, image, VK_NULL_HANDLE, nullptr });
+}
+
+void VkTextureRenderer::retire(GstBuffer *buffer)
+{
+    m_retired.push_back({ m_frameCount, Image(), VK_NULL_HANDLE, buffer });
+}
+
+void VkTextureRenderer::collectRetired(bool isAll)
+{
+    // Frames older than the ones in flight have completed, Qt waited for their fences
+    quint64 framesInFlight = m_window->graphicsStateInfo().framesInFlight;
+    while (m_retired.empty() == false
+           && (isAll || m_retired.front().frame + framesInFlight <= m_frameCount)) {
+        Retired &retired = m_retired.front();
+        destroyImage(retired.image);
+        if (retired.pipeline != VK_NULL_HANDLE) {
+            m_deviceFunctions->vkDestroyPipeline(m_device, retired.pipeline, nullptr);
+        }
+        if (retired.buffer != nullptr) {
+            gst_buffer_unref(retired.buffer);
+        }
+        m_retired.pop_front();
+    }
+}
+
+void VkTextureRenderer::destroyImage(Image &image)
+{
+    if (image.view != VK_NULL_HANDLE) {
+        m_deviceFunctions->vkDestroyImageView(m_device, image.view, nullptr);
+    }
+    if (image.image != VK_NULL_HANDLE) {
+        m_deviceFunctions->vkDestroyImage(m_device, image.image, nullptr);
+    }
+    // Also closes the descriptor of imported memory
+    if (image.memory != VK_NULL_HANDLE) {
+        m_deviceFunctions->vkFreeMemory(m_device, image.memory, nullptr);
+    }
+    image = Image();
+}
+
+void VkTextureRenderer::destroyPipeline(Pipeline &pipeline)
+{
+    if (pipeline.pipeline != VK_NULL_HANDLE) {
+        m_deviceFunctions->vkDestroyPipeline(m_device, pipeline.pipeline, nullptr);
+    }
+    m_deviceFunctions->vkDestroyPipelineLayout(m_device, pipeline.layout, nullptr);
+    m_deviceFunctions->vkDestroyDescriptorSetLayout(m_device, pipeline.setLayout, nullptr);
+    m_deviceFunctions->vkDestroySampler(m_device, pipeline.sampler, nullptr);
+    if (pipeline.conversion != VK_NULL_HANDLE) {
+        m_destroyYcbcrConversion(m_device, pipeline.conversion, nullptr);
+    }
+    pipeline = Pipeline();
+}
+
+void VkTextureRenderer::releaseFrameResources()
+{
+    if (m_pendingBuffer != nullptr) {
+        gst_buffer_unref(m_pendingBuffer);
+        m_pendingBuffer = nullptr;
+    }
+    if (m_isInitialized == false) {
+        return;
+    }
+    // Released once the frames in flight are done
+    for (const Image &image : m_imports) {
+        retire(image);
+    }
+    m_imports.clear();
+    if (m_copy.image != VK_NULL_HANDLE) {
+        retire(m_copy);
+    }
+    m_copy = Image();
+    if (m_currentBuffer != nullptr) {
+        retire(m_currentBuffer);
+    }
+    m_currentBuffer = nullptr;
+    m_current = nullptr;
+}
+
+void VkTextureRenderer::releaseResources()
+{
+    releaseFrameResources();
+    if (m_isInitialized == false) {
+        return;
+    }
+    // Rare, after the window is gone or the node is removed
+    m_deviceFunctions->vkDeviceWaitIdle(m_device);
+    collectRetired(true);
+
+    for (Staging &staging : m_staging) {
+        if (staging.buffer != VK_NULL_HANDLE) {
+            m_deviceFunctions->vkDestroyBuffer(m_device, staging.buffer, nullptr);
+            m_deviceFunctions->vkFreeMemory(m_device, staging.memory, nullptr);
+        }
+    }
+    m_staging.clear();
+    for (std::unique_ptr<Pipeline> &pipeline : m_pipelines) {
+        destroyPipeline(*pipeline);
+    }
+    m_pipelines.clear();
+    m_deviceFunctions->vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    m_deviceFunctions->vkDestroyShaderModule(m_device, m_vertexShader, nullptr);
+    m_deviceFunctions->vkDestroyShaderModule(m_device, m_fragmentShader, nullptr);
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_vertexShader = VK_NULL_HANDLE;
+    m_fragmentShader = VK_NULL_HANDLE;
+    m_renderPass = VK_NULL_HANDLE;
+    m_isInitialized = false;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2024 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <QByteArrayList>
+#include <QQuickWindow>
+#include <QVulkanFunctions>
+#include <QVulkanInstance>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "videorendernode.hpp"
+
+class VkTextureRenderer : public VideoRenderNode
+{
+public:
+    explicit VkTextureRenderer(QQuickWindow *window);
+    ~VkTextureRenderer();
+
+    // Inherited from QSGRenderNode
+    void prepare() override;
+    void render(const RenderState *state) override;
+    void releaseResources() override;
+    StateFlags changedStates() const override;
+    RenderingFlags flags() const override;
+
+    // Inherited from VideoRenderNode
+    guint64 updateFrame(GstPlayer *player) override;
+    void releaseFrameResources() override;
+
+    // Device extensions to request from the scene graph for dma-buf import, only the supported
+    // ones are enabled
+    static QByteArrayList getDeviceExtensions();
+
+    // Imported dma-bufs kept for reuse, decoders cycle through a small pool
+    static constexpr size_t MaxImportedImages = 8;
+
+protected:
+    // Sampling of one format: YCbCr formats are sampled through an immutable sampler holding
+    // the conversion, which is baked into the descriptor set layout and the pipeline.
+    struct Pipeline
+    {
+        GstVideoFormat videoFormat = GST_VIDEO_FORMAT_UNKNOWN;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkSamplerYcbcrModelConversion model = VK_SAMPLER_YCBCR_MODEL_CONVERSION_RGB_IDENTITY;
+        VkSamplerYcbcrRange range = VK_SAMPLER_YCBCR_RANGE_ITU_FULL;
+        VkChromaLocation xChromaOffset = VK_CHROMA_LOCATION_MIDPOINT;
+        VkChromaLocation yChromaOffset = VK_CHROMA_LOCATION_MIDPOINT;
+        VkSamplerYcbcrConversion conversion = VK_NULL_HANDLE;
+        VkSampler sampler = VK_NULL_HANDLE;
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        // One per frame in flight, updated when the slot comes around again
+        std::vector<VkDescriptorSet> sets;
+    };
+
+    // Imported dma-buf or copy of a frame
+    struct Image
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Pipeline *pipeline = nullptr;
+        int width = 0;
+        int height = 0;
+        // Imported memory and its dma-buf inode, to recognize buffers the decoder hands over again
+        GstMemory *source = nullptr;
+        quint64 inode = 0;
+    };
+
+    // Host visible buffer frames are copied through, one per frame in flight
+    struct Staging
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void *data = nullptr;
+    };
+
+    // Objects destroyed once the frames that may use them are done
+    struct Retired
+    {
+        quint64 frame;
+        Image image;
+        VkPipeline pipeline;
+        GstBuffer *buffer;
+    };
+
+    struct PushConstants
+    {
+        float matrix[16];
+        // Quad in item coordinates, then texture coordinates of its four corners
+        float rect[4];
+        float texcoords[4 * 2];
+        float opacity;
+    };
+
+    bool initResources();
+    VkShaderModule loadShader(const QString &name);
+    Pipeline *getPipeline(const GstVideoInfo &info);
+    bool createPipeline(Pipeline &pipeline, VkRenderPass renderPass);
+    VkDescriptorSet getDescriptorSet(Pipeline &pipeline, int slot);
+    bool importFrame(VkCommandBuffer commandBuffer, GstBuffer *buffer, const GstVideoInfo &info,
+                     guint64 modifier, Pipeline *pipeline);
+    bool copyFrame(VkCommandBuffer commandBuffer, GstBuffer *buffer, const GstVideoInfo &info,
+                   guint64 modifier, Pipeline *pipeline, int slot);
+    bool createImage(Image &image, const VkImageCreateInfo &info, const void *allocateNext,
+                     uint32_t memoryTypeBits, VkMemoryPropertyFlags properties);
+    bool createImageView(Image &image);
+    bool ensureStaging(Staging &staging, VkDeviceSize size);
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
+    uint32_t getForeignQueueFamily();
+    void transition(VkCommandBuffer commandBuffer, Image &image, VkImageLayout layout,
+                    uint32_t srcQueueFamily, uint32_t dstQueueFamily);
+    void retire(const Image &image);
+    void retire(GstBuffer *buffer);
+    void collectRetired(bool isAll);
+    void destroyImage(Image &image);
+    void destroyPipeline(Pipeline &pipeline);
+
+private:
+    QQuickWindow *m_window;
+    QVulkanFunctions *m_functions = nullptr;
+    QVulkanDeviceFunctions *m_deviceFunctions = nullptr;
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_queueFamily = 0;
+    bool m_isInitialized = false;
+    bool m_isDmaBufImport = false;
+    bool m_isForeignQueue = false;
+    bool m_isYcbcr = false;
+    PFN_vkCreateSamplerYcbcrConversion m_createYcbcrConversion = nullptr;
+    PFN_vkDestroySamplerYcbcrConversion m_destroyYcbcrConversion = nullptr;
+    PFN_vkGetMemoryFdPropertiesKHR m_getMemoryFdProperties = nullptr;
+    VkShaderModule m_vertexShader = VK_NULL_HANDLE;
+    VkShaderModule m_fragmentShader = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    std::vector<std::unique_ptr<Pipeline>> m_pipelines;
+
+    // Frame handed over by updateFrame(), picked up by the next prepare()
+    GstBuffer *m_pendingBuffer = nullptr;
+    GstVideoInfo m_pendingInfo;
+    guint64 m_pendingModifier = 0;
+    // Frame drawn by render(), its buffer is kept while the image may be sampled
+    Image *m_current = nullptr;
+    GstBuffer *m_currentBuffer = nullptr;
+    std::deque<Image> m_imports;
+    Image m_copy;
+    std::vector<Staging> m_staging;
+    std::deque<Retired> m_retired;
+    quint64 m_frameCount = 0;
+};
@@ -6,6 +6,7 @@
 
 import QtQuick
 import QtQuick.Controls
+import ImxVideoToTexture
 
 Item {
     id: controls
@@ -124,6 +125,33 @@ Item {
         }
     }
 
+    Rectangle { // Seek preview, above the position hovered or dragged
+        id: seekPreviewFrame
+        property real percent: progressBar.pressed ? progressBar.visualPosition
+                               : (progressHover.point.position.x - progressBar.leftPadding)
+                                 / progressBar.availableWidth
+        visible: seekPreview.ready && (progressBar.pressed || progressHover.hovered)
+        z: 1
+        width: seekPreview.width + 4
+        height: seekPreview.height + 4
+        x: Math.max(0, Math.min(controls.width - width,
+                                progressBar.x + progressBar.leftPadding
+                                + percent * progressBar.availableWidth - width / 2))
+        anchors.bottom: progressBar.top
+        color: Style.nxpDarkGrey
+        border.color: Style.nxpGrey
+        border.width: 1
+
+        SeekPreview {
+            id: seekPreview
+            anchors.centerIn: parent
+            width: 160
+            height: width / ratio
+            source: stream.source
+            position: Math.max(0, Math.min(1, seekPreviewFrame.percent))
+        }
+    }
+
     Slider { // Progress Bar
         id: progressBar
         width: parent.width * 0.9
@@ -134,6 +162,9 @@ Item {
         onMoved: {
             stream.position = progressBar.value
         }
+        HoverHandler {
+            id: progressHover
+        }
         background: Rectangle {
             anchors.verticalCenter: parent.verticalCenter
             anchors.horizontalCenter: parent.horizontalCenter
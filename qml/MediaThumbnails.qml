@@ -6,7 +6,6 @@
 
 import QtQuick
 import QtQuick.Layouts
-import Qt.labs.folderlistmodel
 import Qt.labs.platform
 import ImxVideoToTexture
 
@@ -56,11 +55,9 @@ Item {
         }
     }
 
-    FolderListModel {
+    MediaLibrary {
         id: videomodel
         folder: StandardPaths.standardLocations(StandardPaths.HomeLocation)[0]
-        showDirs: false
-        nameFilters: ["*.mkv", "*.mp4"]
     }
 
     Component {
@@ -69,8 +66,20 @@ Item {
             id: thumbnailsitem
             required property string fileName
             required property string fileUrl
+            required property var model
+            // Library files get a screenshot pipeline once probed as playable video within the
+            // software decode budget, test patterns at once
+            readonly property bool overloaded: model.overloaded === true
+            readonly property bool ready: model.probed === undefined
+                                          || (model.probed && model.playable && !overloaded)
             width: thumbnails.cellWidth
             height: thumbnails.cellHeight
+            Component.onCompleted: {
+                let library = thumbnailsitem.GridView.view.model
+                if (library.prioritize) {
+                    library.prioritize(fileUrl)
+                }
+            }
             Item {
                 id: thumbnailsimage
                 width: parent.width * 0.85
@@ -80,25 +89,34 @@ Item {
                 property real ratio: width / height
                 anchors.horizontalCenter : parent.horizontalCenter
                 Image {
-                    visible: 1 - mediascreenshot.loaded
+                    visible: !(screenshotloader.item && screenshotloader.item.loaded)
                     width: parent.width
                     height: parent.height
                     anchors.verticalCenter : parent.verticalCenter
                     source: "qrc:/image/videothumbnail";
                 }
-                MediaScreenshot {
-                    id: mediascreenshot
-                    width: (ratio > parent.ratio ? parent.width : parent.height * ratio)
-                    height : (ratio > parent.ratio ? parent.width / ratio : parent.height)
-                    anchors.horizontalCenter : parent.horizontalCenter
-                    anchors.bottom : parent.bottom
-                    source: fileUrl
-                    atPercent: 0.2
+                Loader {
+                    id: screenshotloader
+                    anchors.fill: parent
+                    active: thumbnailsitem.ready
+                    sourceComponent: MediaScreenshot {
+                        width: (ratio > thumbnailsimage.ratio ? thumbnailsimage.width
+                                                               : thumbnailsimage.height * ratio)
+                        height : (ratio > thumbnailsimage.ratio ? thumbnailsimage.width / ratio
+                                                                : thumbnailsimage.height)
+                        anchors.horizontalCenter : parent.horizontalCenter
+                        anchors.bottom : parent.bottom
+                        source: thumbnailsitem.fileUrl
+                        atPercent: 0.2
+                    }
                 }
             }
             Text {
                 id: thumbnailstext
-                text: fileName
+                text: model.softwareDecode ? fileName + "\n(software decode, "
+                                             + Math.round(model.decodeCost * 100) + "% CPU)"
+                                           : fileName
+                color: thumbnailsitem.overloaded ? "red" : "black"
                 anchors.top: thumbnailsimage.bottom
                 anchors.bottom: parent.bottom
                 font.pointSize: 10.0
@@ -150,6 +168,10 @@ Item {
             }
 
             function select(item) {
+                // Overloaded files would drop most frames, their pipeline is never started
+                if (item.overloaded) {
+                    return
+                }
                 thumbnails.selectedFile = item.fileUrl
                 thumbnails.focusedGrid = thumbnailsgrid.focusIdInternal
                 thumbnails.fileSelected()
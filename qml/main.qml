@@ -82,6 +82,32 @@ ApplicationWindow {
             height : (ratio > parent.ratio ? parent.width / ratio : parent.height)
             anchors.verticalCenter: parent.verticalCenter
             anchors.horizontalCenter: parent.horizontalCenter
+            shared: mirrorScreen >= 0
+        }
+    }
+
+    Loader { // Copy of the Media Stream on another display, from the same decode
+        active: mirrorScreen >= 0
+        sourceComponent: Window {
+            screen: Qt.application.screens[mirrorScreen]
+            visibility: Window.FullScreen
+            visible: true
+            color: "black"
+            Item {
+                anchors.fill: parent
+                property real ratio: width / height
+                MediaStream {
+                    width: (ratio > parent.ratio ? parent.width : parent.height * ratio)
+                    height : (ratio > parent.ratio ? parent.width / ratio : parent.height)
+                    anchors.verticalCenter: parent.verticalCenter
+                    anchors.horizontalCenter: parent.horizontalCenter
+                    shared: true
+                    // Everything the shared player is looked up by
+                    pipeline: mediastream.pipeline
+                    live: mediastream.live
+                    source: mediastream.source
+                }
+            }
         }
     }
 
@@ -0,0 +1,22 @@
+// Copyright 2024 NXP
+// SPDX-License-Identifier: BSD-3-Clause
+
+#version 440
+
+layout(push_constant) uniform PushConstants {
+    mat4 matrix;
+    vec4 rect;
+    vec2 coords[4];
+    float opacity;
+} pc;
+
+// Immutable sampler, with the YCbCr conversion of NV12 frames
+layout(binding = 0) uniform sampler2D u_texture;
+
+layout(location = 0) in vec2 v_coords;
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    fragColor = pc.opacity * texture(u_texture, v_coords);
+}
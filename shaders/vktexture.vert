@@ -0,0 +1,22 @@
+// Copyright 2024 NXP
+// SPDX-License-Identifier: BSD-3-Clause
+
+#version 440
+
+// Quad of the video item, corners generated from the vertex index: top-left, top-right,
+// bottom-left and bottom-right, drawn as a triangle strip
+layout(push_constant) uniform PushConstants {
+    mat4 matrix;
+    vec4 rect;
+    vec2 coords[4];
+    float opacity;
+} pc;
+
+layout(location = 0) out vec2 v_coords;
+
+void main()
+{
+    vec2 corner = vec2(float(gl_VertexIndex & 1), float(gl_VertexIndex >> 1));
+    v_coords = pc.coords[gl_VertexIndex];
+    gl_Position = pc.matrix * vec4(pc.rect.xy + corner * pc.rect.zw, 0.0, 1.0);
+}